@@ -2,8 +2,11 @@
 
 #include "name.hpp"
 #include "types.hpp"
+#include <atomic>
 #include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <variant>
 #include <vector>
@@ -15,6 +18,7 @@
 #include "bytes.hpp"
 #include "asset.hpp"
 #include "bitset.hpp"
+#include "flat_map.hpp"
 
 namespace sysio {
 
@@ -175,9 +179,56 @@ SYSIO_REFLECT(abi_def, version, types, structs, actions, tables, ricardian_claus
 
 struct abi_type;
 
+// abi_type::fixed_size and abi_field::offset of values which vary in size
+inline constexpr uint32_t abi_variable_size = ~uint32_t(0);
+
 struct abi_field {
    std::string     name;
    const abi_type* type;
+   uint32_t        offset = abi_variable_size; // from the start of the struct, if the fields before have a fixed size
+   std::string     json_key;                    // ,"name": escaped once, so bin_to_json writes each key in one piece
+
+   abi_field(std::string name, const abi_type* type) : name(std::move(name)), type(type) {
+      size_stream ss;
+      to_json(this->name, ss);
+      json_key.resize(ss.size + 2);
+      fixed_buf_stream fbs(json_key.data(), json_key.size());
+      fbs.write(',');
+      to_json(this->name, fbs);
+      fbs.write(':');
+   }
+
+   // "name": for the first field of an object
+   std::string_view first_json_key() const { return std::string_view{ json_key }.substr(1); }
+   // "name" for a variant alternative
+   std::string_view quoted_json_name() const { return std::string_view{ json_key }.substr(1, json_key.size() - 2); }
+};
+
+// An abi_type's program starts with the op for the type itself. Ops for containers are followed by one op per field,
+// alternative or element, which is either builtin or a call to the program of that field's type:
+//    builtin      arg: index into basic_abi_types
+//    object       arg: field count, fields
+//    variant      arg: alternative count, fields, type: the variant itself
+//    optional, extension
+//    array        arg: element size, or abi_variable_size
+//    fixed_array  arg: size
+//    call         type
+enum class abi_opcode : uint32_t {
+   builtin,
+   call,
+   object,
+   variant,
+   optional,
+   extension,
+   array,
+   fixed_array,
+};
+
+struct abi_op {
+   abi_opcode                    code   = abi_opcode::builtin;
+   uint32_t                      arg    = 0;
+   const abi_type*               type   = nullptr;
+   const std::vector<abi_field>* fields = nullptr;
 };
 
 struct abi_type {
@@ -210,6 +261,21 @@ struct abi_type {
                          _data;
    const abi_serializer* ser = nullptr;
 
+   // Compiled by convert() and abi::get_type() const; empty for aliases and for types added after convert(), which
+   // are converted through ser instead. Every type a program calls has a program too.
+   std::vector<abi_op> program;
+
+   // Binary size of every value, or abi_variable_size. Computed along with the program.
+   uint32_t fixed_size = abi_variable_size;
+
+   // Structs and variants: open-addressed table of the fields or alternatives by name. Each slot holds the high 16 bits
+   // of the name's hash and the index + 1 in its low 16 bits; 0 marks an empty slot. Built along with the program.
+   std::vector<uint32_t> name_index;
+
+   // Only used by abis from convert_lazy(), and always set for builtins. Set once this type and every type it
+   // contains are resolved and compiled; none of them is modified afterwards.
+   std::atomic<bool> resolved{false};
+
    template <typename T>
    abi_type(std::string name, T&& arg, const abi_serializer* ser)
        : name(std::move(name)), _data(std::forward<T>(arg)), ser(ser) {}
@@ -250,21 +316,78 @@ struct abi_type {
    const struct_* as_struct() const { return std::get_if<struct_>(&_data); }
    const variant* as_variant() const { return std::get_if<variant>(&_data); }
 
+   // Index of the first struct field or variant alternative called name, or -1. Search linearly while name_index is
+   // empty.
+   int find_field(std::string_view name) const { return find_name(std::get<struct_>(_data).fields, name); }
+   int find_alternative(std::string_view name) const { return find_name(std::get<variant>(_data), name); }
+
    std::string bin_to_json(
          input_stream& bin, std::function<void()> f = [] {}) const;
    std::vector<char> json_to_bin(
          std::string_view json, std::function<void()> f = [] {}) const;
    std::vector<char> json_to_bin_reorderable(
          std::string_view json, std::function<void()> f = [] {}) const;
+
+ private:
+   int find_name(const std::vector<abi_field>& fields, std::string_view name) const;
+};
+
+inline uint32_t name_hash(std::string_view name) {
+   uint32_t h = 2166136261u;
+   for (char c : name)
+      h = (h ^ (unsigned char)c) * 16777619u;
+   return h;
+}
+
+inline int abi_type::find_name(const std::vector<abi_field>& fields, std::string_view name) const {
+   if (name_index.empty()) {
+      for (size_t i = 0; i < fields.size(); ++i)
+         if (fields[i].name == name)
+            return int(i);
+      return -1;
+   }
+   auto   h    = name_hash(name);
+   size_t mask = name_index.size() - 1;
+   for (size_t i = h & mask;; i = (i + 1) & mask) {
+      auto slot = name_index[i];
+      if (!slot)
+         return -1;
+      if ((slot ^ h) >> 16 == 0 && fields[(slot & 0xffff) - 1].name == name)
+         return int(slot & 0xffff) - 1;
+   }
+}
+
+// Types such as "foo[]" which are first requested after an abi has been shared between threads.
+struct abi_derived_types {
+   std::mutex                      mutex;
+   flat_map<std::string, abi_type> types;
 };
 
 struct abi {
-   std::map<sysio::name, std::string> action_types;
-   std::map<sysio::name, std::string> table_types;
-   std::map<std::string, abi_type>    abi_types;
-   std::map<sysio::name, std::string> action_result_types;
+   flat_map<sysio::name, std::string> action_types;
+   flat_map<sysio::name, std::string> table_types;
+   flat_map<std::string, abi_type>    abi_types;
+   flat_map<sysio::name, std::string> action_result_types;
+
+   // action_types, table_types and action_result_types resolved by convert(). An entry is null if its type name does
+   // not resolve, or if the abi is lazy; get_type() on the name reports why or resolves it.
+   flat_map<sysio::name, const abi_type*> action_abi_types;
+   flat_map<sysio::name, const abi_type*> table_abi_types;
+   flat_map<sysio::name, const abi_type*> action_result_abi_types;
+
    const abi_type*                    get_type(const std::string& name);
 
+   // Thread-safe lookup for an abi which is no longer modified after convert(). Existing types are found without
+   // locking; types which have to be created on demand go into derived_types instead of abi_types.
+   const abi_type*                    get_type(const std::string& name) const;
+   std::unique_ptr<abi_derived_types> derived_types = std::make_unique<abi_derived_types>();
+
+   // Kept by convert_lazy(); the unresolved types in abi_types point into it
+   std::unique_ptr<const abi_def> source;
+
+   // Earlier versions of this abi whose compiled types it reuses. A reused type is an alias with its own name.
+   std::vector<std::shared_ptr<const abi>> reused;
+
    // Adds a type to the abi.  Has no effect if the type is already present.
    // If the type is a struct, all members will be added recursively.
    // Exception Safety: basic. If add_type fails, some objects may have
@@ -273,9 +396,37 @@ struct abi {
    abi_type* add_type();
 };
 
+// The builtin types and extended_asset, shared by every abi. Built once and never modified afterwards, so abi_types
+// only holds the types an abi defines or derives. Returns null if name isn't builtin.
+abi_type* get_builtin_type(std::string_view name);
+
 void convert(const abi_def& def, abi&);
+
+// Like convert(), but reuses the compiled types of previous whose definitions, and the definitions of the types they
+// depend on, are unchanged. Adds the names of the types which were added, removed or changed to changed, sorted. A
+// lazy previous is compared by its definitions, and only lends the types it has already resolved.
+void convert(const abi_def& def, abi&, const std::shared_ptr<const abi>& previous, std::vector<std::string>& changed);
+
+// Like convert(), but a type is only resolved and compiled by the first get_type() const which needs it, so an abi
+// costs in proportion to the types that are used. Errors in types which are never used aren't reported.
+void convert_lazy(abi_def&& def, abi&);
+
+// convert_lazy() with the reuse of the convert() overload above
+void convert_lazy(abi_def&& def, abi&, const std::shared_ptr<const abi>& previous, std::vector<std::string>& changed);
+
+// Adds the names of the types which def adds, removes or changes relative to previous to changed, sorted, as the
+// convert() overload above does, without converting def
+void diff_types(const abi_def& def, const abi& previous, std::vector<std::string>& changed);
 void convert(const abi& def, abi_def&);
 
+// Appends a compiled abi to image in a position-independent binary form, which load_abi_image() turns back into an
+// abi without parsing or resolving any definitions. Lazy abis are fully resolved first.
+void save_abi_image(const abi&, std::vector<char>& image);
+
+// Loads an abi saved by save_abi_image(). image may be read straight from a memory-mapped file; it isn't referenced
+// afterwards. Throws if the image is malformed.
+void load_abi_image(const char* image, size_t size, abi&);
+
 extern const abi_serializer* const object_abi_serializer;
 extern const abi_serializer* const variant_abi_serializer;
 extern const abi_serializer* const array_abi_serializer;
@@ -315,9 +466,9 @@ auto add_type(abi& a, T*) -> std::enable_if_t<reflection::has_for_each_field_v<T
 
 template <typename T>
 auto add_type(abi& a, T* t) -> std::enable_if_t<is_basic_abi_type<T>, abi_type*> {
-   auto iter = a.abi_types.find(get_type_name(t));
-   check(iter != a.abi_types.end(), convert_abi_error(abi_error::unknown_type));
-   return &iter->second;
+   auto type = get_builtin_type(get_type_name(t));
+   check(type != nullptr, convert_abi_error(abi_error::unknown_type));
+   return type;
 }
 
 template <typename T>
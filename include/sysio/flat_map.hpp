@@ -0,0 +1,167 @@
+#pragma once
+
+#include "name.hpp"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace sysio {
+
+template <typename K>
+struct flat_hash;
+
+template <>
+struct flat_hash<name> {
+   // splitmix64 finalizer; spreads the name bits into the low bits used for probing
+   size_t operator()(name n) const {
+      uint64_t x = n.value;
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ull;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebull;
+      return x ^ (x >> 31);
+   }
+};
+
+template <>
+struct flat_hash<std::string> {
+   size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+// Open-addressing hash map with linear probing. Elements are stored once, in a deque in insertion order, so iteration
+// is deterministic and element addresses are stable while the map grows. The probe table only holds a truncated hash
+// and an element index per slot. find() accepts any key type which Hash and operator== accept, e.g. std::string_view
+// for std::string keys.
+//
+// Inserting invalidates iterators but not pointers or references to elements. Erasing moves the last element into the
+// erased element's place; pointers to the last element are invalidated.
+template <typename K, typename T, typename Hash = flat_hash<K>>
+class flat_map {
+ public:
+   using key_type       = K;
+   using mapped_type    = T;
+   using value_type     = std::pair<const K, T>;
+   using iterator       = typename std::deque<value_type>::iterator;
+   using const_iterator = typename std::deque<value_type>::const_iterator;
+
+   size_t size() const { return values.size(); }
+   bool   empty() const { return values.empty(); }
+
+   iterator       begin() { return values.begin(); }
+   iterator       end() { return values.end(); }
+   const_iterator begin() const { return values.begin(); }
+   const_iterator end() const { return values.end(); }
+
+   template <typename Key>
+   iterator find(const Key& key) {
+      auto i = find_slot(key, Hash{}(key));
+      return i == npos ? values.end() : values.begin() + slots[i].index;
+   }
+
+   template <typename Key>
+   const_iterator find(const Key& key) const {
+      auto i = find_slot(key, Hash{}(key));
+      return i == npos ? values.end() : values.begin() + slots[i].index;
+   }
+
+   template <typename... Args>
+   std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+      if ((values.size() + 1) * 2 > slots.size())
+         rehash(slots.empty() ? 16 : slots.size() * 2);
+      auto h = Hash{}(key);
+      auto i = probe(key, h);
+      if (slots[i].index != empty_slot)
+         return { values.begin() + slots[i].index, false };
+      values.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+      slots[i] = { uint32_t(h), uint32_t(values.size() - 1) };
+      return { values.end() - 1, true };
+   }
+
+   std::pair<iterator, bool> insert(value_type value) { return try_emplace(value.first, std::move(value.second)); }
+
+   T& operator[](const K& key) { return try_emplace(key).first->second; }
+
+   template <typename Key>
+   size_t erase(const Key& key) {
+      auto i = find_slot(key, Hash{}(key));
+      if (i == npos)
+         return 0;
+      auto index = slots[i].index;
+      remove_slot(i);
+      auto last = uint32_t(values.size() - 1);
+      if (index != last) {
+         slots[find_slot(values[last].first, Hash{}(values[last].first))].index = index;
+         values[index].~value_type();
+         new (&values[index]) value_type(std::move(values[last]));
+      }
+      values.pop_back();
+      return 1;
+   }
+
+   void erase(iterator it) { erase(it->first); }
+
+ private:
+   struct slot {
+      uint32_t hash  = 0;
+      uint32_t index = empty_slot;
+   };
+
+   static constexpr uint32_t empty_slot = ~uint32_t(0);
+   static constexpr size_t   npos       = ~size_t(0);
+
+   std::deque<value_type> values;
+   std::vector<slot>      slots;
+
+   // Returns the slot holding key, or the empty slot where it belongs
+   template <typename Key>
+   size_t probe(const Key& key, size_t h) const {
+      auto mask = slots.size() - 1;
+      for (auto i = h & mask;; i = (i + 1) & mask) {
+         auto& s = slots[i];
+         if (s.index == empty_slot || (s.hash == uint32_t(h) && values[s.index].first == key))
+            return i;
+      }
+   }
+
+   template <typename Key>
+   size_t find_slot(const Key& key, size_t h) const {
+      if (slots.empty())
+         return npos;
+      auto i = probe(key, h);
+      return slots[i].index == empty_slot ? npos : i;
+   }
+
+   // Backward-shift deletion keeps every probe sequence free of holes
+   void remove_slot(size_t i) {
+      auto mask = slots.size() - 1;
+      for (auto j = (i + 1) & mask; slots[j].index != empty_slot; j = (j + 1) & mask) {
+         auto home = slots[j].hash & mask;
+         if (((j - home) & mask) >= ((j - i) & mask)) {
+            slots[i] = slots[j];
+            i        = j;
+         }
+      }
+      slots[i].index = empty_slot;
+   }
+
+   void rehash(size_t size) {
+      slots.assign(size, slot{});
+      auto mask = size - 1;
+      for (uint32_t index = 0; index < values.size(); ++index) {
+         auto h = Hash{}(values[index].first);
+         auto i = h & mask;
+         while (slots[i].index != empty_slot)
+            i = (i + 1) & mask;
+         slots[i] = { uint32_t(h), index };
+      }
+   }
+};
+
+} // namespace sysio
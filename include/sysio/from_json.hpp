@@ -3,8 +3,10 @@
 #include <cstdlib>
 #include "for_each_field.hpp"
 #include "check.hpp"
+#include "json_scan.hpp"
 #include <functional>
 #include <optional>
+#include <rapidjson/allocators.h>
 #include <rapidjson/reader.h>
 #include <vector>
 #include <variant>
@@ -180,32 +182,26 @@ struct json_token {
    std::string_view value_string = {};
 };
 
-class json_token_stream : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, json_token_stream> {
- private:
-   rapidjson::Reader             reader;
-   rapidjson::InsituStringStream ss;
-
+/**
+ *  The token interface which from_json uses. Derived supplies read_token(), which reads the next token into
+ *  current_token, and complete().
+ */
+template <typename Derived>
+class basic_json_token_stream {
  public:
    json_token current_token;
 
-   // This modifies json
-   json_token_stream(char* json) : ss{ json } { reader.IterativeParseInit(); }
-
-   bool complete() { return reader.IterativeParseComplete(); }
-
    std::reference_wrapper<const json_token> peek_token() {
       if (current_token.type != json_token_type::type_unread)
          return current_token;
-      check( reader.IterativeParseNext<rapidjson::kParseInsituFlag | rapidjson::kParseValidateEncodingFlag |
-                                         rapidjson::kParseIterativeFlag | rapidjson::kParseNumbersAsStringsFlag>(ss, *this),
-            convert_error_to_string_view(reader.GetParseErrorCode()) );
+      static_cast<Derived*>(this)->read_token();
       return current_token;
    }
 
    void eat_token() { current_token.type = json_token_type::type_unread; }
 
    void get_end() {
-      check( current_token.type == json_token_type::type_unread && complete(),
+      check( current_token.type == json_token_type::type_unread && static_cast<Derived*>(this)->complete(),
             convert_json_error(from_json_error::expected_end) );
    }
    bool get_null_pred() {
@@ -299,6 +295,47 @@ class json_token_stream : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>,
            convert_json_error(from_json_error::expected_end_array));
    }
 
+}; // basic_json_token_stream
+
+/**
+ *  Tokenizes with rapidjson's iterative parser
+ */
+class rapidjson_token_stream : public basic_json_token_stream<rapidjson_token_stream>,
+                               public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, rapidjson_token_stream> {
+ public:
+   using stack_allocator = rapidjson::MemoryPoolAllocator<>;
+
+   // Memory for the parser's nesting stack which a caller can keep between streams
+   static constexpr size_t stack_buffer_size = 4096;
+
+ private:
+   stack_allocator allocator;
+   rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, stack_allocator> reader;
+   rapidjson::InsituStringStream ss;
+
+ public:
+   // This modifies json
+   rapidjson_token_stream(char* json) : allocator{ stack_buffer_size }, reader{ &allocator }, ss{ json } {
+      reader.IterativeParseInit();
+   }
+
+   // The parser's stack lives in stack_buffer until it outgrows it
+   rapidjson_token_stream(char* json, void* stack_buffer, size_t size)
+       : allocator{ stack_buffer, size, stack_buffer_size }, reader{ &allocator }, ss{ json } {
+      reader.IterativeParseInit();
+   }
+
+   bool complete() { return reader.IterativeParseComplete(); }
+
+   // Offset of the first character which hasn't been parsed yet
+   size_t tell() { return ss.Tell(); }
+
+   void read_token() {
+      check( reader.IterativeParseNext<rapidjson::kParseInsituFlag | rapidjson::kParseValidateEncodingFlag |
+                                         rapidjson::kParseIterativeFlag | rapidjson::kParseNumbersAsStringsFlag>(ss, *this),
+            convert_error_to_string_view(reader.GetParseErrorCode()) );
+   }
+
    // BaseReaderHandler methods
    bool Null() {
       current_token.type = json_token_type::type_null;
@@ -341,6 +378,317 @@ class json_token_stream : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>,
       current_token.type = json_token_type::type_end_array;
       return true;
    }
+}; // rapidjson_token_stream
+
+/**
+ *  Tokenizes over a json_scan::indexer, which finds structural characters and validates UTF-8 a block at a
+ *  time, so only the characters around each token are visited one by one. Produces the same tokens as
+ *  rapidjson_token_stream.
+ */
+class json_token_stream : public basic_json_token_stream<json_token_stream> {
+ public:
+   // Memory for the nesting stack which a caller can keep between streams
+   static constexpr size_t stack_buffer_size = 4096;
+
+ private:
+   enum class expect : uint8_t {
+      root,
+      value,
+      value_or_end_array,
+      key_or_end_object,
+      comma_or_end,
+      done,
+   };
+
+   char*               json;
+   size_t              size;
+   json_scan::indexer  index;
+   size_t              end   = 0; // of the last token
+   expect              state = expect::root;
+   size_t              depth = 0;
+   unsigned char*      nesting_buffer; // one bit per open container, set for objects
+   size_t              nesting_size;
+   std::vector<unsigned char> nesting_overflow;
+
+   [[noreturn]] void fail(from_json_error e, size_t pos) {
+      end = pos;
+      check(false, convert_json_error(e));
+      __builtin_unreachable();
+   }
+
+   unsigned char* nesting() { return nesting_buffer ? nesting_buffer : nesting_overflow.data(); }
+
+   void push(bool object) {
+      if (depth == nesting_size * 8) {
+         if (nesting_buffer)
+            nesting_overflow.assign(nesting_buffer, nesting_buffer + nesting_size);
+         nesting_buffer = nullptr;
+         nesting_size   = nesting_size ? nesting_size * 2 : 32;
+         nesting_overflow.resize(nesting_size);
+      }
+      auto& byte = nesting()[depth / 8];
+      byte       = (byte & ~(1u << depth % 8)) | (unsigned(object) << depth % 8);
+      ++depth;
+   }
+
+   bool in_object() { return (nesting()[(depth - 1) / 8] >> (depth - 1) % 8) & 1; }
+
+   static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+   // Characters which may follow a number or literal
+   static bool is_delimiter(char c) {
+      switch (c) {
+         case 0:
+         case ' ': case '\t': case '\n': case '\r':
+         case ',': case ':': case '[': case ']': case '{': case '}': case '"': return true;
+         default: return false;
+      }
+   }
+
+   void value_complete() {
+      if (depth) {
+         state = expect::comma_or_end;
+         return;
+      }
+      state = expect::done;
+      size_t pos = index.next();
+      if (pos != size)
+         fail(from_json_error::document_root_not_singular, pos);
+   }
+
+   void start_container(size_t pos, bool object) {
+      push(object);
+      end                = pos + 1;
+      state              = object ? expect::key_or_end_object : expect::value_or_end_array;
+      current_token.type = object ? json_token_type::type_start_object : json_token_type::type_start_array;
+   }
+
+   void end_container(size_t pos) {
+      --depth;
+      end                = pos + 1;
+      current_token.type = json[pos] == '}' ? json_token_type::type_end_object : json_token_type::type_end_array;
+      value_complete();
+   }
+
+   static int hex_digit(char c) {
+      if (c >= '0' && c <= '9')
+         return c - '0';
+      if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+         return (c | 0x20) - 'a' + 10;
+      return -1;
+   }
+
+   uint32_t read_hex4(const char* p, const char* stop) {
+      uint32_t result = 0;
+      for (int i = 0; i < 4; ++i) {
+         int digit = p + i < stop ? hex_digit(p[i]) : -1;
+         if (digit < 0)
+            fail(from_json_error::string_unicode_escape_invalid_hex, p + i - json);
+         result = result * 16 + digit;
+      }
+      return result;
+   }
+
+   // Decodes escapes in [p, stop) in place; returns the new end. Out of line since most strings have none
+   __attribute__((noinline)) char* unescape(char* p, const char* stop) {
+      char* out = p;
+      while (p < stop) {
+         char c = *p++;
+         if (c != '\\') {
+            *out++ = c;
+            continue;
+         }
+         // A backslash is never last since it would have escaped the closing quote
+         char e = *p++;
+         switch (e) {
+            case '"':
+            case '\\':
+            case '/': *out++ = e; continue;
+            case 'b': *out++ = '\b'; continue;
+            case 'f': *out++ = '\f'; continue;
+            case 'n': *out++ = '\n'; continue;
+            case 'r': *out++ = '\r'; continue;
+            case 't': *out++ = '\t'; continue;
+            case 'u': break;
+            default: fail(from_json_error::string_escape_invalid, p - 1 - json);
+         }
+         uint32_t code = read_hex4(p, stop);
+         p += 4;
+         if (code >= 0xdc00 && code <= 0xdfff)
+            fail(from_json_error::string_unicode_surrogate_invalid, p - json);
+         if (code >= 0xd800 && code <= 0xdbff) {
+            if (stop - p < 2 || p[0] != '\\' || p[1] != 'u')
+               fail(from_json_error::string_unicode_surrogate_invalid, p - json);
+            uint32_t low = read_hex4(p + 2, stop);
+            if (low < 0xdc00 || low > 0xdfff)
+               fail(from_json_error::string_unicode_surrogate_invalid, p + 2 - json);
+            p += 6;
+            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+         }
+         if (code < 0x80) {
+            *out++ = char(code);
+         } else if (code < 0x800) {
+            *out++ = char(0xc0 | (code >> 6));
+            *out++ = char(0x80 | (code & 0x3f));
+         } else if (code < 0x10000) {
+            *out++ = char(0xe0 | (code >> 12));
+            *out++ = char(0x80 | ((code >> 6) & 0x3f));
+            *out++ = char(0x80 | (code & 0x3f));
+         } else {
+            *out++ = char(0xf0 | (code >> 18));
+            *out++ = char(0x80 | ((code >> 12) & 0x3f));
+            *out++ = char(0x80 | ((code >> 6) & 0x3f));
+            *out++ = char(0x80 | (code & 0x3f));
+         }
+      }
+      return out;
+   }
+
+   // open is the offset of the opening quote. The string is decoded in place and null terminated.
+   std::string_view read_string(size_t open) {
+      bool   escapes = false;
+      size_t close   = index.next();
+      for (; json[close] != '"'; close = index.next()) {
+         if (close == size)
+            fail(from_json_error::string_miss_quotation_mark, size);
+         escapes = true; // the indexer only reports backslashes inside strings
+      }
+      if (index.first_invalid <= close)
+         fail(from_json_error::string_invalid_encoding, index.first_invalid);
+      char* begin = json + open + 1;
+      char* stop  = escapes ? unescape(begin, json + close) : json + close;
+      *stop       = 0;
+      end         = close + 1;
+      return { begin, size_t(stop - begin) };
+   }
+
+   // Numbers are kept as strings
+   void read_number(size_t pos) {
+      size_t p = pos;
+      if (json[p] == '-')
+         ++p;
+      if (json[p] == '0')
+         ++p;
+      else if (is_digit(json[p]))
+         while (is_digit(json[p]))
+            ++p;
+      else
+         fail(from_json_error::value_invalid, p);
+      if (json[p] == '.') {
+         if (!is_digit(json[++p]))
+            fail(from_json_error::number_miss_fraction, p);
+         while (is_digit(json[p]))
+            ++p;
+      }
+      if ((json[p] | 0x20) == 'e') {
+         ++p;
+         if (json[p] == '+' || json[p] == '-')
+            ++p;
+         if (!is_digit(json[p]))
+            fail(from_json_error::number_miss_exponent, p);
+         while (is_digit(json[p]))
+            ++p;
+      }
+      if (!is_delimiter(json[p]))
+         fail(from_json_error::value_invalid, p);
+      end                         = p;
+      current_token.type          = json_token_type::type_string;
+      current_token.value_string  = { json + pos, p - pos };
+   }
+
+   void read_literal(size_t pos, std::string_view literal) {
+      if (size - pos < literal.size() || memcmp(json + pos, literal.data(), literal.size()) ||
+          !is_delimiter(json[pos + literal.size()]))
+         fail(from_json_error::value_invalid, pos);
+      end = pos + literal.size();
+   }
+
+   void read_value(size_t pos) {
+      switch (json[pos]) {
+         case '{': return start_container(pos, true);
+         case '[': return start_container(pos, false);
+         case '"':
+            current_token.value_string = read_string(pos);
+            current_token.type         = json_token_type::type_string;
+            break;
+         case 't':
+         case 'f':
+            current_token.value_bool = json[pos] == 't';
+            read_literal(pos, current_token.value_bool ? "true" : "false");
+            current_token.type = json_token_type::type_bool;
+            break;
+         case 'n':
+            read_literal(pos, "null");
+            current_token.type = json_token_type::type_null;
+            break;
+         case 0: fail(from_json_error::value_invalid, pos); // end of json
+         default: read_number(pos);
+      }
+      value_complete();
+   }
+
+   void read_key(size_t pos) {
+      if (json[pos] != '"')
+         fail(from_json_error::object_miss_name, pos);
+      current_token.key  = read_string(pos);
+      current_token.type = json_token_type::type_key;
+      size_t key_end     = end;
+      size_t colon       = index.next();
+      if (json[colon] != ':')
+         fail(from_json_error::object_miss_colon, colon);
+      end   = key_end;
+      state = expect::value;
+   }
+
+ public:
+   // This modifies json
+   json_token_stream(char* json) : json_token_stream(json, strlen(json), nullptr, 0) {}
+
+   // json holds size bytes followed by a NUL. This modifies json
+   json_token_stream(char* json, size_t size) : json_token_stream(json, size, nullptr, 0) {}
+
+   // The nesting stack lives in stack_buffer until it outgrows it
+   json_token_stream(char* json, size_t size, void* stack_buffer, size_t stack_size)
+       : json{ json }, size{ size }, index{ json, size },
+         nesting_buffer{ static_cast<unsigned char*>(stack_buffer) }, nesting_size{ stack_buffer ? stack_size : 0 } {}
+
+   bool complete() { return state == expect::done; }
+
+   // Offset of the first character after the last token read
+   size_t tell() { return end; }
+
+   void read_token() {
+      size_t pos = index.next();
+      switch (state) {
+         case expect::root:
+            if (pos == size)
+               fail(from_json_error::document_empty, pos);
+            return read_value(pos);
+         case expect::value: return read_value(pos);
+         case expect::value_or_end_array:
+            if (json[pos] == ']')
+               return end_container(pos);
+            return read_value(pos);
+         case expect::key_or_end_object:
+            if (json[pos] == '}')
+               return end_container(pos);
+            return read_key(pos);
+         case expect::comma_or_end:
+            if (in_object()) {
+               if (json[pos] == '}')
+                  return end_container(pos);
+               if (json[pos] != ',')
+                  fail(from_json_error::object_miss_comma_or_curly_bracket, pos);
+               return read_key(index.next());
+            }
+            if (json[pos] == ']')
+               return end_container(pos);
+            if (json[pos] != ',')
+               fail(from_json_error::array_miss_comma_or_square_bracket, pos);
+            return read_value(index.next());
+         case expect::done: fail(from_json_error::document_root_not_singular, pos);
+      }
+   }
 }; // json_token_stream
 
 template <typename SrcIt, typename DestIt>
@@ -384,10 +732,130 @@ void from_json(std::string& result, S& stream) {
    result = stream.get_string();
 }
 
+/// \exclude
+// 8 bytes, first character in the low byte
+inline uint64_t load_eight_chars(const char* p) {
+   uint64_t x;
+   memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+   x = __builtin_bswap64(x);
+#endif
+   return x;
+}
+
+/// \exclude
+inline bool is_eight_digits(uint64_t x) {
+   return !(((x & 0xf0f0'f0f0'f0f0'f0f0ull) - 0x3030'3030'3030'3030ull) |
+            (((x + 0x0606'0606'0606'0606ull) & 0xf0f0'f0f0'f0f0'f0f0ull) - 0x3030'3030'3030'3030ull));
+}
+
+/// \exclude
+// Converts 8 digits with 3 multiplies: pairs, then quads, then the whole
+inline uint64_t parse_eight_digits(uint64_t x) {
+   x = (x & 0x0f0f'0f0f'0f0f'0f0full) * 2561 >> 8;
+   x = (x & 0x00ff'00ff'00ff'00ffull) * 6553601 >> 16;
+   return (x & 0x0000'ffff'0000'ffffull) * 42949672960001 >> 32;
+}
+
+/// \exclude
+// Length of the run of digits starting at p
+inline size_t digit_run(const char* p, const char* end) {
+   auto begin = p;
+   while (end - p >= 8 && is_eight_digits(load_eight_chars(p)))
+      p += 8;
+   // The last few characters, through a window which overlaps ones already checked
+   if (end - p < 8 && end - begin >= 8 && is_eight_digits(load_eight_chars(end - 8)))
+      return end - begin;
+   while (p != end && *p >= '0' && *p <= '9')
+      ++p;
+   return p - begin;
+}
+
+/// \exclude
+// Value of n <= 19 digits, 16 then 8 at a time
+inline uint64_t parse_digits(const char* p, size_t n) {
+   constexpr uint64_t powers[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+   uint64_t           result   = 0;
+   if (n < 8) {
+      while (n--)
+         result = result * 10 + (*p++ - '0');
+      return result;
+   }
+   result      = parse_eight_digits(load_eight_chars(p));
+   size_t rest = n - 8;
+   if (rest >= 8) {
+      result = result * 100000000 + parse_eight_digits(load_eight_chars(p + 8));
+      rest -= 8;
+   }
+   if (rest) {
+      // The last digits, from a window whose leading characters were already converted and are masked to 0
+      uint64_t window = load_eight_chars(p + n - 8) & (~uint64_t(0) << 8 * (8 - rest));
+      result          = result * powers[rest] + parse_eight_digits(window);
+   }
+   return result;
+}
+
+/// \exclude
+template <typename T>
+struct from_json_int_word {
+   using type = uint64_t;
+};
+
+#ifndef ABIEOS_NO_INT128
+/// \exclude
+template <>
+struct from_json_int_word<unsigned __int128> {
+   using type = unsigned __int128;
+};
+
+/// \exclude
+template <>
+struct from_json_int_word<__int128> {
+   using type = unsigned __int128;
+};
+#endif
+
+/// \exclude
+// Strings of 8 or more characters: digits are converted 8 or 16 at a time
+template <typename T>
+void from_json_int_swar(T& result, std::string_view r) {
+   using word = typename from_json_int_word<T>::type;
+   constexpr size_t word_digits = std::numeric_limits<word>::digits10 + 1;
+
+   auto pos      = r.data();
+   auto end      = pos + r.size();
+   bool negative = std::is_signed_v<T> && *pos == '-';
+   pos += negative;
+   auto digits = pos;
+   while (pos != end && *pos == '0')
+      ++pos;
+   size_t n = digit_run(pos, end);
+   // All but the last digit fit in word; only the last can overflow it
+   word value = 0;
+   check(n <= word_digits, convert_json_error(from_json_error::number_out_of_range));
+   if (n) {
+      size_t head = n - 1;
+      if (head > 19)
+         value = word(parse_digits(pos, head - 19)) * 10000000000000000000ull + parse_digits(pos + head - 19, 19);
+      else
+         value = parse_digits(pos, head);
+      word digit = pos[head] - '0';
+      check(value <= (word(-1) - digit) / 10, convert_json_error(from_json_error::number_out_of_range));
+      value = value * 10 + digit;
+      pos += n;
+   }
+   word limit = word(std::numeric_limits<T>::max()) + negative;
+   check(value <= limit, convert_json_error(from_json_error::number_out_of_range));
+   check(pos == end && pos != digits, convert_json_error(from_json_error::expected_int));
+   result = negative ? T(word(0) - value) : T(value);
+}
+
 /// \exclude
 template <typename T, typename S>
 void from_json_int(T& result, S& stream) {
    auto r = stream.get_string();
+   if (r.size() >= 8)
+      return from_json_int_swar(result, r);
    auto pos   = r.data();
    auto end   = pos + r.size();
    bool found = false;
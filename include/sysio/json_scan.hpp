@@ -0,0 +1,320 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SYSIO_JSON_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace sysio { namespace json_scan {
+
+/**
+ *  Bit i of each mask describes byte i of a 64-byte block
+ */
+struct block_masks {
+   uint64_t quote     = 0;
+   uint64_t backslash = 0;
+   uint64_t op        = 0; // { } [ ] : ,
+   uint64_t space     = 0; // space, tab, newline, carriage return
+   uint64_t control   = 0; // below 0x20
+   uint64_t non_ascii = 0;
+};
+
+using classify_fn = void (*)(const char* block, block_masks& masks);
+
+/**
+ *  Instruction sets which have a classifier
+ */
+enum class isa {
+   portable,
+   sse2,
+   avx2,
+};
+
+// SWAR helpers over 8 bytes; each sets bit 7 of the bytes which match
+inline uint64_t swar_eq(uint64_t x, uint8_t c) {
+   uint64_t t = x ^ (0x0101'0101'0101'0101ull * c);
+   return ~(((t & 0x7f7f'7f7f'7f7f'7f7full) + 0x7f7f'7f7f'7f7f'7f7full) | t) & 0x8080'8080'8080'8080ull;
+}
+
+inline uint64_t swar_below_0x20(uint64_t x) {
+   return ~(((x & 0x7f7f'7f7f'7f7f'7f7full) + 0x6060'6060'6060'6060ull) | x) & 0x8080'8080'8080'8080ull;
+}
+
+// Gathers bit 7 of each byte into 8 bits
+inline uint64_t swar_pack(uint64_t high) { return (high * 0x0002'0408'1020'4081ull) >> 56; }
+
+inline void classify_portable(const char* block, block_masks& masks) {
+   uint64_t quote = 0, backslash = 0, op = 0, space = 0, control = 0, non_ascii = 0;
+   for (unsigned i = 0; i < 64; i += 8) {
+      uint64_t x;
+      memcpy(&x, block + i, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      x = __builtin_bswap64(x);
+#endif
+      uint64_t lower = x | 0x2020'2020'2020'2020ull;
+      quote |= swar_pack(swar_eq(x, '"')) << i;
+      backslash |= swar_pack(swar_eq(x, '\\')) << i;
+      op |= swar_pack(swar_eq(lower, '{') | swar_eq(lower, '}') | swar_eq(x, ':') | swar_eq(x, ',')) << i;
+      space |= swar_pack(swar_eq(x, ' ') | swar_eq(x, '\t') | swar_eq(x, '\n') | swar_eq(x, '\r')) << i;
+      control |= swar_pack(swar_below_0x20(x)) << i;
+      non_ascii |= swar_pack(x & 0x8080'8080'8080'8080ull) << i;
+   }
+   masks = { quote, backslash, op, space, control, non_ascii };
+}
+
+#ifdef SYSIO_JSON_SCAN_X86
+// '[' and ']' are '{' and '}' without bit 0x20, so or-ing it in matches both brackets with one compare each
+
+__attribute__((target("sse2"))) inline void classify_sse2(const char* block, block_masks& masks) {
+   uint64_t quote = 0, backslash = 0, op = 0, space = 0, control = 0, non_ascii = 0;
+   for (unsigned i = 0; i < 64; i += 16) {
+      __m128i v     = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+      __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+      __m128i o     = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')),
+                                                _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                                                _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+      __m128i s     = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+      __m128i ctl   = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+      quote |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))))) << i;
+      backslash |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))))) << i;
+      op |= uint64_t(uint16_t(_mm_movemask_epi8(o))) << i;
+      space |= uint64_t(uint16_t(_mm_movemask_epi8(s))) << i;
+      control |= uint64_t(uint16_t(_mm_movemask_epi8(ctl))) << i;
+      non_ascii |= uint64_t(uint16_t(_mm_movemask_epi8(v))) << i;
+   }
+   masks = { quote, backslash, op, space, control, non_ascii };
+}
+
+__attribute__((target("avx2"))) inline void classify_avx2(const char* block, block_masks& masks) {
+   uint64_t quote = 0, backslash = 0, op = 0, space = 0, control = 0, non_ascii = 0;
+   for (unsigned i = 0; i < 64; i += 32) {
+      __m256i v     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+      __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+      __m256i o     = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')),
+                                                      _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')),
+                                                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+      __m256i s     = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+      __m256i ctl   = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+      quote |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))) << i;
+      backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))))) << i;
+      op |= uint64_t(uint32_t(_mm256_movemask_epi8(o))) << i;
+      space |= uint64_t(uint32_t(_mm256_movemask_epi8(s))) << i;
+      control |= uint64_t(uint32_t(_mm256_movemask_epi8(ctl))) << i;
+      non_ascii |= uint64_t(uint32_t(_mm256_movemask_epi8(v))) << i;
+   }
+   masks = { quote, backslash, op, space, control, non_ascii };
+}
+#endif
+
+inline bool supported(isa level) {
+#ifdef SYSIO_JSON_SCAN_X86
+   __builtin_cpu_init();
+   switch (level) {
+      case isa::portable: return true;
+      case isa::sse2: return __builtin_cpu_supports("sse2");
+      case isa::avx2: return __builtin_cpu_supports("avx2");
+   }
+   return false;
+#else
+   return level == isa::portable;
+#endif
+}
+
+// Returns nullptr if the build has no classifier for level
+inline classify_fn classifier(isa level) {
+   switch (level) {
+      case isa::portable: return classify_portable;
+#ifdef SYSIO_JSON_SCAN_X86
+      case isa::sse2: return classify_sse2;
+      case isa::avx2: return classify_avx2;
+#endif
+      default: return nullptr;
+   }
+}
+
+inline isa best_isa() {
+   if (supported(isa::avx2))
+      return isa::avx2;
+   if (supported(isa::sse2))
+      return isa::sse2;
+   return isa::portable;
+}
+
+// The classifier new indexers use; starts as the best one this CPU supports
+inline classify_fn& active_classifier() {
+   static classify_fn fn = classifier(best_isa());
+   return fn;
+}
+
+// Switches active_classifier(); for tests and benchmarks, not thread safe
+inline bool select_isa(isa level) {
+   if (!supported(level) || !classifier(level))
+      return false;
+   active_classifier() = classifier(level);
+   return true;
+}
+
+// Bit i is the parity of bits [0, i] of x
+inline uint64_t prefix_xor(uint64_t x) {
+   x ^= x << 1;
+   x ^= x << 2;
+   x ^= x << 4;
+   x ^= x << 8;
+   x ^= x << 16;
+   x ^= x << 32;
+   return x;
+}
+
+/**
+ *  Validates UTF-8 across blocks. Blocks are only visited where they contain a non-ASCII byte or
+ *  finish a sequence which the previous block started.
+ */
+struct utf8_validator {
+   uint8_t remaining = 0; // continuation bytes the current sequence still needs
+   uint8_t lo        = 0x80;
+   uint8_t hi        = 0xbf;
+
+   bool idle(uint64_t non_ascii) const { return !non_ascii && !remaining; }
+
+   // Returns the offset of the first invalid byte, or 64
+   unsigned validate(const char* block, uint64_t non_ascii) {
+      unsigned i = 0;
+      while (true) {
+         for (; remaining && i < 64; ++i, --remaining) {
+            auto c = uint8_t(block[i]);
+            if (c < lo || c > hi)
+               return i;
+            lo = 0x80;
+            hi = 0xbf;
+         }
+         uint64_t pending = i < 64 ? non_ascii >> i << i : 0;
+         if (!pending)
+            return 64;
+         i      = __builtin_ctzll(pending);
+         auto c = uint8_t(block[i]);
+         if (c >= 0xc2 && c <= 0xdf)
+            remaining = 1;
+         else if (c == 0xe0)
+            remaining = 2, lo = 0xa0;
+         else if (c == 0xed)
+            remaining = 2, hi = 0x9f;
+         else if (c >= 0xe1 && c <= 0xef)
+            remaining = 2;
+         else if (c == 0xf0)
+            remaining = 3, lo = 0x90;
+         else if (c == 0xf4)
+            remaining = 3, hi = 0x8f;
+         else if (c >= 0xf1 && c <= 0xf3)
+            remaining = 3;
+         else
+            return i;
+         ++i;
+      }
+   }
+};
+
+/**
+ *  Finds the structural characters of a json document 64 bytes at a time. These are { } [ ] : , outside
+ *  strings, every unescaped quote, every backslash inside a string, and the first character of each number
+ *  or literal. Blocks are indexed on demand, so a caller which stops early never looks at the rest.
+ *
+ *  Control characters inside strings and invalid UTF-8 anywhere are found in the same pass; first_invalid
+ *  holds the offset of the earliest one indexed so far.
+ */
+class indexer {
+   const char* json;
+   size_t      size;
+   classify_fn classify;
+   size_t      next_block     = 0;
+   size_t      base           = 0; // of bits
+   uint64_t    bits           = 0;
+   uint64_t    next_escaped   = 0; // the next block starts with an escaped character
+   uint64_t    in_string      = 0; // all ones if the next block starts inside a string
+   uint64_t    in_scalar      = 0; // the previous block ended inside a number or literal
+   utf8_validator utf8;
+
+   // Bit i is set for characters escaped by a backslash; simdjson's escape scanner
+   uint64_t escaped_chars(uint64_t backslash) {
+      if (!backslash) {
+         uint64_t escaped = next_escaped;
+         next_escaped     = 0;
+         return escaped;
+      }
+      const uint64_t odd_bits        = 0xaaaa'aaaa'aaaa'aaaaull;
+      uint64_t       potential       = backslash & ~next_escaped;
+      uint64_t       escape_and_term = (((potential << 1) | odd_bits) - potential) ^ odd_bits;
+      uint64_t       escaped         = escape_and_term ^ (backslash | next_escaped);
+      next_escaped                   = (escape_and_term & backslash) >> 63;
+      return escaped;
+   }
+
+   // Out of line so that next(), which runs once per structural character, stays small where it's inlined
+   __attribute__((noinline)) void index_block() {
+      const char* block     = json + next_block;
+      size_t      remaining = size - next_block;
+      char        tail[64];
+      if (remaining < 64) {
+         memcpy(tail, block, remaining);
+         memset(tail + remaining, ' ', 64 - remaining);
+         block = tail;
+      }
+      block_masks m;
+      classify(block, m);
+
+      uint64_t quote  = m.quote & ~escaped_chars(m.backslash);
+      uint64_t string = prefix_xor(quote) ^ in_string; // from an opening quote up to its closing quote
+      in_string       = uint64_t(int64_t(string) >> 63);
+      uint64_t scalar = ~(m.op | m.space | quote | string);
+      uint64_t starts = scalar & ~((scalar << 1) | in_scalar);
+      in_scalar       = scalar >> 63;
+
+      uint64_t invalid = m.control & string;
+      if (!utf8.idle(m.non_ascii)) {
+         unsigned at = utf8.validate(block, m.non_ascii);
+         if (at < 64)
+            invalid |= uint64_t(1) << at;
+      }
+      if (invalid && first_invalid == size_t(-1))
+         first_invalid = next_block + __builtin_ctzll(invalid);
+
+      base = next_block;
+      bits = (m.op & ~string) | quote | (m.backslash & string) | starts;
+      next_block += 64;
+   }
+
+ public:
+   size_t first_invalid = size_t(-1);
+
+   indexer(const char* json, size_t size, classify_fn classify = active_classifier())
+       : json{ json }, size{ size }, classify{ classify } {}
+
+   // Offset of the next structural character, or size if there are no more
+   size_t next() {
+      while (!bits) {
+         if (next_block >= size)
+            return size;
+         index_block();
+      }
+      size_t pos = base + __builtin_ctzll(bits);
+      bits &= bits - 1;
+      return pos;
+   }
+}; // indexer
+
+}} // namespace sysio::json_scan
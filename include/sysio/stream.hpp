@@ -142,6 +142,40 @@ struct size_stream {
    }
 };
 
+// Writes as much as fits into a fixed buffer, but counts everything like snprintf does. Callers compare size with the
+// buffer size to find out whether the output was truncated.
+struct truncating_buf_stream {
+   char*  pos;
+   char*  end;
+   size_t size = 0;
+
+   truncating_buf_stream(char* pos, size_t size) : pos{ pos }, end{ pos + size } {}
+
+   void write(char c) {
+      if (pos != end)
+         *pos++ = c;
+      ++size;
+   }
+
+   void write(const void* src, std::size_t sz) {
+      auto n = std::min(sz, std::size_t(end - pos));
+      if (n)
+         memcpy(pos, src, n);
+      pos += n;
+      size += sz;
+   }
+
+   template <int Size>
+   void write(const char (&src)[Size]) {
+      write(src, Size);
+   }
+
+   template <typename T>
+   void write_raw(const T& v) {
+      write(&v, sizeof(v));
+   }
+};
+
 template <typename S>
 void increase_indent(S&) {
 }
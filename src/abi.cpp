@@ -1,4 +1,10 @@
+#include <algorithm>
 #include <charconv>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <sysio/abi.hpp>
 #include "abieos.hpp"
 
@@ -25,12 +31,17 @@ struct abi_serializer_impl : abi_serializer {
                              bool start) const override {
         return ::abieos::bin_to_json((T*)nullptr, state, allow_extensions, type, start);
     }
+    void bin_to_json(::abieos::bin_to_json_buf_state& state, bool allow_extensions, const abi_type* type,
+                             bool start) const override {
+        return ::abieos::bin_to_json((T*)nullptr, state, allow_extensions, type, start);
+    }
 };
 
 template <typename T>
 constexpr auto abi_serializer_for = abi_serializer_impl<T>{};
 
-abi_type::alias resolve(std::map<std::string, abi_type>& abi_types, const abi_type::alias_def* type, int depth);
+abi_type::alias resolve(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived,
+                        const abi_type::alias_def* type, int depth);
 
 template<typename... T, typename... A>
 bool holds_any_alternative(const std::variant<A...>& v) {
@@ -44,27 +55,38 @@ constexpr void for_each_abi_type(F f) {
     std::apply([&f](auto&& ...t) { (f(&t), ...); }, basic_abi_types{});
 }
 
-abi_type* get_type(std::map<std::string, abi_type>& abi_types, const std::string& name, int depth) {
+// Types created for a `?`, `[]`, `[N]` or `$` suffix go into `derived`, which is either abi_types itself or a
+// separate table when abi_types must not be modified.
+abi_type* get_type(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived,
+                   const std::string& name, int depth) {
     sysio::check(depth < 32, sysio::convert_abi_error(abi_error::recursion_limit_reached));
     auto it = abi_types.find(name);
     if (it == abi_types.end()) {
+        if (auto* builtin = get_builtin_type(name))
+            return builtin;
+        if (&derived != &abi_types) {
+            if (auto d = derived.find(name); d != derived.end())
+                return &d->second;
+        }
         if (ends_with(name, "?")) {
-            auto base = get_type(abi_types, name.substr(0, name.size() - 1), depth + 1);
+            auto base = get_type(abi_types, derived, name.substr(0, name.size() - 1), depth + 1);
             // removed abi_type::array from invalid types for nesting, optional array should work
             sysio::check(
                 !holds_any_alternative<abi_type::optional, abi_type::extension>(base->_data),
                 "Invalid optional nesting for type: " + name
             );
-            auto [iter, success] = abi_types.try_emplace(name, name, abi_type::optional{base}, &abi_serializer_for< ::abieos::pseudo_optional>);
+            auto [iter, success] = derived.try_emplace(name, name, abi_type::optional{base},
+                                                       &abi_serializer_for< ::abieos::pseudo_optional>);
             return &iter->second;
         } else if (ends_with(name, "[]")) {
-            auto element = get_type(abi_types, name.substr(0, name.size() - 2), depth + 1);
+            auto element = get_type(abi_types, derived, name.substr(0, name.size() - 2), depth + 1);
             // removed abi_type::array from invalid types for nesting, array of arrays should work
             sysio::check(
                 !holds_any_alternative<abi_type::optional, abi_type::extension>(element->_data),
                 "Invalid array nesting for type: " + name
             );
-            auto [iter, success] = abi_types.try_emplace(name, name, abi_type::array{element}, &abi_serializer_for< ::abieos::pseudo_array>);
+            auto [iter, success] = derived.try_emplace(name, name, abi_type::array{element},
+                                                       &abi_serializer_for< ::abieos::pseudo_array>);
             return &iter->second;
         } else if (ends_with(name, "]")) {
             // fixed_array
@@ -80,22 +102,23 @@ abi_type* get_type(std::map<std::string, abi_type>& abi_types, const std::string
                 } else {
                     sysio::check(name[idx + 1] != '0', "Leading zeros not allowed for fixed array lengrh specification");
                 }
-                auto element = get_type(abi_types, name.substr(0, idx), depth + 1);
+                auto element = get_type(abi_types, derived, name.substr(0, idx), depth + 1);
                 // removed abi_type::array from invalid types for nesting, array of arrays should work
                 sysio::check(!holds_any_alternative<abi_type::optional, abi_type::extension>(element->_data),
                              "Invalid array nesting for type: " + name);
-                auto [iter, success] = abi_types.try_emplace(name, name, abi_type::fixed_array{element, size_t(size)},
+                auto [iter, success] = derived.try_emplace(name, name, abi_type::fixed_array{element, size_t(size)},
                                                              &abi_serializer_for<::abieos::pseudo_fixed_array>);
                 return &iter->second;
             } else
                 sysio::check(false, "']' character found without matching '[' in type specification");
         } else if (ends_with(name, "$")) {
-            auto base = get_type(abi_types, name.substr(0, name.size() - 1), depth + 1);
+            auto base = get_type(abi_types, derived, name.substr(0, name.size() - 1), depth + 1);
             sysio::check(
                 !std::holds_alternative<abi_type::extension>(base->_data),
                 "Invalid extension nesting for type: " + name
             );
-            auto [iter, success] = abi_types.try_emplace(name, name, abi_type::extension{base}, &abi_serializer_for< ::abieos::pseudo_extension>);
+            auto [iter, success] = derived.try_emplace(name, name, abi_type::extension{base},
+                                                       &abi_serializer_for< ::abieos::pseudo_extension>);
             return &iter->second;
         } else
            sysio::check(false, sysio::convert_abi_error(abi_error::unknown_type));
@@ -105,7 +128,7 @@ abi_type* get_type(std::map<std::string, abi_type>& abi_types, const std::string
     if (auto* alias = std::get_if<abi_type::alias>(&it->second._data)) {
         return alias->type;
     } else if(auto* alias = std::get_if<const abi_type::alias_def*>(&it->second._data)) {
-        auto base = resolve(abi_types, *alias, depth);
+        auto base = resolve(abi_types, derived, *alias, depth);
         it->second._data = base;
         return base.type;
     }
@@ -113,15 +136,20 @@ abi_type* get_type(std::map<std::string, abi_type>& abi_types, const std::string
     return &it->second;
 }
 
-abi_type::struct_ resolve(std::map<std::string, abi_type>& abi_types, const struct_def* type, int depth) {
+abi_type* get_type(flat_map<std::string, abi_type>& abi_types, const std::string& name, int depth) {
+    return get_type(abi_types, abi_types, name, depth);
+}
+
+abi_type::struct_ resolve(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived,
+                          const struct_def* type, int depth) {
    sysio::check(depth < 32,
         sysio::convert_abi_error(abi_error::recursion_limit_reached));
     abi_type::struct_ result;
     if (!type->base.empty()) {
-        auto base = get_type(abi_types, type->base, depth + 1);
+        auto base = get_type(abi_types, derived, type->base, depth + 1);
 
         if(auto* base_def = std::get_if<const struct_def*>(&base->_data)) {
-            auto b = resolve(abi_types, *base_def, depth + 1);
+            auto b = resolve(abi_types, derived, *base_def, depth + 1);
             base->_data = std::move(b);
         }
         if(auto* b = std::get_if<abi_type::struct_>(&base->_data)) {
@@ -131,38 +159,41 @@ abi_type::struct_ resolve(std::map<std::string, abi_type>& abi_types, const stru
         }
     }
     for (auto& field : type->fields) {
-        auto t = get_type(abi_types, field.type, depth + 1);
+        auto t = get_type(abi_types, derived, field.type, depth + 1);
         result.fields.push_back(abi_field{field.name, t});
     }
     return result;
 }
 
 
-abi_type::variant resolve(std::map<std::string, abi_type>& abi_types, const variant_def* type, int depth) {
+abi_type::variant resolve(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived,
+                          const variant_def* type, int depth) {
    sysio::check(depth < 32,
         sysio::convert_abi_error(abi_error::recursion_limit_reached));
     abi_type::variant result;
     for (const std::string& field : type->types) {
-        auto t = get_type(abi_types, field, depth + 1);
+        auto t = get_type(abi_types, derived, field, depth + 1);
         result.push_back({field, t});
     }
     return result;
 }
 
-abi_type::alias resolve(std::map<std::string, abi_type>& abi_types, const abi_type::alias_def* type, int depth) {
-    auto t = get_type(abi_types, *type, depth + 1);
+abi_type::alias resolve(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived,
+                        const abi_type::alias_def* type, int depth) {
+    auto t = get_type(abi_types, derived, *type, depth + 1);
     sysio::check(!std::holds_alternative<abi_type::extension>(t->_data),
         sysio::convert_abi_error(abi_error::extension_typedef));
     return abi_type::alias{t};
 }
 
 struct fill_t {
-   std::map<std::string, abi_type>& abi_types;
+   flat_map<std::string, abi_type>& abi_types;
+   flat_map<std::string, abi_type>& derived;
    abi_type& type;
    int depth;
    template<typename T>
-   auto operator()(T& t) -> std::void_t<decltype(resolve(abi_types, t, depth))> {
-      auto x = resolve(abi_types, t, depth);
+   auto operator()(T& t) -> std::void_t<decltype(resolve(abi_types, derived, t, depth))> {
+      auto x = resolve(abi_types, derived, t, depth);
       type._data = std::move(x);
    }
    template<typename T>
@@ -170,59 +201,582 @@ struct fill_t {
    }
 };
 
-void fill(std::map<std::string, abi_type>& abi_types, abi_type& type, int depth) {
-   return std::visit(fill_t{abi_types, type, depth}, type._data);
+void fill(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived, abi_type& type,
+          int depth) {
+   return std::visit(fill_t{abi_types, derived, type, depth}, type._data);
+}
+
+// Emits type's program. Builtins are compiled along with the get_builtin_type() table; aliases don't have a program
+// since get_type() never returns them.
+void emit_program(abi_type& type) {
+   auto& program = type.program;
+   auto value = [&](const abi_type* t) {
+      if (std::holds_alternative<abi_type::builtin>(t->_data))
+         program.push_back(t->program.front());
+      else
+         program.push_back({abi_opcode::call, 0, t});
+   };
+   auto index = [&](const std::vector<abi_field>& fields) {
+      if (fields.size() >= 0xffff)
+         return;
+      // At most half full, so probes stay short
+      size_t size = 2;
+      while (size < fields.size() * 2)
+         size *= 2;
+      type.name_index.assign(size, 0);
+      for (uint32_t i = 0; i < fields.size(); ++i) {
+         auto h = name_hash(fields[i].name);
+         auto j = h & (size - 1);
+         while (type.name_index[j])
+            j = (j + 1) & (size - 1);
+         type.name_index[j] = (h & 0xffff0000) | (i + 1);
+      }
+   };
+   if (auto* s = std::get_if<abi_type::struct_>(&type._data)) {
+      program.push_back({abi_opcode::object, uint32_t(s->fields.size()), nullptr, &s->fields});
+      for (auto& field : s->fields)
+         value(field.type);
+      index(s->fields);
+   } else if (auto* v = std::get_if<abi_type::variant>(&type._data)) {
+      program.push_back({abi_opcode::variant, uint32_t(v->size()), &type, v});
+      for (auto& field : *v)
+         value(field.type);
+      index(*v);
+   } else if (auto* o = std::get_if<abi_type::optional>(&type._data)) {
+      program.push_back({abi_opcode::optional});
+      value(o->type);
+   } else if (auto* e = std::get_if<abi_type::extension>(&type._data)) {
+      program.push_back({abi_opcode::extension});
+      value(e->type);
+   } else if (auto* a = std::get_if<abi_type::array>(&type._data)) {
+      program.push_back({abi_opcode::array, abi_variable_size});
+      value(a->type);
+   } else if (auto* fa = std::get_if<abi_type::fixed_array>(&type._data)) {
+      program.push_back({abi_opcode::fixed_array, uint32_t(fa->size)});
+      value(fa->type);
+   }
+}
+
+// Sets type's fixed_size and field offsets once the types it contains have theirs. A type which contains itself stays
+// variable-size.
+void compute_fixed_size(abi_type& type) {
+   auto add = [](uint64_t size, uint64_t n) { return size + n < abi_variable_size ? size + n : abi_variable_size; };
+   if (auto* s = std::get_if<abi_type::struct_>(&type._data)) {
+      uint64_t offset = 0;
+      for (auto& field : s->fields) {
+         field.offset = uint32_t(offset);
+         if (offset != abi_variable_size)
+            offset = field.type->fixed_size == abi_variable_size ? abi_variable_size
+                                                                 : add(offset, field.type->fixed_size);
+      }
+      type.fixed_size = uint32_t(offset);
+   } else if (auto* fa = std::get_if<abi_type::fixed_array>(&type._data)) {
+      if (fa->type->fixed_size != abi_variable_size && fa->size < abi_variable_size)
+         type.fixed_size = add(0, uint64_t(fa->type->fixed_size) * fa->size);
+   } else if (auto* a = std::get_if<abi_type::array>(&type._data)) {
+      type.program.front().arg = a->type->fixed_size;
+   }
 }
 
+// Compiles the program of root and of every type it calls
+void compile(abi_type& root) {
+   if (!root.program.empty())
+      return;
+   emit_program(root);
+   // Depth first, so callees have their sizes before their callers
+   std::vector<std::pair<abi_type*, size_t>> stack{{&root, 1}};
+   while (!stack.empty()) {
+      auto [type, next] = stack.back();
+      auto& program = type->program;
+      while (next < program.size() && !(program[next].code == abi_opcode::call && program[next].type->program.empty()))
+         ++next;
+      if (next < program.size()) {
+         stack.back().second = next + 1;
+         auto* callee = const_cast<abi_type*>(program[next].type);
+         emit_program(*callee);
+         stack.push_back({callee, 1});
+         continue;
+      }
+      compute_fixed_size(*type);
+      stack.pop_back();
+   }
 }
 
+// Resolves and compiles root and every unresolved type it contains, then publishes them to lock-free readers. Types
+// are only modified while unpublished, under the derived_types lock.
+void resolve_lazily(flat_map<std::string, abi_type>& abi_types, flat_map<std::string, abi_type>& derived,
+                    abi_type& root) {
+   std::vector<abi_type*> pending{&root}, found;
+   std::unordered_set<abi_type*> seen{&root};
+   auto add = [&](abi_type* type) {
+      if (!type->resolved.load(std::memory_order_relaxed) && seen.insert(type).second)
+         pending.push_back(type);
+   };
+   while (!pending.empty()) {
+      auto* type = pending.back();
+      pending.pop_back();
+      found.push_back(type);
+      fill(abi_types, derived, *type, 0);
+      if (auto* s = std::get_if<abi_type::struct_>(&type->_data)) {
+         for (auto& field : s->fields)
+            add(const_cast<abi_type*>(field.type));
+      } else if (auto* v = std::get_if<abi_type::variant>(&type->_data)) {
+         for (auto& field : *v)
+            add(const_cast<abi_type*>(field.type));
+      } else if (auto* o = std::get_if<abi_type::optional>(&type->_data)) {
+         add(o->type);
+      } else if (auto* e = std::get_if<abi_type::extension>(&type->_data)) {
+         add(e->type);
+      } else if (auto* a = std::get_if<abi_type::array>(&type->_data)) {
+         add(a->type);
+      } else if (auto* fa = std::get_if<abi_type::fixed_array>(&type->_data)) {
+         add(fa->type);
+      }
+   }
+   compile(root);
+   for (auto* type : found)
+      type->resolved.store(true, std::memory_order_release);
+}
+
+}
+
+abi_type* sysio::get_builtin_type(std::string_view name) {
+   // Intentionally never destroyed; abis may still be in use during static destruction
+   static auto* types = [] {
+      auto* types = new flat_map<std::string, abi_type>;
+      uint32_t builtin_index = 0;
+      for_each_abi_type([&](auto* p) {
+         const char* name = get_type_name(p);
+         using T = std::decay_t<decltype(*p)>;
+         auto [it, inserted] = types->try_emplace(name, name, abi_type::builtin{}, &abi_serializer_for<T>);
+         if (inserted) {
+            it->second.program.push_back({abi_opcode::builtin, builtin_index});
+            it->second.fixed_size = ::abieos::fixed_bin_size<T>();
+         }
+         ++builtin_index;
+      });
+      auto* asset_type     = &types->find("asset")->second;
+      auto* name_type      = &types->find("name")->second;
+      auto& extended_asset = types->try_emplace("extended_asset", "extended_asset",
+                                                abi_type::struct_{nullptr, {{"quantity", asset_type},
+                                                                            {"contract", name_type}}},
+                                                &abi_serializer_for<::abieos::pseudo_object>).first->second;
+      compile(extended_asset);
+      for (auto& [_, type] : *types)
+         type.resolved = true;
+      return types;
+   }();
+   auto it = types->find(name);
+   return it != types->end() ? &it->second : nullptr;
+}
 
 const abi_type* sysio::abi::get_type(const std::string& name) {
+   if (source)
+      return std::as_const(*this).get_type(name);
    return ::get_type(abi_types, name, 0);
 }
 
-void sysio::convert(const abi_def& abi, sysio::abi& c) {
+const abi_type* sysio::abi::get_type(const std::string& name) const {
+   auto it = abi_types.find(name);
+   if (it != abi_types.end() && (!source || it->second.resolved.load(std::memory_order_acquire))) {
+      if (auto* alias = std::get_if<abi_type::alias>(&it->second._data))
+         return alias->type;
+      sysio::check(!std::holds_alternative<const abi_type::alias_def*>(it->second._data),
+                   sysio::convert_abi_error(abi_error::bad_abi));
+      return &it->second;
+   }
+   if (it == abi_types.end()) {
+      if (auto* builtin = get_builtin_type(name))
+         return builtin;
+   }
+   // Only derived_types and unpublished types of a lazy abi are written below; abi_types itself is never inserted into.
+   // convert() has already resolved every alias in abi_types.
+   auto& types = const_cast<flat_map<std::string, abi_type>&>(abi_types);
+   std::lock_guard<std::mutex> lock{derived_types->mutex};
+   auto* type = ::get_type(types, derived_types->types, name, 0);
+   if (!source) {
+      compile(*type);
+      return type;
+   }
+   if (!type->resolved.load(std::memory_order_relaxed))
+      resolve_lazily(types, derived_types->types, *type);
+   // An alias is published along with its target
+   if (auto alias = types.find(name); alias != types.end())
+      alias->second.resolved.store(true, std::memory_order_release);
+   return type;
+}
+
+// Adds the types of abi to c without resolving them
+void add_types(const abi_def& abi, sysio::abi& c) {
     for (auto& a : abi.actions)
         c.action_types[a.name] = a.type;
     for (auto& t : abi.tables)
         c.table_types[t.name] = t.type;
     for (auto& r : abi.action_results.value)
         c.action_result_types[r.name] = r.result_type;
-    for_each_abi_type([&](auto* p) {
-        const char* name = get_type_name(p);
-        c.abi_types.try_emplace(name, name, abi_type::builtin{}, &abi_serializer_for<std::decay_t<decltype(*p)>>);
-    });
-    {
-        c.abi_types.try_emplace("extended_asset", "extended_asset",
-                                abi_type::struct_{nullptr, {{"quantity", &c.abi_types.find("asset")->second},
-                                                            {"contract", &c.abi_types.find("name")->second}}},
-                                &abi_serializer_for<::abieos::pseudo_object>);
-    }
 
     for (auto& t : abi.types) {
        sysio::check(!t.new_type_name.empty(),
             sysio::convert_abi_error(abi_error::missing_name));
         auto [_, inserted] = c.abi_types.try_emplace(t.new_type_name, t.new_type_name, &t.type, nullptr);
-        sysio::check(inserted,
+        sysio::check(inserted && !get_builtin_type(t.new_type_name),
             sysio::convert_abi_error(abi_error::redefined_type));
     }
     for (auto& s : abi.structs) {
        sysio::check(!s.name.empty(),
             sysio::convert_abi_error(abi_error::missing_name));
         auto [it, inserted] = c.abi_types.try_emplace(s.name, s.name, &s, &abi_serializer_for<::abieos::pseudo_object>);
-        sysio::check(inserted,
+        sysio::check(inserted && !get_builtin_type(s.name),
             sysio::convert_abi_error(abi_error::redefined_type));
     }
     for (auto& v : abi.variants.value) {
        sysio::check(!v.name.empty(),
             sysio::convert_abi_error(abi_error::missing_name));
         auto [it, inserted] = c.abi_types.try_emplace(v.name, v.name, &v, &abi_serializer_for<::abieos::pseudo_variant>);
-        sysio::check(inserted,
+        sysio::check(inserted && !get_builtin_type(v.name),
             sysio::convert_abi_error(abi_error::redefined_type));
     }
-    for (auto& [_, t] : c.abi_types) {
-        fill(c.abi_types, t, 0);
+}
+
+// Resolves and compiles the types added by add_types(), and the action, table and action result types
+void resolve_types(sysio::abi& c) {
+    // fill() may add types, which invalidates abi_types iterators
+    for (size_t i = 0; i < c.abi_types.size(); ++i) {
+        fill(c.abi_types, c.abi_types, (c.abi_types.begin() + i)->second, 0);
+    }
+
+    auto resolve = [&](auto& resolved, auto& names) {
+        for (auto& [name, type] : names) {
+            try {
+                resolved[name] = c.get_type(type);
+            } catch (std::exception&) {
+                resolved[name] = nullptr;
+            }
+        }
+    };
+    resolve(c.action_abi_types, c.action_types);
+    resolve(c.table_abi_types, c.table_types);
+    resolve(c.action_result_abi_types, c.action_result_types);
+
+    for (auto& [_, type] : c.abi_types)
+        compile(type);
+}
+
+void sysio::convert(const abi_def& abi, sysio::abi& c) {
+    add_types(abi, c);
+    resolve_types(c);
+}
+
+namespace {
+
+bool is_derived_name(const std::string& name) {
+    return ends_with(name, "?") || ends_with(name, "]") || ends_with(name, "$");
+}
+
+// The named types of an abi_def
+struct def_types {
+    flat_map<std::string, const std::string*> aliases;
+    flat_map<std::string, const struct_def*>  structs;
+    flat_map<std::string, const variant_def*> variants;
+
+    explicit def_types(const abi_def& def) {
+        for (auto& t : def.types)
+            aliases.try_emplace(t.new_type_name, &t.type);
+        for (auto& s : def.structs)
+            structs.try_emplace(s.name, &s);
+        for (auto& v : def.variants.value)
+            variants.try_emplace(v.name, &v);
+    }
+};
+
+// The type previous has under name, looking through types it reuses itself. is_alias is set for real aliases.
+const abi_type* named_type(const abi& previous, const std::string& name, bool& is_alias) {
+    is_alias = false;
+    auto it = previous.abi_types.find(name);
+    if (it == previous.abi_types.end() || is_derived_name(name))
+        return nullptr;
+    if (auto* alias = std::get_if<abi_type::alias>(&it->second._data)) {
+        is_alias = alias->type->name != name;
+        return alias->type;
     }
+    return &it->second;
+}
+
+// Compares the types of a new abi_def with the compiled types of a previous abi. Types are compared one level deep;
+// the named types a type refers to are collected in deps, to be compared separately.
+struct type_diff {
+    const def_types& defs;
+    const abi&       previous;
+
+    const abi_type* named(const std::string& name, bool& is_alias) const {
+        return named_type(previous, name, is_alias);
+    }
+
+    const abi_type* named(const std::string& name) const {
+        bool is_alias;
+        return named(name, is_alias);
+    }
+
+    // Whether the type expression expr of the new abi is the same as type in previous
+    bool same(const std::string& expr, const abi_type* type, std::vector<std::string>& deps, int depth = 0) const {
+        if (depth >= 32)
+            return false;
+        if (ends_with(expr, "?")) {
+            auto* t = std::get_if<abi_type::optional>(&type->_data);
+            return t && same(expr.substr(0, expr.size() - 1), t->type, deps, depth + 1);
+        } else if (ends_with(expr, "[]")) {
+            auto* t = std::get_if<abi_type::array>(&type->_data);
+            return t && same(expr.substr(0, expr.size() - 2), t->type, deps, depth + 1);
+        } else if (ends_with(expr, "]")) {
+            auto* t   = std::get_if<abi_type::fixed_array>(&type->_data);
+            auto  idx = expr.find_last_of('[');
+            return t && idx != std::string::npos &&
+                   expr.substr(idx + 1, expr.size() - idx - 2) == std::to_string(t->size) &&
+                   same(expr.substr(0, idx), t->type, deps, depth + 1);
+        } else if (ends_with(expr, "$")) {
+            auto* t = std::get_if<abi_type::extension>(&type->_data);
+            return t && same(expr.substr(0, expr.size() - 1), t->type, deps, depth + 1);
+        }
+        if (auto it = defs.aliases.find(expr); it != defs.aliases.end()) {
+            deps.push_back(expr);
+            return same(*it->second, type, deps, depth + 1);
+        }
+        if (defs.structs.find(expr) != defs.structs.end() || defs.variants.find(expr) != defs.variants.end()) {
+            deps.push_back(expr);
+            return named(expr) == type;
+        }
+        return get_builtin_type(expr) == type;
+    }
+
+    // Fields of s, including those of its bases
+    bool flatten(const struct_def& s, std::vector<const field_def*>& fields, std::vector<std::string>& deps,
+                 int depth = 0) const {
+        if (depth >= 32)
+            return false;
+        if (!s.base.empty()) {
+            auto base = s.base;
+            for (int i = 0; i < 32; ++i) {
+                auto it = defs.aliases.find(base);
+                if (it == defs.aliases.end())
+                    break;
+                deps.push_back(base);
+                base = *it->second;
+            }
+            auto it = defs.structs.find(base);
+            if (it == defs.structs.end())
+                return false;
+            deps.push_back(base);
+            if (!flatten(*it->second, fields, deps, depth + 1))
+                return false;
+        }
+        for (auto& field : s.fields)
+            fields.push_back(&field);
+        return true;
+    }
+
+    // Whether the named type is unchanged, apart from changes to deps
+    bool same_named(const std::string& name, std::vector<std::string>& deps) const {
+        bool is_alias;
+        auto* type = named(name, is_alias);
+        if (!type)
+            return false;
+        if (auto it = defs.aliases.find(name); it != defs.aliases.end())
+            return is_alias && same(*it->second, type, deps);
+        if (is_alias)
+            return false;
+        if (auto it = defs.structs.find(name); it != defs.structs.end()) {
+            auto*                          s = type->as_struct();
+            std::vector<const field_def*> fields;
+            if (!s || !flatten(*it->second, fields, deps) || fields.size() != s->fields.size())
+                return false;
+            for (size_t i = 0; i < fields.size(); ++i)
+                if (fields[i]->name != s->fields[i].name || !same(fields[i]->type, s->fields[i].type, deps))
+                    return false;
+            return true;
+        }
+        if (auto it = defs.variants.find(name); it != defs.variants.end()) {
+            auto* v = type->as_variant();
+            if (!v || it->second->types.size() != v->size())
+                return false;
+            for (size_t i = 0; i < v->size(); ++i)
+                if (it->second->types[i] != (*v)[i].name || !same(it->second->types[i], (*v)[i].type, deps))
+                    return false;
+            return true;
+        }
+        return false;
+    }
+};
+
+// Compares the types of a new abi_def with the definitions a lazy abi was converted from, so that none of the lazy
+// abi's types has to be resolved. Collects the named types a type refers to in deps, as type_diff does.
+struct source_diff {
+    const def_types& defs;
+    def_types        previous;
+
+    void refs(std::string expr, std::vector<std::string>& deps) const {
+        for (int i = 0; i < 32 && !expr.empty(); ++i) {
+            if (ends_with(expr, "?") || ends_with(expr, "$"))
+                expr.pop_back();
+            else if (auto idx = expr.find_last_of('['); ends_with(expr, "]") && idx != std::string::npos)
+                expr.resize(idx);
+            else
+                break;
+        }
+        if (defs.aliases.find(expr) != defs.aliases.end() || defs.structs.find(expr) != defs.structs.end() ||
+            defs.variants.find(expr) != defs.variants.end())
+            deps.push_back(std::move(expr));
+    }
+
+    // Whether the named type is defined the same way, apart from changes to deps
+    bool same_named(const std::string& name, std::vector<std::string>& deps) const {
+        if (auto it = defs.aliases.find(name); it != defs.aliases.end()) {
+            refs(*it->second, deps);
+            auto p = previous.aliases.find(name);
+            return p != previous.aliases.end() && *p->second == *it->second;
+        }
+        if (auto it = defs.structs.find(name); it != defs.structs.end()) {
+            auto& fields = it->second->fields;
+            if (!it->second->base.empty())
+                refs(it->second->base, deps);
+            for (auto& field : fields)
+                refs(field.type, deps);
+            auto p = previous.structs.find(name);
+            return p != previous.structs.end() && p->second->base == it->second->base &&
+                   std::equal(fields.begin(), fields.end(), p->second->fields.begin(), p->second->fields.end(),
+                              [](auto& a, auto& b) { return a.name == b.name && a.type == b.type; });
+        }
+        if (auto it = defs.variants.find(name); it != defs.variants.end()) {
+            for (auto& type : it->second->types)
+                refs(type, deps);
+            auto p = previous.variants.find(name);
+            return p != previous.variants.end() && p->second->types == it->second->types;
+        }
+        return false;
+    }
+};
+
+// Whether each named type of def changed: its definition, or the definition of a type it depends on, differs from
+// previous. Adds the names of the types which were added, removed or changed to changed, sorted.
+flat_map<std::string, bool> changed_types(const abi_def& def, const abi& previous, std::vector<std::string>& changed) {
+    def_types                  defs{def};
+    type_diff                  diff{defs, previous};
+    std::optional<source_diff> lazy_diff;
+    if (previous.source)
+        lazy_diff.emplace(source_diff{defs, def_types{*previous.source}});
+    std::vector<std::string> names;
+    for (auto& t : def.types)
+        names.push_back(t.new_type_name);
+    for (auto& s : def.structs)
+        names.push_back(s.name);
+    for (auto& v : def.variants.value)
+        names.push_back(v.name);
+
+    // A type changes if its definition or any type it depends on changes
+    flat_map<std::string, bool>                     is_changed;
+    flat_map<std::string, std::vector<std::string>> dependents;
+    std::vector<std::string>                        pending;
+    for (auto& name : names) {
+        std::vector<std::string> deps;
+        bool                     same = lazy_diff ? lazy_diff->same_named(name, deps) : diff.same_named(name, deps);
+        if (!is_changed.try_emplace(name, !same).second)
+            continue;
+        if (!same)
+            pending.push_back(name);
+        for (auto& dep : deps)
+            if (dep != name)
+                dependents[dep].push_back(name);
+    }
+    while (!pending.empty()) {
+        auto name = std::move(pending.back());
+        pending.pop_back();
+        if (auto it = dependents.find(name); it != dependents.end()) {
+            for (auto& dependent : it->second) {
+                auto& flag = is_changed.find(dependent)->second;
+                if (!flag) {
+                    flag = true;
+                    pending.push_back(dependent);
+                }
+            }
+        }
+    }
+    for (auto& [name, flag] : is_changed)
+        if (flag)
+            changed.push_back(name);
+    for (auto& [name, type] : previous.abi_types)
+        if (!is_derived_name(name) && is_changed.find(name) == is_changed.end())
+            changed.push_back(name);
+    std::sort(changed.begin(), changed.end());
+    return is_changed;
+}
+
+// Whether a owns type
+bool owns(const abi& a, const abi_type* type) {
+    if (auto it = a.abi_types.find(type->name); it != a.abi_types.end() && &it->second == type)
+        return true;
+    std::lock_guard<std::mutex> lock{a.derived_types->mutex};
+    auto it = a.derived_types->types.find(type->name);
+    return it != a.derived_types->types.end() && &it->second == type;
+}
+
+// Unchanged types become aliases of previous's types, which get_type() looks through. A lazy previous only lends the
+// types it has already resolved; the rest are resolved again from c's own definitions.
+void reuse_types(sysio::abi& c, const std::shared_ptr<const abi>& previous,
+                 const flat_map<std::string, bool>& is_changed) {
+    std::vector<const abi_type*> reused;
+    for (auto& [name, flag] : is_changed) {
+        if (flag)
+            continue;
+        auto it = previous->abi_types.find(name);
+        if (previous->source && !it->second.resolved.load(std::memory_order_acquire))
+            continue;
+        bool is_alias;
+        auto* type  = named_type(*previous, name, is_alias);
+        auto& entry = c.abi_types.find(name)->second;
+        entry._data = abi_type::alias{const_cast<abi_type*>(type)};
+        if (c.source)
+            entry.resolved.store(true, std::memory_order_relaxed);
+        reused.push_back(type);
+    }
+
+    auto keep = [&](const std::shared_ptr<const abi>& owner) {
+        if (std::any_of(reused.begin(), reused.end(), [&](auto* type) { return owns(*owner, type); }))
+            c.reused.push_back(owner);
+    };
+    keep(previous);
+    for (auto& owner : previous->reused)
+        keep(owner);
+}
+
+} // namespace
+
+void sysio::convert(const abi_def& def, sysio::abi& c, const std::shared_ptr<const abi>& previous,
+                    std::vector<std::string>& changed) {
+    auto is_changed = changed_types(def, *previous, changed);
+    add_types(def, c);
+    reuse_types(c, previous, is_changed);
+    resolve_types(c);
+}
+
+void sysio::convert_lazy(abi_def&& def, sysio::abi& c, const std::shared_ptr<const abi>& previous,
+                         std::vector<std::string>& changed) {
+    auto is_changed = changed_types(def, *previous, changed);
+    convert_lazy(std::move(def), c);
+    reuse_types(c, previous, is_changed);
+}
+
+void sysio::diff_types(const abi_def& def, const abi& previous, std::vector<std::string>& changed) {
+    changed_types(def, previous, changed);
+}
+
+void sysio::convert_lazy(abi_def&& def, sysio::abi& c) {
+    c.source = std::make_unique<const abi_def>(std::move(def));
+    add_types(*c.source, c);
+    for (auto& [name, _] : c.action_types)
+        c.action_abi_types[name] = nullptr;
+    for (auto& [name, _] : c.table_types)
+        c.table_abi_types[name] = nullptr;
+    for (auto& [name, _] : c.action_result_types)
+        c.action_result_abi_types[name] = nullptr;
 }
 
 void to_abi_def(abi_def& def, const std::string& name, const abi_type::builtin&) {}
@@ -236,10 +790,6 @@ void to_abi_def(abi_def& def, const std::string& name, const T*) {
    sysio::check(false, sysio::convert_abi_error(sysio::abi_error::bad_abi));
 }
 
-void to_abi_def(abi_def& def, const std::string& name, const abi_type::alias& alias) {
-   def.types.push_back({name, alias.type->name});
-}
-
 void to_abi_def(abi_def& def, const std::string& name, const abi_type::struct_& struct_) {
    if(name == "extended_asset") return;
    std::size_t field_offset = 0;
@@ -258,17 +808,359 @@ void to_abi_def(abi_def& def, const std::string& name, const abi_type::struct_&
 
 void to_abi_def(abi_def& def, const std::string& name, const abi_type::variant& variant) {
    std::vector<std::string> types;
-   for(const auto& [name, type] : variant) {
-      types.push_back(type->name);
+   for(const auto& field : variant) {
+      types.push_back(field.type->name);
    }
    def.variants.value.push_back({name, std::move(types)});
 }
 
+void to_abi_def(abi_def& def, const std::string& name, const abi_type::alias& alias) {
+   // A type reused from a previous version of the abi
+   if (alias.type->name == name)
+      return std::visit([&](const auto& t) { return to_abi_def(def, name, t); }, alias.type->_data);
+   def.types.push_back({name, alias.type->name});
+}
+
 void sysio::convert(const sysio::abi& abi, sysio::abi_def& def) {
    def.version = "sysio::abi/1.0";
-   for(auto& [name, type] : abi.abi_types) {
-      std::visit([&name = type.name, &def](const auto& t){ return to_abi_def(def, name, t); }, type._data);
+   if (abi.source) {
+      for(auto& [name, _] : abi.abi_types)
+         abi.get_type(name);
+   }
+   // Emit types in name order so the result does not depend on the order types were added
+   std::vector<const abi_type*> types;
+   types.reserve(abi.abi_types.size());
+   for(auto& [name, type] : abi.abi_types)
+      types.push_back(&type);
+   std::sort(types.begin(), types.end(), [](auto* a, auto* b) { return a->name < b->name; });
+   for(auto* type : types) {
+      std::visit([&name = type->name, &def](const auto& t){ return to_abi_def(def, name, t); }, type->_data);
+   }
+}
+
+// abi images. Every value is a little-endian uint32, and every offset is from the start of the image:
+//    header    magic, image size, type count, types offset, field count, fields offset, entry count, entries offset
+//    types     name offset, name size, kind, a, b, c
+//    fields    name offset, name size, type
+//    entries   name (low, high), map, type name offset, type name size, type
+//    strings
+// A type is the index of a type record, or image_no_type. Types never refer to an alias. By kind:
+//    builtin      one of get_builtin_type()'s types, found by name
+//    alias        a: type
+//    optional, extension, array
+//                 a: type
+//    fixed_array  a: type, b: size
+//    struct       a: first field, b: field count, c: base
+//    variant      a: first field, b: alternative count
+// Entries hold action_types (map 0), table_types (map 1) and action_result_types (map 2), with their resolved type.
+namespace {
+
+constexpr uint32_t image_magic   = 0x69626161; // "aabi"
+constexpr uint32_t image_no_type = ~uint32_t(0);
+
+enum image_kind : uint32_t { builtin_kind, alias_kind, optional_kind, extension_kind, array_kind, fixed_array_kind,
+                             struct_kind, variant_kind, num_kinds };
+
+constexpr size_t image_header_size = 8 * 4;
+constexpr size_t image_type_size   = 6 * 4;
+constexpr size_t image_field_size  = 3 * 4;
+constexpr size_t image_entry_size  = 6 * 4;
+
+void put_u32(char* p, uint32_t value) {
+   for (int i = 0; i < 4; ++i)
+      p[i] = char(value >> (8 * i));
+}
+
+uint32_t get_u32(const char* p) {
+   uint32_t value = 0;
+   for (int i = 0; i < 4; ++i)
+      value |= uint32_t(uint8_t(p[i])) << (8 * i);
+   return value;
+}
+
+uint32_t image_size(size_t size) {
+   sysio::check(size < image_no_type, "abi image is too large");
+   return uint32_t(size);
+}
+
+} // namespace
+
+void sysio::save_abi_image(const abi& a, std::vector<char>& image) {
+   if (a.source) {
+      for (auto& [name, _] : a.abi_types)
+         a.get_type(name);
+   }
+   std::vector<const abi_type*>                      types;
+   std::unordered_map<const abi_type*, uint32_t> index;
+   std::unordered_map<std::string_view, uint32_t> by_name;
+   // Types reused from an earlier version reach that version's derived types, e.g. its own "B[]", next to the ones
+   // of this abi. Both describe the same type, so only the first one with a name is saved.
+   auto add = [&](const abi_type* type) {
+      auto [it, inserted] = index.try_emplace(type, uint32_t(types.size()));
+      if (inserted) {
+         auto [named, is_new] = by_name.try_emplace(type->name, it->second);
+         if (is_new)
+            types.push_back(type);
+         else
+            it->second = named->second;
+      }
+      return it->second;
+   };
+   for (auto& [name, type] : a.abi_types) {
+      // A type reused from an earlier version of the abi is saved as the abi's own
+      auto* alias = std::get_if<abi_type::alias>(&type._data);
+      add(alias && alias->type->name == name ? alias->type : &type);
+   }
+   {
+      std::lock_guard<std::mutex> lock{a.derived_types->mutex};
+      for (auto& [_, type] : a.derived_types->types)
+         add(&type);
+   }
+
+   struct entry {
+      name               n;
+      uint32_t           map;
+      const std::string* type_name;
+      const abi_type*    type;
+   };
+   std::vector<entry> entries;
+   auto add_entries = [&](uint32_t map, auto& names, auto& resolved) {
+      for (auto& [n, type_name] : names) {
+         const abi_type* type = nullptr;
+         if (auto it = resolved.find(n); it != resolved.end())
+            type = it->second;
+         if (!type && a.source) {
+            try {
+               type = a.get_type(type_name);
+            } catch (std::exception&) {}
+         }
+         if (type)
+            add(type);
+         entries.push_back({n, map, &type_name, type});
+      }
+   };
+   add_entries(0, a.action_types, a.action_abi_types);
+   add_entries(1, a.table_types, a.table_abi_types);
+   add_entries(2, a.action_result_types, a.action_result_abi_types);
+
+   // Builtins and derived types which are only reachable through other types
+   for (size_t i = 0; i < types.size(); ++i) {
+      auto& data = types[i]->_data;
+      if (auto* s = std::get_if<abi_type::struct_>(&data)) {
+         if (s->base)
+            add(s->base);
+         for (auto& field : s->fields)
+            add(field.type);
+      } else if (auto* v = std::get_if<abi_type::variant>(&data)) {
+         for (auto& field : *v)
+            add(field.type);
+      } else if (auto* al = std::get_if<abi_type::alias>(&data)) {
+         add(al->type);
+      } else if (auto* o = std::get_if<abi_type::optional>(&data)) {
+         add(o->type);
+      } else if (auto* e = std::get_if<abi_type::extension>(&data)) {
+         add(e->type);
+      } else if (auto* ar = std::get_if<abi_type::array>(&data)) {
+         add(ar->type);
+      } else if (auto* fa = std::get_if<abi_type::fixed_array>(&data)) {
+         add(fa->type);
+      }
+   }
+
+   size_t field_count = 0;
+   for (auto* type : types) {
+      if (auto* s = type->as_struct())
+         field_count += s->fields.size();
+      else if (auto* v = type->as_variant())
+         field_count += v->size();
+   }
+   size_t begin          = image.size();
+   size_t types_offset   = image_header_size;
+   size_t fields_offset  = types_offset + types.size() * image_type_size;
+   size_t entries_offset = fields_offset + field_count * image_field_size;
+   size_t strings_offset = entries_offset + entries.size() * image_entry_size;
+   image.resize(begin + strings_offset);
+   std::string strings;
+   auto add_string = [&](const std::string& str, char* p) {
+      put_u32(p, image_size(strings_offset + strings.size()));
+      put_u32(p + 4, image_size(str.size()));
+      strings += str;
+   };
+   auto ref = [&](const abi_type* type) { return type ? index.at(type) : image_no_type; };
+
+   char* header = image.data() + begin;
+   uint32_t header_values[] = {image_magic,
+                               0,
+                               image_size(types.size()),
+                               image_size(types_offset),
+                               image_size(field_count),
+                               image_size(fields_offset),
+                               image_size(entries.size()),
+                               image_size(entries_offset)};
+   for (size_t i = 0; i < std::size(header_values); ++i)
+      put_u32(header + 4 * i, header_values[i]);
+
+   size_t next_field = 0;
+   auto put_fields = [&](const std::vector<abi_field>& fields) {
+      auto first = next_field;
+      for (auto& field : fields) {
+         char* p = image.data() + begin + fields_offset + next_field++ * image_field_size;
+         add_string(field.name, p);
+         put_u32(p + 8, ref(field.type));
+      }
+      return uint32_t(first);
+   };
+   for (size_t i = 0; i < types.size(); ++i) {
+      auto* type = types[i];
+      uint32_t kind = builtin_kind, x = 0, y = 0, z = image_no_type;
+      if (get_builtin_type(type->name) == type) {
+      } else if (auto* s = std::get_if<abi_type::struct_>(&type->_data)) {
+         kind = struct_kind, x = put_fields(s->fields), y = uint32_t(s->fields.size()), z = ref(s->base);
+      } else if (auto* v = std::get_if<abi_type::variant>(&type->_data)) {
+         kind = variant_kind, x = put_fields(*v), y = uint32_t(v->size());
+      } else if (auto* al = std::get_if<abi_type::alias>(&type->_data)) {
+         kind = alias_kind, x = ref(al->type);
+      } else if (auto* o = std::get_if<abi_type::optional>(&type->_data)) {
+         kind = optional_kind, x = ref(o->type);
+      } else if (auto* e = std::get_if<abi_type::extension>(&type->_data)) {
+         kind = extension_kind, x = ref(e->type);
+      } else if (auto* ar = std::get_if<abi_type::array>(&type->_data)) {
+         kind = array_kind, x = ref(ar->type);
+      } else if (auto* fa = std::get_if<abi_type::fixed_array>(&type->_data)) {
+         kind = fixed_array_kind, x = ref(fa->type), y = image_size(fa->size);
+      } else {
+         sysio::check(false, sysio::convert_abi_error(abi_error::bad_abi));
+      }
+      char* p = image.data() + begin + types_offset + i * image_type_size;
+      add_string(type->name, p);
+      put_u32(p + 8, kind);
+      put_u32(p + 12, x);
+      put_u32(p + 16, y);
+      put_u32(p + 20, z);
+   }
+   for (size_t i = 0; i < entries.size(); ++i) {
+      char* p = image.data() + begin + entries_offset + i * image_entry_size;
+      put_u32(p, uint32_t(entries[i].n.value));
+      put_u32(p + 4, uint32_t(entries[i].n.value >> 32));
+      put_u32(p + 8, entries[i].map);
+      add_string(*entries[i].type_name, p + 12);
+      put_u32(p + 20, ref(entries[i].type));
+   }
+   image.insert(image.end(), strings.begin(), strings.end());
+   put_u32(image.data() + begin + 4, image_size(image.size() - begin));
+}
+
+void sysio::load_abi_image(const char* image, size_t size, abi& a) {
+   auto bad = [] { sysio::check(false, "malformed abi image"); };
+   auto u32 = [&](size_t pos) {
+      if (pos > size || size - pos < 4)
+         bad();
+      return get_u32(image + pos);
+   };
+   // A table of count records of record_size bytes at offset
+   auto table = [&](uint32_t count_pos, size_t record_size) {
+      uint64_t count = u32(count_pos), offset = u32(count_pos + 4);
+      if (offset > size || count > (size - offset) / record_size)
+         bad();
+      return std::pair{uint32_t(count), size_t(offset)};
+   };
+   auto str = [&](size_t pos) {
+      uint64_t offset = u32(pos), len = u32(pos + 4);
+      if (offset > size || len > size - offset)
+         bad();
+      return std::string{image + offset, size_t(len)};
+   };
+   if (u32(0) != image_magic || u32(4) != size)
+      bad();
+   auto [type_count, types_offset]    = table(8, image_type_size);
+   auto [field_count, fields_offset]  = table(16, image_field_size);
+   auto [entry_count, entries_offset] = table(24, image_entry_size);
+
+   std::vector<abi_type*> types(type_count);
+   std::vector<uint32_t>  kinds(type_count);
+   for (uint32_t i = 0; i < type_count; ++i) {
+      size_t p  = types_offset + i * image_type_size;
+      auto name = str(p);
+      kinds[i]  = u32(p + 8);
+      if (kinds[i] == builtin_kind) {
+         types[i] = get_builtin_type(name);
+         if (!types[i])
+            bad();
+         continue;
+      }
+      static const abi_serializer* const serializers[] = {nullptr,
+                                                          nullptr,
+                                                          optional_abi_serializer,
+                                                          extension_abi_serializer,
+                                                          array_abi_serializer,
+                                                          fixed_array_abi_serializer,
+                                                          object_abi_serializer,
+                                                          variant_abi_serializer};
+      if (kinds[i] >= num_kinds || get_builtin_type(name))
+         bad();
+      auto [it, inserted] = a.abi_types.try_emplace(name, name, abi_type::builtin{}, serializers[kinds[i]]);
+      if (!inserted)
+         bad();
+      types[i] = &it->second;
+   }
+   auto ref = [&](uint32_t i) {
+      if (i >= type_count || kinds[i] == alias_kind)
+         bad();
+      return types[i];
+   };
+   auto fields = [&](uint32_t first, uint32_t count) {
+      if (first > field_count || count > field_count - first)
+         bad();
+      std::vector<abi_field> result;
+      result.reserve(count);
+      for (uint32_t i = first; i < first + count; ++i) {
+         size_t p = fields_offset + i * image_field_size;
+         result.push_back({str(p), ref(u32(p + 8))});
+      }
+      return result;
+   };
+   for (uint32_t i = 0; i < type_count; ++i) {
+      size_t p = types_offset + i * image_type_size;
+      uint32_t x = u32(p + 12), y = u32(p + 16), z = u32(p + 20);
+      auto& data = types[i]->_data;
+      switch (kinds[i]) {
+      case builtin_kind: break;
+      case alias_kind: data = abi_type::alias{ref(x)}; break;
+      case optional_kind: data = abi_type::optional{ref(x)}; break;
+      case extension_kind: data = abi_type::extension{ref(x)}; break;
+      case array_kind: data = abi_type::array{ref(x)}; break;
+      case fixed_array_kind:
+         if (!y)
+            bad();
+         data = abi_type::fixed_array{ref(x), y};
+         break;
+      case struct_kind: {
+         abi_type* base = nullptr;
+         if (z != image_no_type) {
+            base = ref(z);
+            if (kinds[z] != struct_kind)
+               bad();
+         }
+         data = abi_type::struct_{base, fields(x, y)};
+         break;
+      }
+      case variant_kind: data = fields(x, y); break;
+      }
+   }
+   for (uint32_t i = 0; i < entry_count; ++i) {
+      size_t   p = entries_offset + i * image_entry_size;
+      name     n{u32(p) | uint64_t(u32(p + 4)) << 32};
+      uint32_t map  = u32(p + 8);
+      uint32_t type = u32(p + 20);
+      if (map > 2)
+         bad();
+      auto& names    = map == 0 ? a.action_types : map == 1 ? a.table_types : a.action_result_types;
+      auto& resolved = map == 0 ? a.action_abi_types : map == 1 ? a.table_abi_types : a.action_result_abi_types;
+      names[n]       = str(p + 12);
+      resolved[n]    = type == image_no_type ? nullptr : ref(type);
    }
+   for (auto& [_, type] : a.abi_types)
+      compile(type);
 }
 
 const abi_serializer* const sysio::object_abi_serializer = &abi_serializer_for< ::abieos::pseudo_object>;
@@ -279,10 +1171,10 @@ const abi_serializer* const sysio::extension_abi_serializer = &abi_serializer_fo
 const abi_serializer* const sysio::optional_abi_serializer = &abi_serializer_for< ::abieos::pseudo_optional>;
 
 std::vector<char> sysio::abi_type::json_to_bin_reorderable(std::string_view json, std::function<void()> f) const {
-   abieos::jvalue tmp;
-   abieos::json_to_jvalue(tmp, json, f);
    std::vector<char> result;
-   abieos::json_to_bin(result, this, tmp, f);
+   abieos::conversion_scratch scratch;
+   abieos::conversion_error error;
+   check(abieos::json_to_bin_reorderable(result, this, json, f, scratch, error), std::move(error.message));
    return result;
 }
 
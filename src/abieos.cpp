@@ -2,18 +2,144 @@
 
 #include "abieos.h"
 #include "abieos.hpp"
+#include "abieos_ripemd160.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 
 using namespace abieos;
 
+// Identifies an abi source without keeping a copy of it: the RIPEMD-160 digest of its format byte and source bytes,
+// along with the source size. Sources which match on both are taken to be identical.
+struct abi_source_digest {
+    std::array<unsigned char, abieos_ripemd160::ripemd160_digest_size> digest{};
+    size_t size = 0;
+
+    bool operator==(const abi_source_digest& other) const { return size == other.size && digest == other.digest; }
+};
+
+struct abi_source_digest_hash {
+    size_t operator()(const abi_source_digest& d) const {
+        size_t h;
+        memcpy(&h, d.digest.data(), sizeof(h));
+        return h;
+    }
+};
+
+abi_source_digest digest_abi_source(char format, const char* data, size_t size) {
+    abieos_ripemd160::ripemd160_state state;
+    abieos_ripemd160::ripemd160_init(&state);
+    abieos_ripemd160::ripemd160_update(&state, &format, 1);
+    // ripemd160_update takes an int length
+    for (size_t pos = 0; pos < size; pos += 0x4000'0000)
+        abieos_ripemd160::ripemd160_update(&state, data + pos, int(std::min<size_t>(size - pos, 0x4000'0000)));
+    abi_source_digest result;
+    if (!abieos_ripemd160::ripemd160_digest(&state, result.digest.data()))
+        throw std::runtime_error("abi digest failed");
+    result.size = size;
+    return result;
+}
+
+// Compiled abis keyed by the digest of their source bytes. Contracts which load byte-identical abis share one compiled
+// abi; an entry expires once no contract uses it.
+struct abi_cache {
+    std::mutex mutex{};
+    std::unordered_map<abi_source_digest, std::weak_ptr<const abi>, abi_source_digest_hash> abis{};
+    size_t prune_at = 64;
+    abieos_abi_stats stats{};
+};
+
+// One abi version of a registry contract, in effect from block_num until the next version's block_num
+struct abi_version {
+    uint32_t block_num = 0;
+    std::shared_ptr<const abi> c{};
+};
+
+using abi_versions = std::vector<abi_version>;
+
+// A published set of registry contracts, each with its versions ordered by block_num. Snapshots are never modified
+// once published; writers copy, update and swap in a new one. Contracts are spread over shards, and snapshots share
+// each shard and version list until a writer replaces it, so publishing one contract copies one shard instead of the
+// whole registry. An abi version is freed once no snapshot holds it.
+struct registry_snapshot {
+    using shard = sysio::flat_map<name, std::shared_ptr<const abi_versions>>;
+    static constexpr int shard_bits = 8;
+
+    std::array<std::shared_ptr<shard>, 1 << shard_bits> shards{};
+
+    // flat_map probes with the low bits of the same hash, so shards take the high bits
+    static size_t shard_index(name contract) {
+        return sysio::flat_hash<name>{}(contract) >> (sizeof(size_t) * 8 - shard_bits);
+    }
+
+    const abi_versions* find(name contract) const {
+        auto& s = shards[shard_index(contract)];
+        if (!s)
+            return nullptr;
+        auto it = s->find(contract);
+        return it == s->end() ? nullptr : it->second.get();
+    }
+
+    template <typename F>
+    void for_each(F f) const {
+        for (auto& s : shards)
+            if (s)
+                for (auto& [contract, versions] : *s)
+                    f(contract, *versions);
+    }
+
+    // The writer's copy shares its shards with the published snapshot, which holds a reference to each of them until
+    // it is replaced. A shard with no other reference was already copied by this writer.
+    shard& edit(name contract) {
+        auto& s = shards[shard_index(contract)];
+        if (!s)
+            s = std::make_shared<shard>();
+        else if (s.use_count() > 1)
+            s = std::make_shared<shard>(*s);
+        return *s;
+    }
+
+    void set(name contract, abi_versions versions) {
+        edit(contract)[contract] = std::make_shared<const abi_versions>(std::move(versions));
+    }
+
+    bool erase(name contract) { return find(contract) && edit(contract).erase(contract); }
+};
+
+// snapshot is only accessed through std::atomic_load and std::atomic_store, so readers never wait for a writer.
+// mutex serializes writers.
+struct abieos_registry_s {
+    std::atomic<uint32_t> refs{1};
+    std::atomic<uint64_t> generation{0};
+    std::mutex mutex{};
+    std::shared_ptr<const registry_snapshot> snapshot = std::make_shared<registry_snapshot>();
+    abi_cache cache{};
+};
+
 struct abieos_context_s {
     const char* last_error = "";
     std::string last_error_buffer{};
+    abieos_error_kind last_error_kind = abieos_error_kind_none;
+    size_t last_error_offset = 0;
+    std::string last_error_path{};
     std::string result_str{};
     std::vector<char> result_bin{};
+    std::vector<char> batch_arena{};
+    conversion_scratch scratch{};
+
+    sysio::flat_map<name, std::shared_ptr<const abi>> contracts{};
+    abi_cache cache{};
+    bool lazy_abis = false;
 
-    std::map<name, abi> contracts{};
+    abieos_registry* registry = nullptr;
+    uint64_t registry_generation = 0;
+    std::shared_ptr<const registry_snapshot> registry_contracts{};
 };
 
 void fix_null_str(const char*& s) {
@@ -24,6 +150,19 @@ void fix_null_str(const char*& s) {
 bool set_error(abieos_context* context, std::string error) noexcept {
     context->last_error_buffer = std::move(error);
     context->last_error = context->last_error_buffer.c_str();
+    context->last_error_kind = abieos_error_kind_other;
+    context->last_error_offset = 0;
+    context->last_error_path.clear();
+    return false;
+}
+
+static_assert(abieos_error_kind(conversion_error_kind::json) == abieos_error_kind_json);
+
+bool set_error(abieos_context* context, conversion_error&& error) noexcept {
+    set_error(context, std::move(error.message));
+    context->last_error_kind = abieos_error_kind(error.kind);
+    context->last_error_offset = error.offset;
+    context->last_error_path = std::move(error.path);
     return false;
 }
 
@@ -42,6 +181,246 @@ auto handle_exceptions(abieos_context* context, T errval, F f) noexcept -> declt
     }
 }
 
+void release(abieos_registry* registry) {
+    if (registry && registry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete registry;
+}
+
+void refresh(abieos_context* context, abieos_registry* registry) {
+    context->registry_generation = registry->generation.load(std::memory_order_acquire);
+    context->registry_contracts = std::atomic_load(&registry->snapshot);
+}
+
+// The version of a registry contract in effect at block_num, or its latest version if block_num is empty
+const std::shared_ptr<const abi>* find_version(const registry_snapshot& snapshot, uint64_t contract,
+                                               std::optional<uint32_t> block_num) {
+    auto* found = snapshot.find(name{contract});
+    if (!found)
+        return nullptr;
+    auto& versions = *found;
+    if (!block_num)
+        return &versions.back().c;
+    auto v = std::upper_bound(versions.begin(), versions.end(), *block_num,
+                              [](uint32_t b, const abi_version& v) { return b < v.block_num; });
+    if (v == versions.begin())
+        return nullptr;
+    return &std::prev(v)->c;
+}
+
+// Find a contract loaded into the context, falling back to the attached registry. Registry contracts resolve to the
+// version in effect at block_num, or to their latest version if block_num is empty. A new registry snapshot is only
+// loaded when a writer has published one since this context last looked. The result stays valid until the context's
+// next lookup.
+const std::shared_ptr<const abi>* find_shared_contract(abieos_context* context, uint64_t contract,
+                                                       std::optional<uint32_t> block_num = {}) {
+    if (auto it = context->contracts.find(name{contract}); it != context->contracts.end())
+        return &it->second;
+    auto* registry = context->registry;
+    if (!registry)
+        return nullptr;
+    if (registry->generation.load(std::memory_order_acquire) != context->registry_generation)
+        refresh(context, registry);
+    return find_version(*context->registry_contracts, contract, block_num);
+}
+
+const abi* find_contract(abieos_context* context, uint64_t contract, std::optional<uint32_t> block_num = {}) {
+    auto* c = find_shared_contract(context, contract, block_num);
+    return c ? c->get() : nullptr;
+}
+
+const abi& get_contract(abieos_context* context, uint64_t contract, std::optional<uint32_t> block_num = {}) {
+    auto* c = find_contract(context, contract, block_num);
+    if (!c) {
+        if (block_num)
+            throw std::runtime_error("contract \"" + sysio::name_to_string(contract) + "\" is not loaded at block " +
+                                     std::to_string(*block_num));
+        throw std::runtime_error("contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
+    }
+    return *c;
+}
+
+void convert(abi_def& def, abi& c, bool lazy) {
+    if (lazy)
+        convert_lazy(std::move(def), c);
+    else
+        convert(def, c);
+}
+
+// Parse a JSON abi. Returns false on error.
+bool parse_abi(abieos_context* context, const char* json, abi_def& def) {
+    context->last_error = "abi parse error";
+    std::string error;
+    std::string abi_copy{json};
+    sysio::json_token_stream stream(abi_copy.data(), abi_copy.size());
+    from_json(def, stream);
+    if (!check_abi_version(def.version, error))
+        return set_error(context, std::move(error));
+    return true;
+}
+
+// Parse a binary abi. Returns false on error.
+bool parse_abi(abieos_context* context, const char* data, size_t size, abi_def& def) {
+    context->last_error = "abi parse error";
+    if (!data || !size)
+        return set_error(context, "no data");
+    std::string error;
+    sysio::input_stream stream{data, size};
+    std::string version;
+    from_bin(version, stream);
+    if (!check_abi_version(version, error))
+        return set_error(context, std::move(error));
+    stream = {data, size};
+    from_bin(def, stream);
+    return true;
+}
+
+// Parse and compile a JSON abi. Returns false on error.
+bool compile_abi(abieos_context* context, const char* json, abi& c) {
+    abi_def def{};
+    if (!parse_abi(context, json, def))
+        return false;
+    convert(def, c, context->lazy_abis);
+    return true;
+}
+
+// Parse and compile a binary abi. Returns false on error.
+bool compile_abi(abieos_context* context, const char* data, size_t size, abi& c) {
+    abi_def def{};
+    if (!parse_abi(context, data, size, def))
+        return false;
+    convert(def, c, context->lazy_abis);
+    return true;
+}
+
+// Compile an abi, or share the compiled abi of an identical source which is already loaded. format distinguishes json
+// from binary sources, and lazy from eager abis. The cache is not locked while compiling. Returns null on error.
+template <typename F>
+std::shared_ptr<const abi> share_abi(abi_cache& cache, char format, const char* data, size_t size, F compile) {
+    auto source = digest_abi_source(format, data, size);
+    auto reuse = [&](std::shared_ptr<const abi> c) {
+        ++cache.stats.abis_deduplicated;
+        cache.stats.bytes_saved += size;
+        return c;
+    };
+    {
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        if (auto it = cache.abis.find(source); it != cache.abis.end())
+            if (auto c = it->second.lock())
+                return reuse(std::move(c));
+    }
+    abi c;
+    if (!compile(c))
+        return nullptr;
+    auto shared = std::make_shared<const abi>(std::move(c));
+    std::lock_guard<std::mutex> lock{cache.mutex};
+    auto& entry = cache.abis[source];
+    if (auto existing = entry.lock())
+        return reuse(std::move(existing));
+    entry = shared;
+    ++cache.stats.abis_compiled;
+    if (cache.abis.size() >= cache.prune_at) {
+        for (auto it = cache.abis.begin(); it != cache.abis.end();)
+            it = it->second.expired() ? cache.abis.erase(it) : std::next(it);
+        cache.prune_at = std::max<size_t>(64, cache.abis.size() * 2);
+    }
+    return shared;
+}
+
+std::shared_ptr<const abi> share_abi(abieos_context* context, abi_cache& cache, const char* json) {
+    return share_abi(cache, context->lazy_abis ? 'J' : 'j', json, strlen(json),
+                     [&](abi& c) { return compile_abi(context, json, c); });
+}
+
+std::shared_ptr<const abi> share_abi(abieos_context* context, abi_cache& cache, const char* data, size_t size) {
+    if (!data)
+        size = 0;
+    return share_abi(cache, context->lazy_abis ? 'B' : 'b', data, size,
+                     [&](abi& c) { return compile_abi(context, data, size, c); });
+}
+
+// Compile def, reusing the unchanged types of previous, which may be null, or share the compiled abi of an identical
+// source which is already loaded. format, data and size describe def's source as they do for share_abi. Stores the
+// names of the types which changed in context->result_str as a JSON array. Returns null on error.
+std::shared_ptr<const abi> update_abi(abieos_context* context, abi_cache& cache, char format, const char* data,
+                                      size_t size, abi_def& def, std::shared_ptr<const abi> previous) {
+    if (!previous)
+        previous = std::make_shared<const abi>();
+    std::vector<std::string> changed;
+    bool                     compiled = false;
+    auto c = share_abi(cache, format, data, size, [&](abi& c) {
+        compiled = true;
+        if (context->lazy_abis)
+            convert_lazy(std::move(def), c, previous, changed);
+        else
+            convert(def, c, previous, changed);
+        return true;
+    });
+    if (!compiled)
+        diff_types(def, *previous, changed);
+    context->result_str = sysio::convert_to_json(changed);
+    return c;
+}
+
+std::shared_ptr<const abi> update_abi(abieos_context* context, abi_cache& cache, const char* json, abi_def& def,
+                                      std::shared_ptr<const abi> previous) {
+    return update_abi(context, cache, context->lazy_abis ? 'J' : 'j', json, strlen(json), def, std::move(previous));
+}
+
+std::shared_ptr<const abi> update_abi(abieos_context* context, abi_cache& cache, const char* data, size_t size,
+                                      abi_def& def, std::shared_ptr<const abi> previous) {
+    if (!data)
+        size = 0;
+    return update_abi(context, cache, context->lazy_abis ? 'B' : 'b', data, size, def, std::move(previous));
+}
+
+// Publish a new registry snapshot if f, which edits a copy of the current one, returns true. Readers keep using the
+// snapshot they hold until their next lookup.
+template <typename F>
+bool publish_if(abieos_registry* registry, F f) {
+    std::lock_guard<std::mutex> lock{registry->mutex};
+    auto next = std::make_shared<registry_snapshot>(*std::atomic_load(&registry->snapshot));
+    if (!f(*next))
+        return false;
+    std::atomic_store(&registry->snapshot, std::shared_ptr<const registry_snapshot>(std::move(next)));
+    registry->generation.store(registry->generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename F>
+void publish(abieos_registry* registry, F f) {
+    publish_if(registry, [&](registry_snapshot& s) {
+        f(s);
+        return true;
+    });
+}
+
+// Replace all versions of a contract, or add a version which activates at block_num
+void set_version(registry_snapshot& s, uint64_t contract, std::optional<uint32_t> block_num,
+                 std::shared_ptr<const abi> c) {
+    if (!block_num)
+        return s.set(name{contract}, {{0, std::move(c)}});
+    abi_versions versions;
+    if (auto* existing = s.find(name{contract}))
+        versions = *existing;
+    auto v = std::lower_bound(versions.begin(), versions.end(), *block_num,
+                              [](const abi_version& v, uint32_t b) { return v.block_num < b; });
+    if (v != versions.end() && v->block_num == *block_num)
+        v->c = std::move(c);
+    else
+        versions.insert(v, {*block_num, std::move(c)});
+    s.set(name{contract}, std::move(versions));
+}
+
+void publish(abieos_registry* registry, uint64_t contract, std::optional<uint32_t> block_num,
+             std::shared_ptr<const abi> c) {
+    publish(registry, [&](registry_snapshot& s) { set_version(s, contract, block_num, std::move(c)); });
+}
+
+void get_stats(abi_cache& cache, abieos_abi_stats* stats) {
+    std::lock_guard<std::mutex> lock{cache.mutex};
+    *stats = cache.stats;
+}
+
 extern "C" abieos_context* abieos_create() {
     try {
         return new abieos_context{};
@@ -50,7 +429,11 @@ extern "C" abieos_context* abieos_create() {
     }
 }
 
-extern "C" void abieos_destroy(abieos_context* context) { delete context; }
+extern "C" void abieos_destroy(abieos_context* context) {
+    if (context)
+        release(context->registry);
+    delete context;
+}
 
 extern "C" const char* abieos_get_error(abieos_context* context) {
     if (!context)
@@ -58,6 +441,22 @@ extern "C" const char* abieos_get_error(abieos_context* context) {
     return context->last_error;
 }
 
+extern "C" void abieos_reset_scratch(abieos_context* context) {
+    if (context)
+        context->scratch = {};
+}
+
+extern "C" abieos_bool abieos_get_error_report(abieos_context* context, abieos_error_report* report) {
+    if (!context)
+        return false;
+    if (!report)
+        return set_error(context, "report is null");
+    report->kind = context->last_error_kind;
+    report->offset = context->last_error_offset;
+    report->path = context->last_error_path.c_str();
+    return true;
+}
+
 extern "C" int abieos_get_bin_size(abieos_context* context) {
     if (!context)
         return 0;
@@ -78,6 +477,31 @@ extern "C" const char* abieos_get_bin_hex(abieos_context* context) {
     });
 }
 
+// snprintf-style string output: at most out_size - 1 bytes are written, followed by a terminator
+sysio::truncating_buf_stream string_buf_stream(char*& out, size_t& out_size) {
+    if (!out)
+        out_size = 0;
+    return {out, out_size ? out_size - 1 : 0};
+}
+
+int64_t terminate(const sysio::truncating_buf_stream& stream, size_t out_size) {
+    if (out_size)
+        *stream.pos = 0;
+    return stream.size;
+}
+
+extern "C" int64_t abieos_get_bin_hex_into(abieos_context* context, char* out, size_t out_size) {
+    return handle_exceptions(context, -1, [&]() -> int64_t {
+        auto stream = string_buf_stream(out, out_size);
+        char digits[2];
+        for (char c : context->result_bin) {
+            hex(&c, &c + 1, digits);
+            stream.write(digits, 2);
+        }
+        return terminate(stream, out_size);
+    });
+}
+
 extern "C" uint64_t abieos_string_to_name(abieos_context* context, const char* str) {
     fix_null_str(str);
     return sysio::string_to_name(str);
@@ -90,19 +514,17 @@ extern "C" const char* abieos_name_to_string(abieos_context* context, uint64_t n
     });
 }
 
+extern "C" void abieos_set_lazy_abis(abieos_context* context, abieos_bool lazy) {
+    if (context)
+        context->lazy_abis = lazy;
+}
+
 extern "C" abieos_bool abieos_set_abi(abieos_context* context, uint64_t contract, const char* abi) {
     fix_null_str(abi);
     return handle_exceptions(context, false, [&]() {
-        context->last_error = "abi parse error";
-        abi_def def{};
-        std::string error;
-        std::string abi_copy{abi};
-        sysio::json_token_stream stream(abi_copy.data());
-        from_json(def, stream);
-        if (!check_abi_version(def.version, error))
-            return set_error(context, std::move(error));
-        abieos::abi c;
-        convert(def, c);
+        auto c = share_abi(context, context->cache, abi);
+        if (!c)
+            return false;
         context->contracts.insert({name{contract}, std::move(c)});
         return true;
     });
@@ -110,25 +532,52 @@ extern "C" abieos_bool abieos_set_abi(abieos_context* context, uint64_t contract
 
 extern "C" abieos_bool abieos_set_abi_bin(abieos_context* context, uint64_t contract, const char* data, size_t size) {
     return handle_exceptions(context, false, [&] {
-        context->last_error = "abi parse error";
-        if (!data || !size)
-            return set_error(context, "no data");
-        std::string error;
-        sysio::input_stream stream{data, size};
-        std::string version;
-        from_bin(version, stream);
-        if (!check_abi_version(version, error))
-            return set_error(context, std::move(error));
-        abi_def def{};
-        stream = {data, size};
-        from_bin(def, stream);
-        abieos::abi c;
-        convert(def, c);
+        auto c = share_abi(context, context->cache, data, size);
+        if (!c)
+            return false;
         context->contracts.insert({name{contract}, std::move(c)});
         return true;
     });
 }
 
+// Replace a contract in the context. update compiles the new abi from the one it replaces: the context's own, or else
+// the latest version in the attached registry.
+template <typename F>
+const char* update_contract(abieos_context* context, uint64_t contract, F update) {
+    std::shared_ptr<const abi> previous;
+    if (auto* c = find_shared_contract(context, contract))
+        previous = *c;
+    auto c = update(std::move(previous));
+    if (!c)
+        return nullptr;
+    context->contracts[name{contract}] = std::move(c);
+    return context->result_str.c_str();
+}
+
+extern "C" const char* abieos_update_abi(abieos_context* context, uint64_t contract, const char* abi) {
+    fix_null_str(abi);
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        abi_def def{};
+        if (!parse_abi(context, abi, def))
+            return nullptr;
+        return update_contract(context, contract, [&](auto previous) {
+            return update_abi(context, context->cache, abi, def, std::move(previous));
+        });
+    });
+}
+
+extern "C" const char* abieos_update_abi_bin(abieos_context* context, uint64_t contract, const char* data,
+                                             size_t size) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        abi_def def{};
+        if (!parse_abi(context, data, size, def))
+            return nullptr;
+        return update_contract(context, contract, [&](auto previous) {
+            return update_abi(context, context->cache, data, size, def, std::move(previous));
+        });
+    });
+}
+
 extern "C" abieos_bool abieos_set_abi_hex(abieos_context* context, uint64_t contract, const char* hex) {
     fix_null_str(hex);
     return handle_exceptions(context, false, [&]() -> abieos_bool {
@@ -145,10 +594,7 @@ extern "C" abieos_bool abieos_set_abi_hex(abieos_context* context, uint64_t cont
 
 extern "C" const char* abieos_get_type_for_action(abieos_context* context, uint64_t contract, uint64_t action) {
     return handle_exceptions(context, nullptr, [&] {
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            throw std::runtime_error("contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
-        auto& c = contract_it->second;
+        auto& c = get_contract(context, contract);
 
         auto action_it = c.action_types.find(name{action});
         if (action_it == c.action_types.end())
@@ -160,10 +606,7 @@ extern "C" const char* abieos_get_type_for_action(abieos_context* context, uint6
 
 extern "C" const char* abieos_get_type_for_table(abieos_context* context, uint64_t contract, uint64_t table) {
     return handle_exceptions(context, nullptr, [&] {
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            throw std::runtime_error("contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
-        auto& c = contract_it->second;
+        auto& c = get_contract(context, contract);
 
         auto table_it = c.table_types.find(name{table});
         if (table_it == c.table_types.end())
@@ -176,10 +619,7 @@ extern "C" const char* abieos_get_type_for_table(abieos_context* context, uint64
 extern "C" const char* abieos_get_type_for_action_result(abieos_context* context, uint64_t contract,
                                                          uint64_t action_result) {
     return handle_exceptions(context, nullptr, [&] {
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            throw std::runtime_error("contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
-        auto& c = contract_it->second;
+        auto& c = get_contract(context, contract);
 
         auto action_result_it = c.action_result_types.find(name{action_result});
         if (action_result_it == c.action_result_types.end())
@@ -189,37 +629,236 @@ extern "C" const char* abieos_get_type_for_action_result(abieos_context* context
     });
 }
 
-extern "C" abieos_bool abieos_json_to_bin(abieos_context* context, uint64_t contract, const char* type,
-                                          const char* json) {
+const abi_type* get_resolved_type(const abi& c, const sysio::flat_map<name, const abi_type*>& resolved,
+                                  const sysio::flat_map<name, std::string>& names, uint64_t contract, uint64_t n,
+                                  const char* kind) {
+    auto it = resolved.find(name{n});
+    if (it == resolved.end())
+        throw std::runtime_error("contract \"" + sysio::name_to_string(contract) + "\" does not have " + kind + " \"" +
+                                 sysio::name_to_string(n) + "\"");
+    if (!it->second)
+        return c.get_type(names.find(name{n})->second);
+    return it->second;
+}
+
+// Type handles are the abi_type itself
+abieos_type_handle to_handle(const abi_type* type) { return reinterpret_cast<abieos_type_handle>(type); }
+
+const abi_type* from_handle(abieos_type_handle handle) {
+    if (!handle)
+        throw std::runtime_error("type handle is null");
+    return reinterpret_cast<const abi_type*>(handle);
+}
+
+extern "C" abieos_type_handle abieos_get_type_handle(abieos_context* context, uint64_t contract, const char* type) {
     fix_null_str(type);
+    return handle_exceptions(context, nullptr,
+                             [&] { return to_handle(get_contract(context, contract).get_type(type)); });
+}
+
+extern "C" abieos_type_handle abieos_get_type_handle_at_block(abieos_context* context, uint64_t contract,
+                                                              uint32_t block_num, const char* type) {
+    fix_null_str(type);
+    return handle_exceptions(context, nullptr,
+                             [&] { return to_handle(get_contract(context, contract, block_num).get_type(type)); });
+}
+
+extern "C" abieos_bool abieos_handle_json_to_bin(abieos_context* context, abieos_type_handle type, const char* json) {
     fix_null_str(json);
     return handle_exceptions(context, false, [&] {
         context->last_error = "json parse error";
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
-            return set_error(context, "contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
-        std::string error;
-        auto t = contract_it->second.get_type(type);
+        auto t = from_handle(type);
+        context->result_bin.clear();
+        conversion_error error;
+        if (!json_to_bin(context->result_bin, t, json, [] {}, context->scratch, error))
+            return set_error(context, std::move(error));
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_handle_json_to_bin_insitu(abieos_context* context, abieos_type_handle type, char* json,
+                                                        size_t size) {
+    return handle_exceptions(context, false, [&] {
+        context->last_error = "json parse error";
+        auto t = from_handle(type);
         context->result_bin.clear();
-        context->result_bin = t->json_to_bin(json);
+        if (!json || json[size] || json[size + 1] || json[size + 2])
+            return set_error(context, "json must be followed by 3 NUL bytes");
+        conversion_error error;
+        if (!json_to_bin_insitu(context->result_bin, t, json, size, [] {}, context->scratch, error))
+            return set_error(context, std::move(error));
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_handle_json_to_bin_reorderable(abieos_context* context, abieos_type_handle type,
+                                                             const char* json) {
+    fix_null_str(json);
+    return handle_exceptions(context, false, [&] {
+        auto t = from_handle(type);
+        context->result_bin.clear();
+        conversion_error error;
+        if (!json_to_bin_reorderable(context->result_bin, t, json, [] {}, context->scratch, error))
+            return set_error(context, std::move(error));
+        return true;
+    });
+}
+
+extern "C" const char* abieos_handle_bin_to_json(abieos_context* context, abieos_type_handle type, const char* data,
+                                                 size_t size) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        if (!data)
+            size = 0;
+        context->last_error = "binary decode error";
+        auto t = from_handle(type);
+        sysio::input_stream bin{data, size};
+        conversion_error error;
+        if (!bin_to_json(bin, t, context->result_str, [] {}, context->scratch, error)) {
+            set_error(context, std::move(error));
+            return nullptr;
+        }
+        return context->result_str.c_str();
+    });
+}
+
+extern "C" int64_t abieos_handle_bin_to_json_into(abieos_context* context, abieos_type_handle type, const char* data,
+                                                  size_t size, char* out, size_t out_size) {
+    return handle_exceptions(context, -1, [&]() -> int64_t {
+        if (!data)
+            size = 0;
+        context->last_error = "binary decode error";
+        auto t = from_handle(type);
+        sysio::input_stream bin{data, size};
+        auto stream = string_buf_stream(out, out_size);
+        conversion_error error;
+        if (!bin_to_json(bin, t, stream, [] {}, context->scratch, error)) {
+            set_error(context, std::move(error));
+            return -1;
+        }
+        return terminate(stream, out_size);
+    });
+}
+
+extern "C" abieos_bool abieos_validate_bin(abieos_context* context, uint64_t contract, const char* type,
+                                           const char* data, size_t size, size_t* consumed) {
+    fix_null_str(type);
+    return handle_exceptions(context, false, [&]() -> abieos_bool {
+        context->last_error = "binary decode error";
+        auto& c = get_contract(context, contract);
+        return abieos_handle_validate_bin(context, to_handle(c.get_type(type)), data, size, consumed);
+    });
+}
+
+extern "C" abieos_bool abieos_handle_validate_bin(abieos_context* context, abieos_type_handle type, const char* data,
+                                                  size_t size, size_t* consumed) {
+    return handle_exceptions(context, false, [&]() -> abieos_bool {
+        if (!data)
+            size = 0;
+        context->last_error = "binary decode error";
+        auto t = from_handle(type);
+        sysio::input_stream bin{data, size};
+        conversion_error error;
+        if (!validate_bin(bin, t, context->scratch, error)) {
+            set_error(context, std::move(error));
+            return false;
+        }
+        if (consumed)
+            *consumed = bin.pos - data;
         return true;
     });
 }
 
+extern "C" abieos_bool abieos_handle_locate_field(abieos_context* context, abieos_type_handle type, const char* data,
+                                                  size_t size, const char* path, size_t* offset, size_t* field_size,
+                                                  abieos_type_handle* field_type) {
+    fix_null_str(path);
+    return handle_exceptions(context, false, [&]() -> abieos_bool {
+        if (!data)
+            size = 0;
+        if (!offset || !field_size) {
+            set_error(context, "no output");
+            return false;
+        }
+        context->last_error = "binary decode error";
+        auto t = from_handle(type);
+        sysio::input_stream bin{data, size};
+        conversion_error error;
+        if (!locate_field(t, bin, path, context->scratch, error)) {
+            set_error(context, std::move(error));
+            return false;
+        }
+        *offset = bin.pos - data;
+        *field_size = bin.remaining();
+        if (field_type)
+            *field_type = to_handle(t);
+        return true;
+    });
+}
+
+extern "C" const char* abieos_action_bin_to_json(abieos_context* context, uint64_t contract, uint64_t action,
+                                                 const char* data, size_t size) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        context->last_error = "binary decode error";
+        auto& c = get_contract(context, contract);
+        auto t = get_resolved_type(c, c.action_abi_types, c.action_types, contract, action, "action");
+        return abieos_handle_bin_to_json(context, to_handle(t), data, size);
+    });
+}
+
+extern "C" const char* abieos_table_bin_to_json(abieos_context* context, uint64_t contract, uint64_t table,
+                                                const char* data, size_t size) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        context->last_error = "binary decode error";
+        auto& c = get_contract(context, contract);
+        auto t = get_resolved_type(c, c.table_abi_types, c.table_types, contract, table, "table");
+        return abieos_handle_bin_to_json(context, to_handle(t), data, size);
+    });
+}
+
+extern "C" const char* abieos_action_result_bin_to_json(abieos_context* context, uint64_t contract,
+                                                        uint64_t action_result, const char* data, size_t size) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        context->last_error = "binary decode error";
+        auto& c = get_contract(context, contract);
+        auto t = get_resolved_type(c, c.action_result_abi_types, c.action_result_types, contract, action_result,
+                                   "action_result");
+        return abieos_handle_bin_to_json(context, to_handle(t), data, size);
+    });
+}
+
+extern "C" abieos_bool abieos_json_to_bin(abieos_context* context, uint64_t contract, const char* type,
+                                          const char* json) {
+    fix_null_str(type);
+    return handle_exceptions(context, false, [&]() -> abieos_bool {
+        context->last_error = "json parse error";
+        auto* c = find_contract(context, contract);
+        if (!c)
+            return set_error(context, "contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
+        return abieos_handle_json_to_bin(context, to_handle(c->get_type(type)), json);
+    });
+}
+
 extern "C" abieos_bool abieos_json_to_bin_reorderable(abieos_context* context, uint64_t contract, const char* type,
                                                       const char* json) {
     fix_null_str(type);
-    fix_null_str(json);
-    return handle_exceptions(context, false, [&] {
+    return handle_exceptions(context, false, [&]() -> abieos_bool {
         context->last_error = "json parse error";
-        auto contract_it = context->contracts.find(::abieos::name{contract});
-        if (contract_it == context->contracts.end())
+        auto* c = find_contract(context, contract);
+        if (!c)
             return set_error(context, "contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
-        std::string error;
-        auto t = contract_it->second.get_type(type);
-        context->result_bin.clear();
-        context->result_bin = t->json_to_bin_reorderable(json);
-        return true;
+        return abieos_handle_json_to_bin_reorderable(context, to_handle(c->get_type(type)), json);
+    });
+}
+
+extern "C" abieos_bool abieos_json_to_bin_insitu(abieos_context* context, uint64_t contract, const char* type,
+                                                 char* json, size_t size) {
+    fix_null_str(type);
+    return handle_exceptions(context, false, [&]() -> abieos_bool {
+        context->last_error = "json parse error";
+        auto* c = find_contract(context, contract);
+        if (!c)
+            return set_error(context, "contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
+        return abieos_handle_json_to_bin_insitu(context, to_handle(c->get_type(type)), json, size);
     });
 }
 
@@ -227,19 +866,122 @@ extern "C" const char* abieos_bin_to_json(abieos_context* context, uint64_t cont
                                           const char* data, size_t size) {
     fix_null_str(type);
     return handle_exceptions(context, nullptr, [&]() -> const char* {
-        if (!data)
-            size = 0;
         context->last_error = "binary decode error";
-        auto contract_it = context->contracts.find(::abieos::name{contract});
+        auto* c = find_contract(context, contract);
         std::string error;
-        if (contract_it == context->contracts.end()) {
+        if (!c) {
             (void)set_error(error, "contract \"" + sysio::name_to_string(contract) + "\" is not loaded");
             return nullptr;
         }
-        auto t = contract_it->second.get_type(type);
-        sysio::input_stream bin{data, size};
-        context->result_str = t->bin_to_json(bin);
-        return context->result_str.c_str();
+        return abieos_handle_bin_to_json(context, to_handle(c->get_type(type)), data, size);
+    });
+}
+
+extern "C" const char* abieos_bin_to_json_at_block(abieos_context* context, uint64_t contract, uint32_t block_num,
+                                                   const char* type, const char* data, size_t size) {
+    fix_null_str(type);
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        context->last_error = "binary decode error";
+        auto& c = get_contract(context, contract, block_num);
+        return abieos_handle_bin_to_json(context, to_handle(c.get_type(type)), data, size);
+    });
+}
+
+extern "C" int64_t abieos_json_to_bin_into(abieos_context* context, uint64_t contract, const char* type,
+                                           const char* json, char* out, size_t out_size) {
+    fix_null_str(type);
+    fix_null_str(json);
+    return handle_exceptions(context, -1, [&]() -> int64_t {
+        context->last_error = "json parse error";
+        auto& c = get_contract(context, contract);
+        auto t = c.get_type(type);
+        if (!out)
+            out_size = 0;
+        sysio::truncating_buf_stream stream{out, out_size};
+        conversion_error error;
+        if (!json_to_bin(stream, t, json, [] {}, context->scratch, error)) {
+            set_error(context, std::move(error));
+            return -1;
+        }
+        return stream.size;
+    });
+}
+
+extern "C" int64_t abieos_bin_to_json_into(abieos_context* context, uint64_t contract, const char* type,
+                                           const char* data, size_t size, char* out, size_t out_size) {
+    fix_null_str(type);
+    return handle_exceptions(context, -1, [&]() -> int64_t {
+        context->last_error = "binary decode error";
+        auto& c = get_contract(context, contract);
+        return abieos_handle_bin_to_json_into(context, to_handle(c.get_type(type)), data, size, out, out_size);
+    });
+}
+
+extern "C" int64_t abieos_bin_to_json_size(abieos_context* context, uint64_t contract, const char* type,
+                                           const char* data, size_t size) {
+    return abieos_bin_to_json_into(context, contract, type, data, size, nullptr, 0);
+}
+
+extern "C" const char* abieos_bin_to_json_batch(abieos_context* context, const abieos_bin_to_json_item* items,
+                                                size_t count, abieos_batch_result* results) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        if (count && (!items || !results)) {
+            set_error(context, "no data");
+            return nullptr;
+        }
+        auto& arena = context->batch_arena;
+        arena.clear();
+        sysio::vector_stream writer{arena};
+
+        // Consecutive items usually share a contract and often a type
+        const abi* c = nullptr;
+        uint64_t c_name = 0;
+        const abi_type* t = nullptr;
+        const char* t_name = nullptr;
+
+        for (size_t i = 0; i < count; ++i) {
+            auto& item = items[i];
+            auto& result = results[i];
+            const char* type = item.type;
+            fix_null_str(type);
+            result.offset = arena.size();
+            result.error = abieos_error_none;
+            try {
+                if (!c || c_name != item.contract) {
+                    result.error = abieos_error_contract_not_loaded;
+                    c = find_contract(context, item.contract);
+                    t = nullptr;
+                    if (!c)
+                        throw std::runtime_error("contract \"" + sysio::name_to_string(item.contract) +
+                                                 "\" is not loaded");
+                    c_name = item.contract;
+                }
+                if (!t || (t_name != type && strcmp(t_name, type))) {
+                    result.error = abieos_error_unknown_type;
+                    t = nullptr;
+                    t = c->get_type(type);
+                    t_name = type;
+                }
+                result.error = abieos_error_decode;
+                sysio::input_stream bin{item.data, item.data ? item.size : 0};
+                conversion_error error;
+                if (!bin_to_json(bin, t, writer, [] {}, context->scratch, error)) {
+                    arena.resize(result.offset);
+                    writer.write(error.message.data(), error.message.size());
+                } else {
+                    result.error = abieos_error_none;
+                }
+            } catch (std::exception& e) {
+                arena.resize(result.offset);
+                writer.write(e.what(), strlen(e.what()));
+            }
+            result.size = arena.size() - result.offset;
+            writer.write(char(0));
+        }
+        // null is reserved for errors, even when the batch is empty
+        if (arena.empty())
+            arena.push_back(0);
+        return arena.data();
     });
 }
 
@@ -262,7 +1004,7 @@ extern "C" abieos_bool abieos_abi_json_to_bin(abieos_context* context, const cha
     fix_null_str(abi_json);
     return handle_exceptions(context, false, [&] {
         std::string abi_copy{abi_json};
-        sysio::json_token_stream json_stream(abi_copy.data());
+        sysio::json_token_stream json_stream(abi_copy.data(), abi_copy.size());
         abi_def def{};
         std::string error;
         from_json(def, json_stream);
@@ -307,3 +1049,417 @@ extern "C" abieos_bool abieos_delete_contract(abieos_context* context, uint64_t
         return true;
     }
 }
+
+extern "C" abieos_registry* abieos_registry_create() {
+    try {
+        return new abieos_registry{};
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+extern "C" void abieos_registry_release(abieos_registry* registry) { release(registry); }
+
+bool registry_set_abi(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                      std::optional<uint32_t> block_num, const char* abi) {
+    if (!registry)
+        return set_error(context, "registry is null");
+    auto c = share_abi(context, registry->cache, abi);
+    if (!c)
+        return false;
+    publish(registry, contract, block_num, std::move(c));
+    return true;
+}
+
+bool registry_set_abi_bin(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                          std::optional<uint32_t> block_num, const char* data, size_t size) {
+    if (!registry)
+        return set_error(context, "registry is null");
+    auto c = share_abi(context, registry->cache, data, size);
+    if (!c)
+        return false;
+    publish(registry, contract, block_num, std::move(c));
+    return true;
+}
+
+bool registry_set_abi_hex(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                          std::optional<uint32_t> block_num, const char* hex) {
+    std::vector<char> data;
+    std::string error;
+    if (!unhex(error, hex, hex + strlen(hex), std::back_inserter(data))) {
+        if (!error.empty())
+            set_error(context, std::move(error));
+        return false;
+    }
+    return registry_set_abi_bin(context, registry, contract, block_num, data.data(), data.size());
+}
+
+extern "C" abieos_bool abieos_registry_set_abi(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                               const char* abi) {
+    fix_null_str(abi);
+    return handle_exceptions(context, false, [&] { return registry_set_abi(context, registry, contract, {}, abi); });
+}
+
+extern "C" abieos_bool abieos_registry_set_abi_bin(abieos_context* context, abieos_registry* registry,
+                                                   uint64_t contract, const char* data, size_t size) {
+    return handle_exceptions(context, false,
+                             [&] { return registry_set_abi_bin(context, registry, contract, {}, data, size); });
+}
+
+extern "C" abieos_bool abieos_registry_set_abi_hex(abieos_context* context, abieos_registry* registry,
+                                                   uint64_t contract, const char* hex) {
+    fix_null_str(hex);
+    return handle_exceptions(context, false,
+                             [&] { return registry_set_abi_hex(context, registry, contract, {}, hex); });
+}
+
+extern "C" const char* abieos_set_abis_bulk(abieos_context* context, abieos_registry* registry,
+                                            const abieos_abi_item* items, size_t count, size_t threads,
+                                            abieos_batch_result* results) {
+    return handle_exceptions(context, nullptr, [&]() -> const char* {
+        if (count && (!items || !results)) {
+            set_error(context, "no data");
+            return nullptr;
+        }
+        auto& cache = registry ? registry->cache : context->cache;
+        std::vector<std::shared_ptr<const abi>> abis(count);
+        std::vector<std::string> errors(count);
+
+        // Workers take the next item until none are left. Each reports errors through its own context.
+        std::atomic<size_t> next{0};
+        auto work = [&] {
+            abieos_context worker;
+            worker.lazy_abis = context->lazy_abis;
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+                try {
+                    abis[i] = share_abi(&worker, cache, items[i].data, items[i].size);
+                    if (!abis[i])
+                        errors[i] = worker.last_error;
+                } catch (std::exception& e) {
+                    errors[i] = e.what();
+                } catch (...) {
+                    errors[i] = "unknown exception";
+                }
+            }
+        };
+        if (!threads)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, count);
+        std::vector<std::thread> pool;
+        try {
+            for (size_t i = 1; i < threads; ++i)
+                pool.emplace_back(work);
+        } catch (...) {
+            // Carry on with the workers which did start
+        }
+        work();
+        for (auto& t : pool)
+            t.join();
+
+        if (registry) {
+            publish(registry, [&](registry_snapshot& s) {
+                for (size_t i = 0; i < count; ++i)
+                    if (abis[i])
+                        s.set(name{items[i].contract}, {{0, abis[i]}});
+            });
+        } else {
+            for (size_t i = 0; i < count; ++i)
+                if (abis[i])
+                    context->contracts.insert({name{items[i].contract}, abis[i]});
+        }
+
+        auto& arena = context->batch_arena;
+        arena.clear();
+        for (size_t i = 0; i < count; ++i) {
+            results[i].offset = arena.size();
+            results[i].size = errors[i].size();
+            results[i].error = abis[i] ? abieos_error_none : abieos_error_bad_abi;
+            arena.insert(arena.end(), errors[i].begin(), errors[i].end());
+            arena.push_back(0);
+        }
+        // null is reserved for errors, even when the batch is empty
+        if (arena.empty())
+            arena.push_back(0);
+        return arena.data();
+    });
+}
+
+// Replace every version of a contract in a registry, or add a version which activates at block_num. update compiles
+// the new abi from the version it supersedes: the one in effect at block_num, or else the latest. It runs outside
+// the registry's mutex, so if another update replaced that version in the meantime, it runs again from the new one.
+template <typename F>
+const char* registry_update_contract(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                     std::optional<uint32_t> block_num, F update) {
+    auto superseded = [&](const registry_snapshot& s) {
+        auto* c = find_version(s, contract, block_num);
+        return c ? *c : nullptr;
+    };
+    for (;;) {
+        auto previous = superseded(*std::atomic_load(&registry->snapshot));
+        auto c        = update(previous);
+        if (!c)
+            return nullptr;
+        if (publish_if(registry, [&](registry_snapshot& s) {
+                if (superseded(s) != previous)
+                    return false;
+                set_version(s, contract, block_num, std::move(c));
+                return true;
+            }))
+            return context->result_str.c_str();
+    }
+}
+
+const char* registry_update_abi(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                std::optional<uint32_t> block_num, const char* abi) {
+    if (!registry)
+        throw std::runtime_error("registry is null");
+    abi_def def{};
+    if (!parse_abi(context, abi, def))
+        return nullptr;
+    return registry_update_contract(context, registry, contract, block_num, [&](auto previous) {
+        return update_abi(context, registry->cache, abi, def, std::move(previous));
+    });
+}
+
+const char* registry_update_abi_bin(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                    std::optional<uint32_t> block_num, const char* data, size_t size) {
+    if (!registry)
+        throw std::runtime_error("registry is null");
+    abi_def def{};
+    if (!parse_abi(context, data, size, def))
+        return nullptr;
+    return registry_update_contract(context, registry, contract, block_num, [&](auto previous) {
+        return update_abi(context, registry->cache, data, size, def, std::move(previous));
+    });
+}
+
+extern "C" const char* abieos_registry_update_abi(abieos_context* context, abieos_registry* registry,
+                                                  uint64_t contract, const char* abi) {
+    fix_null_str(abi);
+    return handle_exceptions(context, nullptr,
+                             [&] { return registry_update_abi(context, registry, contract, {}, abi); });
+}
+
+extern "C" const char* abieos_registry_update_abi_bin(abieos_context* context, abieos_registry* registry,
+                                                      uint64_t contract, const char* data, size_t size) {
+    return handle_exceptions(context, nullptr,
+                             [&] { return registry_update_abi_bin(context, registry, contract, {}, data, size); });
+}
+
+extern "C" const char* abieos_registry_update_abi_at_block(abieos_context* context, abieos_registry* registry,
+                                                           uint64_t contract, uint32_t block_num, const char* abi) {
+    fix_null_str(abi);
+    return handle_exceptions(context, nullptr,
+                             [&] { return registry_update_abi(context, registry, contract, block_num, abi); });
+}
+
+extern "C" const char* abieos_registry_update_abi_bin_at_block(abieos_context* context, abieos_registry* registry,
+                                                               uint64_t contract, uint32_t block_num,
+                                                               const char* data, size_t size) {
+    return handle_exceptions(context, nullptr, [&] {
+        return registry_update_abi_bin(context, registry, contract, block_num, data, size);
+    });
+}
+
+extern "C" abieos_bool abieos_registry_set_abi_at_block(abieos_context* context, abieos_registry* registry,
+                                                        uint64_t contract, uint32_t block_num, const char* abi) {
+    fix_null_str(abi);
+    return handle_exceptions(context, false,
+                             [&] { return registry_set_abi(context, registry, contract, block_num, abi); });
+}
+
+extern "C" abieos_bool abieos_registry_set_abi_bin_at_block(abieos_context* context, abieos_registry* registry,
+                                                            uint64_t contract, uint32_t block_num, const char* data,
+                                                            size_t size) {
+    return handle_exceptions(context, false,
+                             [&] { return registry_set_abi_bin(context, registry, contract, block_num, data, size); });
+}
+
+extern "C" abieos_bool abieos_registry_set_abi_hex_at_block(abieos_context* context, abieos_registry* registry,
+                                                            uint64_t contract, uint32_t block_num, const char* hex) {
+    fix_null_str(hex);
+    return handle_exceptions(context, false,
+                             [&] { return registry_set_abi_hex(context, registry, contract, block_num, hex); });
+}
+
+extern "C" abieos_bool abieos_registry_delete_contract(abieos_registry* registry, uint64_t contract) {
+    if (!registry)
+        return false;
+    try {
+        bool found = false;
+        publish(registry, [&](registry_snapshot& s) { found = s.erase(name{contract}); });
+        return found;
+    } catch (...) {
+        return false;
+    }
+}
+
+extern "C" abieos_bool abieos_registry_prune(abieos_registry* registry, uint32_t block_num) {
+    if (!registry)
+        return false;
+    try {
+        publish(registry, [&](registry_snapshot& s) {
+            std::vector<std::pair<name, abi_versions>> pruned;
+            s.for_each([&](name contract, const abi_versions& versions) {
+                auto v = std::upper_bound(versions.begin(), versions.end(), block_num,
+                                          [](uint32_t b, const abi_version& v) { return b < v.block_num; });
+                if (v != versions.begin() && std::prev(v) != versions.begin())
+                    pruned.push_back({contract, abi_versions(std::prev(v), versions.end())});
+            });
+            for (auto& [contract, versions] : pruned)
+                s.set(contract, std::move(versions));
+        });
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+extern "C" abieos_bool abieos_attach_registry(abieos_context* context, abieos_registry* registry) {
+    if (!context)
+        return false;
+    if (registry)
+        registry->refs.fetch_add(1, std::memory_order_relaxed);
+    release(context->registry);
+    context->registry = registry;
+    context->registry_contracts = nullptr;
+    if (registry)
+        refresh(context, registry);
+    return true;
+}
+
+extern "C" abieos_bool abieos_get_abi_stats(abieos_context* context, abieos_abi_stats* stats) {
+    return handle_exceptions(context, false, [&] {
+        if (!stats)
+            return set_error(context, "stats is null");
+        get_stats(context->cache, stats);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_registry_get_abi_stats(abieos_registry* registry, abieos_abi_stats* stats) {
+    if (!registry || !stats)
+        return false;
+    get_stats(registry->cache, stats);
+    return true;
+}
+
+// Registry snapshots hold every contract version of a registry. Every value is a little-endian uint32:
+//    magic, abi count, version count
+//    versions  contract (low, high), block_num, abi index
+//    abis      image size, then the abi image (see sysio::save_abi_image) padded to a multiple of 4 bytes
+// Versions are ordered by contract, then block_num. Contract versions which share an abi share one image.
+constexpr uint32_t snapshot_magic = 0x72626161; // "aabr"
+
+void put_u32(std::vector<char>& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        out.push_back(char(value >> (8 * i)));
+}
+
+void save_snapshot(const registry_snapshot& snapshot, std::vector<char>& out) {
+    std::vector<const abi*> abis;
+    std::unordered_map<const abi*, uint32_t> index;
+    size_t version_count = 0;
+    std::vector<std::pair<name, const abi_versions*>> contracts;
+    snapshot.for_each([&](name contract, const abi_versions& versions) {
+        for (auto& v : versions)
+            if (index.try_emplace(v.c.get(), uint32_t(abis.size())).second)
+                abis.push_back(v.c.get());
+        version_count += versions.size();
+        contracts.push_back({contract, &versions});
+    });
+    std::sort(contracts.begin(), contracts.end(), [](auto& a, auto& b) { return a.first.value < b.first.value; });
+
+    out.clear();
+    put_u32(out, snapshot_magic);
+    put_u32(out, uint32_t(abis.size()));
+    put_u32(out, uint32_t(version_count));
+    for (auto& [contract, versions] : contracts) {
+        for (auto& v : *versions) {
+            put_u32(out, uint32_t(contract.value));
+            put_u32(out, uint32_t(contract.value >> 32));
+            put_u32(out, v.block_num);
+            put_u32(out, index[v.c.get()]);
+        }
+    }
+    for (auto* c : abis) {
+        auto size_pos = out.size();
+        put_u32(out, 0);
+        save_abi_image(*c, out);
+        auto size = out.size() - size_pos - 4;
+        if (size >= ~uint32_t(0))
+            throw std::runtime_error("abi image is too large");
+        for (int i = 0; i < 4; ++i)
+            out[size_pos + i] = char(size >> (8 * i));
+        out.resize((out.size() + 3) & ~size_t(3));
+    }
+}
+
+sysio::flat_map<name, abi_versions> load_snapshot(const char* data, size_t size) {
+    auto bad = [] { throw std::runtime_error("malformed registry snapshot"); };
+    size_t pos = 0;
+    auto u32 = [&] {
+        if (!data || size - pos < 4)
+            bad();
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+            value |= uint32_t(uint8_t(data[pos + i])) << (8 * i);
+        pos += 4;
+        return value;
+    };
+    if (u32() != snapshot_magic)
+        bad();
+    uint32_t abi_count = u32(), version_count = u32();
+    if (version_count > (size - pos) / 16)
+        bad();
+    auto versions_pos = pos;
+    pos += size_t(version_count) * 16;
+
+    std::vector<std::shared_ptr<const abi>> abis;
+    for (uint32_t i = 0; i < abi_count; ++i) {
+        size_t image_size = u32();
+        if (image_size > size - pos)
+            bad();
+        abi c;
+        load_abi_image(data + pos, image_size, c);
+        abis.push_back(std::make_shared<const abi>(std::move(c)));
+        pos = std::min(size, (pos + image_size + 3) & ~size_t(3));
+    }
+
+    sysio::flat_map<name, abi_versions> result;
+    pos = versions_pos;
+    for (uint32_t i = 0; i < version_count; ++i) {
+        name contract{u32() | uint64_t(u32()) << 32};
+        uint32_t block_num = u32(), abi_index = u32();
+        if (abi_index >= abis.size())
+            bad();
+        auto& versions = result[contract];
+        if (!versions.empty() && versions.back().block_num >= block_num)
+            bad();
+        versions.push_back({block_num, abis[abi_index]});
+    }
+    return result;
+}
+
+extern "C" abieos_bool abieos_registry_save(abieos_context* context, abieos_registry* registry) {
+    return handle_exceptions(context, false, [&] {
+        if (!registry)
+            return set_error(context, "registry is null");
+        save_snapshot(*std::atomic_load(&registry->snapshot), context->result_bin);
+        return true;
+    });
+}
+
+extern "C" abieos_bool abieos_registry_load(abieos_context* context, abieos_registry* registry, const char* data,
+                                            size_t size) {
+    return handle_exceptions(context, false, [&] {
+        if (!registry)
+            return set_error(context, "registry is null");
+        auto loaded = load_snapshot(data, size);
+        publish(registry, [&](registry_snapshot& s) {
+            for (auto& [contract, versions] : loaded)
+                s.set(contract, std::move(versions));
+        });
+        return true;
+    });
+}
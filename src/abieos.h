@@ -10,8 +10,69 @@ extern "C" {
 #endif
 
 typedef struct abieos_context_s abieos_context;
+typedef struct abieos_registry_s abieos_registry;
+typedef const struct abieos_type_handle_s* abieos_type_handle;
 typedef int abieos_bool;
 
+// Per-item error codes for batch functions
+typedef enum abieos_error_code {
+    abieos_error_none = 0,
+    abieos_error_contract_not_loaded = 1,
+    abieos_error_unknown_type = 2,
+    abieos_error_decode = 3,
+    abieos_error_bad_abi = 4,
+} abieos_error_code;
+
+// An input to abieos_bin_to_json_batch
+typedef struct abieos_bin_to_json_item {
+    uint64_t contract;
+    const char* type;
+    const char* data;
+    size_t size;
+} abieos_bin_to_json_item;
+
+// An input to abieos_set_abis_bulk: a binary abi for a contract
+typedef struct abieos_abi_item {
+    uint64_t contract;
+    const char* data;
+    size_t size;
+} abieos_abi_item;
+
+// Location of one result within a batch arena. On error, the arena range holds the error message instead of json.
+typedef struct abieos_batch_result {
+    size_t offset;
+    size_t size;
+    abieos_error_code error;
+} abieos_batch_result;
+
+// What stopped the last failed call
+typedef enum abieos_error_kind {
+    abieos_error_kind_none = 0,              // no call has failed yet
+    abieos_error_kind_other = 1,             // not a malformed input, e.g. an unknown contract or type
+    abieos_error_kind_overrun = 2,           // binary ended early
+    abieos_error_kind_invalid_varuint = 3,   // binary holds an overlong varuint
+    abieos_error_kind_bad_variant_index = 4, // binary selects a variant alternative which doesn't exist
+    abieos_error_kind_recursion_limit = 5,   // input nests too deeply
+    abieos_error_kind_json = 6,              // json is malformed or doesn't match the type
+} abieos_error_kind;
+
+// Structured form of the last error. offset is the byte offset in the binary or json input where conversion stopped.
+// path names the value being converted, e.g. "transfer.quantity"; it's empty for errors of kind other. The context
+// owns path.
+typedef struct abieos_error_report {
+    abieos_error_kind kind;
+    size_t offset;
+    const char* path;
+} abieos_error_report;
+
+// Abi loading counters. Contracts which load a byte-identical abi share the already compiled copy instead of compiling
+// their own.
+typedef struct abieos_abi_stats {
+    uint64_t abis_compiled;     // abis which were compiled
+    uint64_t abis_deduplicated; // abis which shared an already compiled abi
+    uint64_t bytes_saved;       // source size of the abis which were deduplicated
+} abieos_abi_stats;
+
 // Create a context. The context holds all memory allocated by functions in this header. Returns null on failure.
 abieos_context* abieos_create();
 
@@ -21,6 +82,15 @@ void abieos_destroy(abieos_context* context);
 // Get last error. Never returns null. The context owns the returned string.
 const char* abieos_get_error(abieos_context* context);
 
+// Get the structured form of the last error. Conversion functions detect malformed binary without throwing internally,
+// so feeds with many bad inputs stay cheap. Returns false on error.
+abieos_bool abieos_get_error_report(abieos_context* context, abieos_error_report* report);
+
+// Free the buffers which conversions reuse for their temporaries. They grow to fit the largest input converted so far;
+// once they have, converting similar inputs makes no further allocations for temporaries. Call this after converting
+// an unusually large input to give the memory back.
+void abieos_reset_scratch(abieos_context* context);
+
 // Get generated binary. The context owns the returned memory. Functions return null on error; use abieos_get_error to
 // retrieve error.
 int abieos_get_bin_size(abieos_context* context);
@@ -30,11 +100,22 @@ const char* abieos_get_bin_data(abieos_context* context);
 // retrieve error.
 const char* abieos_get_bin_hex(abieos_context* context);
 
+// Convert generated binary to hex, writing into a caller-supplied buffer. Returns the size of the hex string, not
+// including the null terminator, or -1 on error. Like snprintf, if the return value is not less than out_size the
+// output was truncated; call again with a buffer of at least the returned size + 1. Nothing is written when out_size
+// is 0.
+int64_t abieos_get_bin_hex_into(abieos_context* context, char* out, size_t out_size);
+
 // Name conversion. The context owns the returned memory. Functions return null on error; use abieos_get_error to
 // retrieve error.
 uint64_t abieos_string_to_name(abieos_context* context, const char* str);
 const char* abieos_name_to_string(abieos_context* context, uint64_t name);
 
+// Choose whether abis set through this context afterwards, including abis it sets in a registry, are resolved lazily:
+// each type is resolved on first use instead of when the abi is set. Loading is faster and uses less memory when only
+// some of an abi's types are used, but errors in a type are only reported once it is used. Off by default.
+void abieos_set_lazy_abis(abieos_context* context, abieos_bool lazy);
+
 // Set abi (JSON format). Returns false on error.
 abieos_bool abieos_set_abi(abieos_context* context, uint64_t contract, const char* abi);
 
@@ -44,6 +125,25 @@ abieos_bool abieos_set_abi_bin(abieos_context* context, uint64_t contract, const
 // Set abi (hex format). Returns false on error.
 abieos_bool abieos_set_abi_hex(abieos_context* context, uint64_t contract, const char* hex);
 
+// Replace a contract's abi (JSON format), reusing the compiled types of the current abi which are unchanged: those
+// whose definitions, and the definitions of every type they depend on, are the same. The current abi is the context's
+// own, or else the latest version in the attached registry. An identical abi which is already loaded is shared, and
+// lazy contexts (see abieos_set_lazy_abis) load the new abi lazily. Returns a JSON array of the names of the types
+// which were added, removed or changed, e.g. ["transfer","transfer_memo"]. The context owns the returned string.
+// Returns null on error.
+const char* abieos_update_abi(abieos_context* context, uint64_t contract, const char* abi);
+
+// Replace a contract's abi (binary format). See abieos_update_abi. Returns null on error.
+const char* abieos_update_abi_bin(abieos_context* context, uint64_t contract, const char* data, size_t size);
+
+// Set count binary abis, parsing and compiling them on up to threads worker threads, or one per core if threads is 0.
+// Once all are compiled, the abis are published together into registry, or into the context if registry is null, as
+// abieos_registry_set_abi_bin or abieos_set_abi_bin would. Items which fail are skipped. The function returns an arena
+// which the context owns and fills results[i] with the location of item i's error message, which is empty if the item
+// succeeded. Returns null on error; use abieos_get_error to retrieve error.
+const char* abieos_set_abis_bulk(abieos_context* context, abieos_registry* registry, const abieos_abi_item* items,
+                                 size_t count, size_t threads, abieos_batch_result* results);
+
 // Get the type name for an action. The context owns the returned memory. Returns null on error; use abieos_get_error
 // to retrieve error.
 const char* abieos_get_type_for_action(abieos_context* context, uint64_t contract, uint64_t action);
@@ -63,11 +163,112 @@ abieos_bool abieos_json_to_bin(abieos_context* context, uint64_t contract, const
 abieos_bool abieos_json_to_bin_reorderable(abieos_context* context, uint64_t contract, const char* type,
                                            const char* json);
 
+// Convert json to binary, writing into a caller-supplied buffer instead of the context. Returns the size of the binary
+// or -1 on error; use abieos_get_error to retrieve error. If the return value is greater than out_size the output was
+// truncated; call again with a buffer of at least the returned size.
+int64_t abieos_json_to_bin_into(abieos_context* context, uint64_t contract, const char* type, const char* json,
+                                char* out, size_t out_size);
+
+// Convert json to binary without copying it first. json holds size bytes of json followed by 3 NUL bytes, so the
+// buffer is at least size + 3 bytes long. The buffer is clobbered: its contents are unspecified afterwards, whether or
+// not the conversion succeeds. Use abieos_get_bin_* to retrieve result. Returns false on error.
+abieos_bool abieos_json_to_bin_insitu(abieos_context* context, uint64_t contract, const char* type, char* json,
+                                      size_t size);
+
 // Convert binary to json. The context owns the returned string. Returns null on error; use abieos_get_error to retrieve
 // error.
 const char* abieos_bin_to_json(abieos_context* context, uint64_t contract, const char* type, const char* data,
                                size_t size);
 
+// Convert binary to json using the version of the contract's abi in effect at block_num. See
+// abieos_registry_set_abi_at_block. The context owns the returned string. Returns null on error; use abieos_get_error
+// to retrieve error.
+const char* abieos_bin_to_json_at_block(abieos_context* context, uint64_t contract, uint32_t block_num,
+                                        const char* type, const char* data, size_t size);
+
+// Convert binary to json, writing into a caller-supplied buffer instead of the context. Returns the size of the json,
+// not including the null terminator, or -1 on error; use abieos_get_error to retrieve error. Like snprintf, if the
+// return value is not less than out_size the output was truncated; call again with a buffer of at least the returned
+// size + 1. Nothing is written when out_size is 0.
+int64_t abieos_bin_to_json_into(abieos_context* context, uint64_t contract, const char* type, const char* data,
+                                size_t size, char* out, size_t out_size);
+
+// Get the size of the json abieos_bin_to_json would produce, not including the null terminator, without storing it
+// anywhere. Useful for sizing one buffer for many abieos_bin_to_json_into calls. Returns -1 on error; use
+// abieos_get_error to retrieve error.
+int64_t abieos_bin_to_json_size(abieos_context* context, uint64_t contract, const char* type, const char* data,
+                                size_t size);
+
+// Convert count binary values to json. All results are written to one arena which the context owns; the function
+// returns the arena and fills results[i] with the location of item i's json (or error message). Each result is also
+// null-terminated. A failing item does not stop the batch. Returns null on error; use abieos_get_error to retrieve
+// error.
+const char* abieos_bin_to_json_batch(abieos_context* context, const abieos_bin_to_json_item* items, size_t count,
+                                     abieos_batch_result* results);
+
+// Resolve a type once so repeated conversions skip the contract and type lookups. A handle from a contract set on the
+// context stays valid until that contract is replaced or deleted, or the context is destroyed. A handle from an
+// attached registry stays valid until the registry changes and the context performs another contract lookup. Returns
+// null on error; use abieos_get_error to retrieve error.
+abieos_type_handle abieos_get_type_handle(abieos_context* context, uint64_t contract, const char* type);
+
+// Resolve a type using the version of the contract's abi in effect at block_num. See abieos_get_type_handle and
+// abieos_registry_set_abi_at_block. Returns null on error; use abieos_get_error to retrieve error.
+abieos_type_handle abieos_get_type_handle_at_block(abieos_context* context, uint64_t contract, uint32_t block_num,
+                                                   const char* type);
+
+// Convert json to binary using a type handle. Use abieos_get_bin_* to retrieve result. Returns false on error.
+abieos_bool abieos_handle_json_to_bin(abieos_context* context, abieos_type_handle type, const char* json);
+
+// Convert json to binary using a type handle. Allow json field reordering. Use abieos_get_bin_* to retrieve result.
+// Returns false on error.
+abieos_bool abieos_handle_json_to_bin_reorderable(abieos_context* context, abieos_type_handle type, const char* json);
+
+// Convert json to binary in place using a type handle. See abieos_json_to_bin_insitu; json is clobbered. Returns false
+// on error.
+abieos_bool abieos_handle_json_to_bin_insitu(abieos_context* context, abieos_type_handle type, char* json, size_t size);
+
+// Convert binary to json using a type handle. The context owns the returned string. Returns null on error; use
+// abieos_get_error to retrieve error.
+const char* abieos_handle_bin_to_json(abieos_context* context, abieos_type_handle type, const char* data, size_t size);
+
+// Convert binary to json using a type handle, writing into a caller-supplied buffer. See abieos_bin_to_json_into.
+int64_t abieos_handle_bin_to_json_into(abieos_context* context, abieos_type_handle type, const char* data, size_t size,
+                                       char* out, size_t out_size);
+
+// Check that data holds a well-formed binary value of type, with the same rules as abieos_bin_to_json, without
+// producing json. Sets *consumed, if not null, to the size of the value; data may continue past it. Returns false on
+// error; use abieos_get_error_report to find where the value is malformed.
+abieos_bool abieos_validate_bin(abieos_context* context, uint64_t contract, const char* type, const char* data,
+                                size_t size, size_t* consumed);
+
+// Validate binary using a type handle. See abieos_validate_bin.
+abieos_bool abieos_handle_validate_bin(abieos_context* context, abieos_type_handle type, const char* data, size_t size,
+                                       size_t* consumed);
+
+// Find a field of a binary struct value without converting the value. path names the field, or a field of a nested
+// struct, e.g. "act.authorization". Sets *offset and *field_size to the bytes of data which hold the field, and
+// *field_type, if not null, to the field's type. A field which only follows fixed-size fields is found in constant
+// time. Returns false on error.
+abieos_bool abieos_handle_locate_field(abieos_context* context, abieos_type_handle type, const char* data, size_t size,
+                                       const char* path, size_t* offset, size_t* field_size,
+                                       abieos_type_handle* field_type);
+
+// Convert an action's binary data to json, using the type the abi declares for the action. The context owns the
+// returned string. Returns null on error; use abieos_get_error to retrieve error.
+const char* abieos_action_bin_to_json(abieos_context* context, uint64_t contract, uint64_t action, const char* data,
+                                      size_t size);
+
+// Convert a table row to json, using the type the abi declares for the table. The context owns the returned string.
+// Returns null on error; use abieos_get_error to retrieve error.
+const char* abieos_table_bin_to_json(abieos_context* context, uint64_t contract, uint64_t table, const char* data,
+                                     size_t size);
+
+// Convert an action's return value to json, using the type the abi declares for the action_result. The context owns
+// the returned string. Returns null on error; use abieos_get_error to retrieve error.
+const char* abieos_action_result_bin_to_json(abieos_context* context, uint64_t contract, uint64_t action_result,
+                                             const char* data, size_t size);
+
 // Convert hex to json. The context owns the returned memory. Returns null on error; use abieos_get_error to retrieve
 // error.
 const char* abieos_hex_to_json(abieos_context* context, uint64_t contract, const char* type, const char* hex);
@@ -82,6 +283,91 @@ const char* abieos_abi_bin_to_json(abieos_context* context, const char* abi_bin_
 // Delete a contract from the context
 abieos_bool abieos_delete_contract(abieos_context* context, uint64_t contract);
 
+// Get the abi loading counters for abis set on the context. Returns false on error.
+abieos_bool abieos_get_abi_stats(abieos_context* context, abieos_abi_stats* stats);
+
+// Create a registry. A registry holds compiled abis which can be shared by many contexts, including contexts used on
+// different threads. The caller owns one reference; release it with abieos_registry_release. Returns null on failure.
+abieos_registry* abieos_registry_create();
+
+// Release a reference to a registry. The registry is destroyed once the caller's reference and all attached contexts
+// have released it.
+void abieos_registry_release(abieos_registry* registry);
+
+// Set abi (JSON format) in a registry, replacing every abi version previously set for the contract. May be called while
+// other threads are converting through attached contexts; they see the new abi on their next call. Errors are reported
+// through context. Returns false on error.
+abieos_bool abieos_registry_set_abi(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                    const char* abi);
+
+// Set abi (binary format) in a registry. See abieos_registry_set_abi. Returns false on error.
+abieos_bool abieos_registry_set_abi_bin(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                        const char* data, size_t size);
+
+// Set abi (hex format) in a registry. See abieos_registry_set_abi. Returns false on error.
+abieos_bool abieos_registry_set_abi_hex(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                        const char* hex);
+
+// Replace every abi version of a contract in a registry (JSON format), reusing the unchanged compiled types of its
+// latest version. See abieos_update_abi. Returns null on error.
+const char* abieos_registry_update_abi(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                       const char* abi);
+
+// Replace every abi version of a contract in a registry (binary format). See abieos_update_abi. Returns null on error.
+const char* abieos_registry_update_abi_bin(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                           const char* data, size_t size);
+
+// Add a version of a contract's abi (JSON format) to a registry, as abieos_registry_set_abi_at_block does, reusing the
+// unchanged compiled types of the version in effect at block_num. Other versions are kept. Returns the types which
+// changed relative to that version; see abieos_update_abi. Returns null on error.
+const char* abieos_registry_update_abi_at_block(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                                uint32_t block_num, const char* abi);
+
+// Add a version of a contract's abi (binary format). See abieos_registry_update_abi_at_block. Returns null on error.
+const char* abieos_registry_update_abi_bin_at_block(abieos_context* context, abieos_registry* registry,
+                                                    uint64_t contract, uint32_t block_num, const char* data,
+                                                    size_t size);
+
+// Add a version of a contract's abi (JSON format) to a registry which takes effect at block_num and stays in effect
+// until the next version's block. Replaces a version which activates at the same block. Calls which take a block
+// number use the version in effect at that block; other calls use the version with the highest block_num. Readers are
+// never blocked, and superseded versions are freed once no context holds them. Errors are reported through context.
+// Returns false on error.
+abieos_bool abieos_registry_set_abi_at_block(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                             uint32_t block_num, const char* abi);
+
+// Add a version of a contract's abi (binary format). See abieos_registry_set_abi_at_block. Returns false on error.
+abieos_bool abieos_registry_set_abi_bin_at_block(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                                 uint32_t block_num, const char* data, size_t size);
+
+// Add a version of a contract's abi (hex format). See abieos_registry_set_abi_at_block. Returns false on error.
+abieos_bool abieos_registry_set_abi_hex_at_block(abieos_context* context, abieos_registry* registry, uint64_t contract,
+                                                 uint32_t block_num, const char* hex);
+
+// Drop the abi versions which were superseded at or before block_num, e.g. once a replay has passed that block.
+// Lookups before the oldest remaining version fail afterwards. Returns false on error.
+abieos_bool abieos_registry_prune(abieos_registry* registry, uint32_t block_num);
+
+// Delete a contract from a registry. Returns false if the contract was not present.
+abieos_bool abieos_registry_delete_contract(abieos_registry* registry, uint64_t contract);
+
+// Get the abi loading counters for abis set in a registry. Returns false on error.
+abieos_bool abieos_registry_get_abi_stats(abieos_registry* registry, abieos_abi_stats* stats);
+
+// Save every contract version of a registry as a snapshot of the compiled abis. Use abieos_get_bin_data and
+// abieos_get_bin_size to retrieve it. Returns false on error.
+abieos_bool abieos_registry_save(abieos_context* context, abieos_registry* registry);
+
+// Load a snapshot from abieos_registry_save into a registry, replacing every version of the contracts it holds. The
+// abis are rebuilt without parsing their definitions. data may point into a memory-mapped file and isn't referenced
+// after this returns. Errors are reported through context. Returns false on error.
+abieos_bool abieos_registry_load(abieos_context* context, abieos_registry* registry, const char* data, size_t size);
+
+// Attach a registry to a context, or detach it if registry is null. Contracts which were not set directly on the
+// context are looked up in the registry. The context holds a reference to the registry until it is detached or
+// destroyed. Returns false on error.
+abieos_bool abieos_attach_registry(abieos_context* context, abieos_registry* registry);
+
 #ifdef __cplusplus
 }
 #endif
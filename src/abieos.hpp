@@ -27,7 +27,9 @@
 #pragma clang diagnostic ignored "-W#warnings"
 #endif
 
+#include <array>
 #include <ctime>
+#include <deque>
 #include <map>
 #include <optional>
 #include <variant>
@@ -199,11 +201,6 @@ struct jvalue {
 
 using sysio::abi_type;
 
-struct size_insertion {
-    size_t position = 0;
-    uint32_t size = 0;
-};
-
 struct json_to_jvalue_stack_entry {
     jvalue* value = nullptr;
     std::string key = "";
@@ -220,8 +217,9 @@ struct json_to_bin_stack_entry {
     const abi_type* type = nullptr;
     bool allow_extensions = false;
     int position = -1;
-    size_t size_insertion_index = 0;
+    size_t size_position = 0; // of an array's size, which is written once the array ends
     size_t variant_type_index = 0;
+    const sysio::abi_op* program = nullptr; // type's program, when converting through programs
 };
 
 struct bin_to_json_stack_entry {
@@ -229,8 +227,52 @@ struct bin_to_json_stack_entry {
     bool allow_extensions = false;
     int position = -1;
     uint32_t array_size = 0;
+    uint32_t variant_index = ~uint32_t(0); // chosen alternative, once read
+    const sysio::abi_op* program = nullptr; // type's program, when converting through programs
+};
+
+enum class conversion_error_kind {
+    none,
+    other,
+    overrun,
+    invalid_varuint,
+    bad_variant_index,
+    recursion_limit,
+    json,
+};
+
+// Why a conversion stopped. offset is the position in the input, path names the value being converted, e.g.
+// "transfer.quantity".
+struct conversion_error {
+    conversion_error_kind kind = conversion_error_kind::none;
+    size_t offset = 0;
+    std::string path{};
+    std::string message{};
 };
 
+inline conversion_error_kind to_conversion_error(sysio::stream_error e) {
+    switch (e) {
+    case sysio::stream_error::no_error: return conversion_error_kind::none;
+    case sysio::stream_error::overrun: return conversion_error_kind::overrun;
+    case sysio::stream_error::invalid_varuint_encoding: return conversion_error_kind::invalid_varuint;
+    case sysio::stream_error::bad_variant_index: return conversion_error_kind::bad_variant_index;
+    default: return conversion_error_kind::other;
+    }
+}
+
+inline std::string_view conversion_error_message(conversion_error_kind kind) {
+    switch (kind) {
+    case conversion_error_kind::overrun: return sysio::convert_stream_error(sysio::stream_error::overrun);
+    case conversion_error_kind::invalid_varuint:
+        return sysio::convert_stream_error(sysio::stream_error::invalid_varuint_encoding);
+    case conversion_error_kind::bad_variant_index:
+        return sysio::convert_stream_error(sysio::stream_error::bad_variant_index);
+    case conversion_error_kind::recursion_limit:
+        return sysio::convert_abi_error(sysio::abi_error::recursion_limit_reached);
+    default: return "conversion error";
+    }
+}
+
 struct json_to_jvalue_state : json_reader_handler<json_to_jvalue_state> {
     std::string& error;
     std::vector<json_to_jvalue_stack_entry> stack;
@@ -264,27 +306,100 @@ struct jvalue_to_bin_state {
     }
 };
 
+// Buffers for conversion temporaries. Conversions clear them instead of freeing them, so once they have grown to fit
+// the inputs, converting through the same scratch doesn't allocate.
+struct conversion_scratch {
+    std::vector<char> json{};
+    std::vector<char> json_parser_stack{};
+    std::vector<char> bin{};
+    std::vector<char> text{};
+    std::vector<json_to_bin_stack_entry> json_to_bin_stack{};
+    std::vector<bin_to_json_stack_entry> bin_to_json_stack{};
+    std::deque<std::vector<char>> field_buffers{}; // fields json_to_bin_reorderable received ahead of their turn
+    std::vector<uint32_t> free_field_buffers{};
+    std::vector<uint32_t> field_slots{};
+};
+
 struct json_to_bin_state : sysio::json_token_stream {
     using json_token_stream::json_token_stream;
     sysio::vector_stream& writer;
-    std::vector<size_insertion> size_insertions{};
-    std::vector<json_to_bin_stack_entry> stack{};
+    std::vector<json_to_bin_stack_entry>& stack;
     bool skipped_extension = false;
 
-    explicit json_to_bin_state(char* in, sysio::vector_stream& out)
-      : sysio::json_token_stream(in), writer(out) {}
+    explicit json_to_bin_state(char* in, size_t size, sysio::vector_stream& out, conversion_scratch& scratch)
+      : sysio::json_token_stream(in, size, parser_stack(scratch), stack_buffer_size), writer(out),
+        stack(scratch.json_to_bin_stack) {
+        stack.clear();
+    }
+
+  private:
+    static char* parser_stack(conversion_scratch& scratch) {
+        scratch.json_parser_stack.resize(stack_buffer_size);
+        return scratch.json_parser_stack.data();
+    }
+};
+
+// Writes to whichever buffer is current, so json_to_bin_reorderable can divert fields received out of order
+struct reorder_writer {
+    std::vector<char>* data;
+
+    void write(char c) { data->push_back(c); }
+    void write(const void* src, std::size_t sz) {
+        auto s = reinterpret_cast<const char*>(src);
+        data->insert(data->end(), s, s + sz);
+    }
+    template <typename T>
+    void write_raw(const T& v) {
+        write(&v, sizeof(v));
+    }
+};
+
+inline std::vector<char>& output_buffer(sysio::vector_stream& writer) { return writer.data; }
+inline std::vector<char>& output_buffer(reorder_writer& writer) { return *writer.data; }
+
+struct json_to_bin_reorder_state : sysio::json_token_stream {
+    reorder_writer writer;
+    conversion_scratch& scratch;
+    std::vector<json_to_bin_stack_entry>& stack;
+
+    explicit json_to_bin_reorder_state(char* in, size_t size, std::vector<char>& out, conversion_scratch& scratch)
+        : sysio::json_token_stream(in, size, parser_stack(scratch), stack_buffer_size), writer{&out}, scratch(scratch),
+          stack(scratch.json_to_bin_stack) {
+        stack.clear();
+        scratch.field_slots.clear();
+        scratch.free_field_buffers.clear();
+        for (uint32_t i = 0; i < scratch.field_buffers.size(); ++i)
+            scratch.free_field_buffers.push_back(i);
+    }
+
+  private:
+    static char* parser_stack(conversion_scratch& scratch) {
+        scratch.json_parser_stack.resize(stack_buffer_size);
+        return scratch.json_parser_stack.data();
+    }
 };
 
-struct bin_to_json_state {
+template <typename Stream>
+struct basic_bin_to_json_state {
     sysio::input_stream& bin;
-    sysio::vector_stream& writer;
-    std::vector<bin_to_json_stack_entry> stack{};
+    Stream& writer;
+    const char* begin = bin.pos;
+    std::vector<bin_to_json_stack_entry>& stack;
     bool skipped_extension = false;
+    conversion_error_kind error = conversion_error_kind::none;
 
-    bin_to_json_state(sysio::input_stream& bin, sysio::vector_stream& writer)
-        : bin{bin}, writer{writer} {}
+    basic_bin_to_json_state(sysio::input_stream& bin, Stream& writer, conversion_scratch& scratch)
+        : bin{bin}, writer{writer}, stack{scratch.bin_to_json_stack} {
+        stack.clear();
+    }
+
+    // Serializers report malformed input here instead of throwing, then return without writing more
+    void fail(sysio::stream_error e) { error = to_conversion_error(e); }
 };
 
+using bin_to_json_state = basic_bin_to_json_state<sysio::vector_stream>;
+using bin_to_json_buf_state = basic_bin_to_json_state<sysio::truncating_buf_stream>;
+
 }
 
 namespace sysio {
@@ -296,6 +411,8 @@ struct abi_serializer {
                                           bool start) const = 0;
   virtual void bin_to_json(::abieos::bin_to_json_state& state, bool allow_extensions, const abi_type* type,
                                           bool start) const = 0;
+  virtual void bin_to_json(::abieos::bin_to_json_buf_state& state, bool allow_extensions, const abi_type* type,
+                                          bool start) const = 0;
 };
 
 }
@@ -337,23 +454,61 @@ void json_to_bin(pseudo_fixed_array*, json_to_bin_state& state, bool allow_exten
 void json_to_bin(pseudo_variant*, json_to_bin_state& state, bool allow_extensions,
                                 const abi_type* type, bool start);
 
-void bin_to_json(pseudo_optional*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+void bin_to_json(pseudo_optional*, State& state, bool allow_extensions,
                                 const abi_type* type, bool start);
-void bin_to_json(pseudo_extension*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+void bin_to_json(pseudo_extension*, State& state, bool allow_extensions,
                                 const abi_type* type, bool start);
-void bin_to_json(pseudo_object*, bin_to_json_state& state, bool allow_extensions, const abi_type* type,
+template <typename State>
+void bin_to_json(pseudo_object*, State& state, bool allow_extensions, const abi_type* type,
                                 bool start);
-void bin_to_json(pseudo_array*, bin_to_json_state& state, bool allow_extensions, const abi_type* type,
+template <typename State>
+void bin_to_json(pseudo_array*, State& state, bool allow_extensions, const abi_type* type,
                                 bool start);
-void bin_to_json(pseudo_fixed_array*, bin_to_json_state& state, bool allow_extensions, const abi_type* type,
+template <typename State>
+void bin_to_json(pseudo_fixed_array*, State& state, bool allow_extensions, const abi_type* type,
                                 bool start);
-void bin_to_json(pseudo_variant*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+void bin_to_json(pseudo_variant*, State& state, bool allow_extensions,
                                 const abi_type* type, bool start);
 
+void json_to_bin_start(json_to_bin_state& state, const sysio::abi_op* op, bool allow_extensions);
+void json_to_bin_step(json_to_bin_state& state);
+template <typename State>
+void bin_to_json_start(State& state, const sysio::abi_op* op, bool allow_extensions);
+template <typename State>
+void bin_to_json_step(State& state);
+
 ///////////////////////////////////////////////////////////////////////////////
 // serializable types
 ///////////////////////////////////////////////////////////////////////////////
 
+inline sysio::stream_error skip_bin(sysio::input_stream& bin, uint64_t size) {
+    if (size > bin.remaining())
+        return sysio::stream_error::overrun;
+    bin.pos += size;
+    return sysio::stream_error::no_error;
+}
+
+// varuint32_from_bin and varuint64_from_bin without exceptions; max_shift is 35 or 70. bin is unchanged on error.
+template <typename T, int max_shift>
+sysio::stream_error varuint_from_bin(T& dest, sysio::input_stream& bin) {
+    dest = 0;
+    auto pos = bin.pos;
+    for (int shift = 0; shift < max_shift; shift += 7) {
+        if (pos == bin.end)
+            return sysio::stream_error::overrun;
+        uint8_t b = *pos++;
+        dest |= T(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            bin.pos = pos;
+            return sysio::stream_error::no_error;
+        }
+    }
+    return sysio::stream_error::invalid_varuint_encoding;
+}
+
 using sysio::bytes;
 
 template <typename State>
@@ -364,13 +519,17 @@ void json_to_bin(bytes*, State& state, bool, const abi_type*, bool start) {
     sysio::check( !(s.size() & 1), sysio::convert_json_error(sysio::from_json_error::expected_hex_string) );
     sysio::varuint32_to_bin(s.size() / 2, state.writer);
     // FIXME: Add a function to encode a hex string to a stream
-    sysio::check(sysio::unhex(std::back_inserter(state.writer.data), s.begin(), s.end()),
+    sysio::check(sysio::unhex(std::back_inserter(output_buffer(state.writer)), s.begin(), s.end()),
         sysio::convert_json_error(sysio::from_json_error::expected_hex_string));
 }
 
-inline void bin_to_json(bytes*, bin_to_json_state& state, bool, const abi_type*, bool start) {
+template <typename State>
+void bin_to_json(bytes*, State& state, bool, const abi_type*, bool start) {
     uint64_t size;
-    varuint64_from_bin(size, state.bin);
+    if (auto e = varuint_from_bin<uint64_t, 70>(size, state.bin); e != sysio::stream_error::no_error)
+        return state.fail(e);
+    if (size > state.bin.remaining())
+        return state.fail(sysio::stream_error::overrun);
     const char* data;
     state.bin.read_reuse_storage(data, size);
     return to_json_hex(data, size, state.writer);
@@ -515,22 +674,28 @@ ABIEOS_NODISCARD inline bool receive_event(struct json_to_jvalue_state& state, e
     return true;
 }
 
+// Parses json in place; it must be followed by 3 NUL bytes. Clobbers json.
 template<typename F>
-inline void json_to_jvalue(jvalue& value, std::string_view json, F&& f) {
-    std::string mutable_json{json};
-    mutable_json.push_back(0);
-    mutable_json.push_back(0);
-    mutable_json.push_back(0);
+inline void json_to_jvalue_insitu(jvalue& value, char* json, F&& f) {
     std::string error; // !!!
     json_to_jvalue_state state{error};
     state.stack.push_back({&value});
     rapidjson::Reader reader;
-    rapidjson::InsituStringStream ss(mutable_json.data());
+    rapidjson::InsituStringStream ss(json);
     sysio::check(reader.Parse<rapidjson::kParseValidateEncodingFlag | rapidjson::kParseIterativeFlag |
         rapidjson::kParseNumbersAsStringsFlag>(ss, state),
         sysio::convert_json_error(sysio::from_json_error::unspecific_syntax_error));
 }
 
+template<typename F>
+inline void json_to_jvalue(jvalue& value, std::string_view json, F&& f) {
+    std::string mutable_json{json};
+    mutable_json.push_back(0);
+    mutable_json.push_back(0);
+    mutable_json.push_back(0);
+    json_to_jvalue_insitu(value, mutable_json.data(), f);
+}
+
 ABIEOS_NODISCARD inline bool json_to_jobject(jvalue& value, json_to_jvalue_state& state, event_type event, bool start) {
     if (start) {
         if (event != event_type::received_start_object)
@@ -739,13 +904,12 @@ inline void json_to_bin(pseudo_variant*, jvalue_to_bin_state& state, bool allow_
     if (stack_entry.position == 0) {
         auto& typeName = std::get<std::string>(arr[0].value);
         const std::vector<sysio::abi_field>& fields = *stack_entry.type->as_variant();
-        auto it = std::find_if(fields.begin(), fields.end(),
-                               [&](auto& field) { return field.name == typeName; });
-        sysio::check(it != fields.end(),
+        auto index = stack_entry.type->find_alternative(typeName);
+        sysio::check(index >= 0,
             sysio::convert_json_error(sysio::from_json_error::invalid_type_for_variant));
-        sysio::varuint32_to_bin(it - fields.begin(), state.writer);
+        sysio::varuint32_to_bin(index, state.writer);
         state.received_value = &arr[++stack_entry.position];
-        return it->type->ser->json_to_bin(state, allow_extensions, it->type, true);
+        return fields[index].type->ser->json_to_bin(state, allow_extensions, fields[index].type, true);
     } else {
         if (trace_jvalue_to_bin)
             printf("%*s]\n", int((state.stack.size() - 1) * 4), "");
@@ -771,38 +935,314 @@ inline void json_to_bin(std::string*, State& state, bool, const abi_type*,
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// json_to_bin
+// conversion errors
 ///////////////////////////////////////////////////////////////////////////////
 
-template<typename F>
-inline void json_to_bin(std::vector<char>& bin, const abi_type* type, std::string_view json, F&& f) {
-    std::string mutable_json{json};
-    mutable_json.push_back(0);
-    mutable_json.push_back(0);
-    mutable_json.push_back(0);
-    std::vector<char> out_buf;
-    sysio::vector_stream out(out_buf);
-    json_to_bin_state state(mutable_json.data(), out);
+// Builds the path of the value being converted from the stack, e.g. "transfer.quantity" or "action[2].data".
+// alternative returns the chosen variant field, or null if none has been chosen yet.
+template <typename Entry, typename Alternative>
+std::string conversion_path(const abi_type* root, const std::vector<Entry>& stack, Alternative alternative) {
+    if (stack.empty())
+        return root->name;
+    std::string path = stack.front().type->name;
+    if (stack.front().type->array_of() && path.size() >= 2)
+        path.resize(path.size() - 2);
+    for (auto& entry : stack) {
+        if (auto* s = entry.type->as_struct()) {
+            if (entry.position >= 0 && entry.position < (int)s->fields.size())
+                path.append(".").append(s->fields[entry.position].name);
+        } else if (auto* v = entry.type->as_variant()) {
+            if (auto* field = alternative(entry, *v))
+                path.append(".").append(field->name);
+        } else if (entry.position >= 0) {
+            path.append("[").append(std::to_string(entry.position)).append("]");
+        }
+    }
+    return path;
+}
 
-    type->ser->json_to_bin(state, true, type, true);
-    while(!state.stack.empty()) {
-        f();
-        auto entry = state.stack.back();
-        auto* type = entry.type;
-        sysio::check(state.stack.size() <= max_stack_size,
-            sysio::convert_abi_error(sysio::abi_error::recursion_limit_reached));
-        type->ser->json_to_bin(state, entry.allow_extensions, type, false);
+// Binary size of every T, or sysio::abi_variable_size
+template <typename T>
+constexpr uint32_t fixed_bin_size() {
+    if constexpr (std::is_arithmetic_v<T> || std::is_same_v<T, __int128> || std::is_same_v<T, unsigned __int128>) {
+        return sizeof(T);
+    } else if constexpr (std::is_same_v<T, float128> || std::is_same_v<T, asset>) {
+        return 16;
+    } else if constexpr (std::is_same_v<T, time_point> || std::is_same_v<T, name> || std::is_same_v<T, symbol> ||
+                         std::is_same_v<T, symbol_code>) {
+        return 8;
+    } else if constexpr (std::is_same_v<T, time_point_sec> || std::is_same_v<T, block_timestamp>) {
+        return 4;
+    } else if constexpr (std::is_same_v<T, checksum160>) {
+        return 20;
+    } else if constexpr (std::is_same_v<T, checksum256>) {
+        return 32;
+    } else if constexpr (std::is_same_v<T, checksum512>) {
+        return 64;
+    } else {
+        return sysio::abi_variable_size;
+    }
+}
+
+// Reads the size of a byte vector the way from_bin does: as a varuint64 where size_t has 64 bits, else a varuint32
+inline sysio::stream_error byte_vector_size_from_bin(uint64_t& size, sysio::input_stream& bin) {
+    if constexpr (sizeof(size_t) >= 8) {
+        return varuint_from_bin<uint64_t, 70>(size, bin);
+    } else {
+        uint32_t size32;
+        auto e = varuint_from_bin<uint32_t, 35>(size32, bin);
+        size = size32;
+        return e;
+    }
+}
+
+// Skips what follows the variant index of a key or signature
+template <typename T>
+sysio::stream_error skip_key_data(T*, uint32_t index, sysio::input_stream& bin) {
+    using sysio::stream_error;
+    if constexpr (std::is_same_v<T, private_key>) {
+        return skip_bin(bin, 32);
+    } else {
+        constexpr size_t key_size = std::is_same_v<T, public_key> ? 33 : 65;
+        if (auto e = skip_bin(bin, key_size); e != stream_error::no_error || index != 2)
+            return e;
+        // webauthn: public keys have a presence byte and a string, signatures a byte vector and a string
+        if constexpr (std::is_same_v<T, public_key>) {
+            if (auto e = skip_bin(bin, 1); e != stream_error::no_error)
+                return e;
+        } else {
+            uint64_t size;
+            if (auto e = byte_vector_size_from_bin(size, bin); e != stream_error::no_error)
+                return e;
+            if (auto e = skip_bin(bin, size); e != stream_error::no_error)
+                return e;
+        }
+        uint32_t size;
+        if (auto e = varuint_from_bin<uint32_t, 35>(size, bin); e != stream_error::no_error)
+            return e;
+        return skip_bin(bin, size);
+    }
+}
+
+// Emplaces alternative index of v and reads it with from_bin
+template <size_t I = 0, typename V>
+void variant_alternative_from_bin(V& v, uint32_t index, sysio::input_stream& bin) {
+    if constexpr (I < std::variant_size_v<V>) {
+        if (index == I)
+            return from_bin(v.template emplace<I>(), bin);
+        return variant_alternative_from_bin<I + 1>(v, index, bin);
+    }
+}
+
+// Skips a T the way from_bin would read it. Returns the error from_bin would have thrown; bin may be partly advanced
+// in that case.
+template <typename T>
+sysio::stream_error skip_bin(T*, sysio::input_stream& bin) {
+    using sysio::stream_error;
+    if constexpr (fixed_bin_size<T>() != sysio::abi_variable_size) {
+        return skip_bin(bin, fixed_bin_size<T>());
+    } else if constexpr (std::is_same_v<T, varuint32> || std::is_same_v<T, varint32>) {
+        uint32_t v;
+        return varuint_from_bin<uint32_t, 35>(v, bin);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        uint32_t size;
+        if (auto e = varuint_from_bin<uint32_t, 35>(size, bin); e != stream_error::no_error)
+            return e;
+        return skip_bin(bin, size);
+    } else if constexpr (std::is_same_v<T, bytes>) {
+        uint64_t size;
+        if (auto e = varuint_from_bin<uint64_t, 70>(size, bin); e != stream_error::no_error)
+            return e;
+        return skip_bin(bin, size);
+    } else if constexpr (std::is_same_v<T, bitset>) {
+        uint32_t num_bits;
+        if (auto e = varuint_from_bin<uint32_t, 35>(num_bits, bin); e != stream_error::no_error)
+            return e;
+        return skip_bin(bin, bitset::calc_num_blocks(num_bits));
+    } else if constexpr (std::is_same_v<T, public_key> || std::is_same_v<T, private_key> ||
+                         std::is_same_v<T, signature>) {
+        uint32_t index;
+        if (auto e = varuint_from_bin<uint32_t, 35>(index, bin); e != stream_error::no_error)
+            return e;
+        if (index >= std::variant_size_v<T>)
+            return stream_error::bad_variant_index;
+        return skip_key_data((T*)nullptr, index, bin);
+    } else {
+        static_assert(sizeof(T*) == 0, "skip_bin: unsupported type");
     }
-    sysio::check(state.complete(),
-        sysio::convert_json_error(sysio::from_json_error::expected_end));
+}
+
+// Reads a T the way from_bin would, returning the error from_bin would have thrown instead. Each value is decoded once;
+// a length is checked against the input before the bytes it covers are read. bin may be partly advanced on error.
+template <typename T>
+sysio::stream_error read_bin(T& v, sysio::input_stream& bin) {
+    using sysio::stream_error;
+    if constexpr (fixed_bin_size<T>() != sysio::abi_variable_size) {
+        if (bin.remaining() < fixed_bin_size<T>())
+            return stream_error::overrun;
+        from_bin(v, bin);
+        return stream_error::no_error;
+    } else if constexpr (std::is_same_v<T, varuint32>) {
+        return varuint_from_bin<uint32_t, 35>(v.value, bin);
+    } else if constexpr (std::is_same_v<T, varint32>) {
+        uint32_t u;
+        if (auto e = varuint_from_bin<uint32_t, 35>(u, bin); e != stream_error::no_error)
+            return e;
+        v.value = (u & 1) ? ((~u) >> 1) | 0x8000'0000 : u >> 1;
+        return stream_error::no_error;
+    } else if constexpr (std::is_same_v<T, bitset>) {
+        uint32_t num_bits;
+        if (auto e = varuint_from_bin<uint32_t, 35>(num_bits, bin); e != stream_error::no_error)
+            return e;
+        // calc_num_blocks wraps to 0 for the last few sizes, which would leave no block for the unused bits
+        if (num_bits > bitset::npos - (bitset::bits_per_block - 1))
+            return stream_error::varuint_too_big;
+        auto num_blocks = bitset::calc_num_blocks(num_bits);
+        if (bin.remaining() < num_blocks)
+            return stream_error::overrun;
+        v.resize(num_bits);
+        for (size_t i = 0; i < num_blocks; ++i)
+            from_bin(v.byte(i), bin);
+        v.zero_unused_bits();
+        return stream_error::no_error;
+    } else if constexpr (std::is_same_v<T, public_key> || std::is_same_v<T, private_key> ||
+                         std::is_same_v<T, signature>) {
+        uint32_t index;
+        if (auto e = varuint_from_bin<uint32_t, 35>(index, bin); e != stream_error::no_error)
+            return e;
+        if (index >= std::variant_size_v<T>)
+            return stream_error::bad_variant_index;
+        // Only the extent is checked here; for all but webauthn that's a single comparison
+        sysio::input_stream data = bin;
+        if (auto e = skip_key_data((T*)nullptr, index, data); e != stream_error::no_error)
+            return e;
+        variant_alternative_from_bin(v, index, bin);
+        return stream_error::no_error;
+    } else {
+        static_assert(sizeof(T*) == 0, "read_bin: unsupported type");
+    }
+}
 
-    size_t pos = 0;
-    for (auto& insertion : state.size_insertions) {
-        bin.insert(bin.end(), out_buf.begin() + pos, out_buf.begin() + insertion.position);
-        sysio::push_varuint32(bin, insertion.size);
-        pos = insertion.position;
+///////////////////////////////////////////////////////////////////////////////
+// json_to_bin
+///////////////////////////////////////////////////////////////////////////////
+
+// Arrays are written behind a varuint size which starts one byte wide and is patched once the array ends. When the
+// element count reaches one which needs another byte (128, 16384, ...), the slot grows by a byte, moving only the
+// elements written so far. Closing an array never moves its body, so enclosing arrays don't move it again either.
+inline void grow_array_size(std::vector<char>& out, size_t pos, uint32_t count) {
+    if (count == 0x80 || count == 0x4000 || count == 0x20'0000 || count == 0x1000'0000)
+        out.insert(out.begin() + pos + 1, char(0));
+}
+
+inline void patch_array_size(std::vector<char>& out, size_t pos, uint32_t size) {
+    char buf[5];
+    sysio::fixed_buf_stream stream(buf, sizeof(buf));
+    sysio::varuint32_to_bin(size, stream);
+    memcpy(out.data() + pos, buf, stream.pos - buf);
+}
+
+// Converts json in place, without copying it. json holds size bytes of json followed by 3 NUL bytes; the parser
+// clobbers it. Writes the binary to dest. Returns false and fills error if json is malformed or doesn't match type;
+// nothing is written to dest in that case.
+template<typename Stream, typename F>
+inline bool json_to_bin_insitu(Stream& dest, const abi_type* type, char* json, size_t size, F&& f,
+                               conversion_scratch& scratch, conversion_error& error) {
+    // Vectors are written to directly; other streams get the finished binary in one piece
+    constexpr bool direct = std::is_same_v<Stream, sysio::vector_stream>;
+    auto& out_buf = scratch.bin;
+    out_buf.clear();
+    sysio::vector_stream buffered(out_buf);
+    sysio::vector_stream& out = [&]() -> sysio::vector_stream& {
+        if constexpr (direct)
+            return dest;
+        else
+            return buffered;
+    }();
+    size_t start = out.data.size();
+    json_to_bin_state state(json, size, out, scratch);
+
+    auto fail = [&](conversion_error_kind kind, std::string_view message) {
+        out.data.resize(start);
+        error.kind = kind;
+        error.offset = std::min(state.tell(), size);
+        error.path = conversion_path(type, state.stack, [](auto& entry, auto& fields) {
+            return entry.position >= 1 ? &fields[entry.variant_type_index] : nullptr;
+        });
+        error.message = message;
+        return false;
+    };
+    // from_json reports errors by throwing
+    try {
+        if (type->program.empty()) {
+            type->ser->json_to_bin(state, true, type, true);
+            while(!state.stack.empty()) {
+                f();
+                auto entry = state.stack.back();
+                auto* type = entry.type;
+                if (state.stack.size() > max_stack_size)
+                    return fail(conversion_error_kind::recursion_limit,
+                                conversion_error_message(conversion_error_kind::recursion_limit));
+                type->ser->json_to_bin(state, entry.allow_extensions, type, false);
+            }
+        } else {
+            sysio::abi_op root{sysio::abi_opcode::call, 0, type};
+            json_to_bin_start(state, &root, true);
+            while (!state.stack.empty()) {
+                f();
+                if (state.stack.size() > max_stack_size)
+                    return fail(conversion_error_kind::recursion_limit,
+                                conversion_error_message(conversion_error_kind::recursion_limit));
+                json_to_bin_step(state);
+            }
+        }
+        sysio::check(state.complete(),
+            sysio::convert_json_error(sysio::from_json_error::expected_end));
+    } catch (std::exception& e) {
+        return fail(conversion_error_kind::json, e.what());
     }
-    bin.insert(bin.end(), out_buf.begin() + pos, out_buf.end());
+
+    if constexpr (!direct)
+        dest.write(out_buf.data(), out_buf.size());
+    return true;
+}
+
+// Writes the binary to dest. Returns false and fills error if json is malformed or doesn't match type; nothing is
+// written to dest in that case.
+template<typename Stream, typename F>
+inline bool json_to_bin(Stream& dest, const abi_type* type, std::string_view json, F&& f, conversion_scratch& scratch,
+                        conversion_error& error) {
+    auto& mutable_json = scratch.json;
+    mutable_json.assign(json.begin(), json.end());
+    mutable_json.insert(mutable_json.end(), 3, 0);
+    return json_to_bin_insitu(dest, type, mutable_json.data(), json.size(), f, scratch, error);
+}
+
+template<typename Stream, typename F>
+inline void json_to_bin(Stream& dest, const abi_type* type, std::string_view json, F&& f) {
+    conversion_scratch scratch;
+    conversion_error error;
+    sysio::check(json_to_bin(dest, type, json, f, scratch, error), std::move(error.message));
+}
+
+template<typename F>
+inline bool json_to_bin(std::vector<char>& bin, const abi_type* type, std::string_view json, F&& f,
+                        conversion_scratch& scratch, conversion_error& error) {
+    sysio::vector_stream out{bin};
+    return json_to_bin(out, type, json, f, scratch, error);
+}
+
+template<typename F>
+inline bool json_to_bin_insitu(std::vector<char>& bin, const abi_type* type, char* json, size_t size, F&& f,
+                               conversion_scratch& scratch, conversion_error& error) {
+    sysio::vector_stream out{bin};
+    return json_to_bin_insitu(out, type, json, size, f, scratch, error);
+}
+
+template<typename F>
+inline void json_to_bin(std::vector<char>& bin, const abi_type* type, std::string_view json, F&& f) {
+    sysio::vector_stream out{bin};
+    json_to_bin(out, type, json, f);
 }
 
 inline void json_to_bin(pseudo_object*, json_to_bin_state& state, bool allow_extensions,
@@ -857,20 +1297,20 @@ inline void json_to_bin(pseudo_array*, json_to_bin_state& state, bool, const abi
         if (trace_json_to_bin)
             printf("%*s[\n", int(state.stack.size() * 4), "");
         state.stack.push_back({type, false});
-        state.stack.back().size_insertion_index = state.size_insertions.size();
-        // FIXME: add Stream::tellp or similar.
-        state.size_insertions.push_back({state.writer.data.size()});
+        state.stack.back().size_position = state.writer.data.size();
+        state.writer.write(char(0));
         return;
     }
     auto& stack_entry = state.stack.back();
     if (state.get_end_array_pred()) {
         if (trace_json_to_bin)
             printf("%*s]\n", int((state.stack.size() - 1) * 4), "");
-        state.size_insertions[stack_entry.size_insertion_index].size = stack_entry.position + 1;
+        patch_array_size(state.writer.data, stack_entry.size_position, stack_entry.position + 1);
         state.stack.pop_back();
         return;
     }
     ++stack_entry.position;
+    grow_array_size(state.writer.data, stack_entry.size_position, stack_entry.position + 1);
     if (trace_json_to_bin)
         printf("%*sitem\n", int(state.stack.size() * 4), "");
     const abi_type* t = type->array_of();
@@ -926,11 +1366,10 @@ inline void json_to_bin(pseudo_variant*, json_to_bin_state& state, bool allow_ex
         auto typeName = state.get_string();
         if (trace_json_to_bin)
             printf("%*stype: %.*s\n", int(state.stack.size() * 4), "", (int)typeName.size(), typeName.data());
-        auto it = std::find_if(fields.begin(), fields.end(),
-                               [&](auto& field) { return field.name == typeName; });
-        sysio::check(it != fields.end(),
+        auto index = stack_entry.type->find_alternative(typeName);
+        sysio::check(index >= 0,
             sysio::convert_json_error(sysio::from_json_error::invalid_type_for_variant));
-        stack_entry.variant_type_index = it - fields.begin();
+        stack_entry.variant_type_index = index;
         sysio::varuint32_to_bin(stack_entry.variant_type_index, state.writer);
     } else if (stack_entry.position == 1) {
         auto& field = fields[stack_entry.variant_type_index];
@@ -944,29 +1383,79 @@ inline void json_to_bin(pseudo_variant*, json_to_bin_state& state, bool allow_ex
 // bin_to_json
 ///////////////////////////////////////////////////////////////////////////////
 
+// Appends the json to writer. Returns false and fills error if bin is malformed; writer then holds partial json. Never
+// throws on malformed input.
+template<typename Stream, typename F>
+inline bool bin_to_json(sysio::input_stream& bin, const abi_type* type, Stream& writer, F&& f,
+                        conversion_scratch& scratch, conversion_error& error) {
+    basic_bin_to_json_state<Stream> state{bin, writer, scratch};
+    if (type->program.empty()) {
+        type->ser->bin_to_json(state, true, type, true);
+        while (state.error == conversion_error_kind::none && !state.stack.empty()) {
+            f();
+            auto& entry = state.stack.back();
+            entry.type->ser->bin_to_json(state, entry.allow_extensions, entry.type, false);
+            if (state.stack.size() > max_stack_size)
+                state.error = conversion_error_kind::recursion_limit;
+        }
+    } else {
+        sysio::abi_op root{sysio::abi_opcode::call, 0, type};
+        bin_to_json_start(state, &root, true);
+        while (state.error == conversion_error_kind::none && !state.stack.empty()) {
+            f();
+            bin_to_json_step(state);
+            if (state.stack.size() > max_stack_size)
+                state.error = conversion_error_kind::recursion_limit;
+        }
+    }
+    if (state.error == conversion_error_kind::none)
+        return true;
+    error.kind = state.error;
+    error.offset = bin.pos - state.begin;
+    error.path = conversion_path(type, state.stack, [](auto& entry, auto& fields) {
+        return entry.variant_index < fields.size() ? &fields[entry.variant_index] : nullptr;
+    });
+    error.message = conversion_error_message(state.error);
+    return false;
+}
+
+template<typename Stream, typename F>
+inline void bin_to_json(sysio::input_stream& bin, const abi_type* type, Stream& writer, F&& f) {
+    conversion_scratch scratch;
+    conversion_error error;
+    sysio::check(bin_to_json(bin, type, writer, f, scratch, error), std::move(error.message));
+}
+
 template<typename F>
-inline void bin_to_json(sysio::input_stream& bin, const abi_type* type, std::string& dest, F&& f) {
+inline bool bin_to_json(sysio::input_stream& bin, const abi_type* type, std::string& dest, F&& f,
+                        conversion_scratch& scratch, conversion_error& error) {
     // FIXME: Write directly to the string instead of creating an additional buffer
-    std::vector<char> buffer;
+    auto& buffer = scratch.text;
+    buffer.clear();
     sysio::vector_stream writer{buffer};
-    bin_to_json_state state{bin, writer};
-    type->ser->bin_to_json(state, true, type, true);
-    while (!state.stack.empty()) {
-        f();
-        auto& entry = state.stack.back();
-        entry.type->ser->bin_to_json(state, entry.allow_extensions, entry.type, false);
-        sysio::check(state.stack.size() <= max_stack_size,
-            sysio::convert_abi_error(sysio::abi_error::recursion_limit_reached));
-    }
-    dest = std::string_view(writer.data.data(), writer.data.size());
+    if (!bin_to_json(bin, type, writer, f, scratch, error))
+        return false;
+    dest.assign(buffer.data(), buffer.size());
+    return true;
 }
 
-inline void bin_to_json(bin_to_json_state& state, bool allow_extensions, const abi_type* type, bool start) {
+template<typename F>
+inline void bin_to_json(sysio::input_stream& bin, const abi_type* type, std::string& dest, F&& f) {
+    conversion_scratch scratch;
+    conversion_error error;
+    sysio::check(bin_to_json(bin, type, dest, f, scratch, error), std::move(error.message));
+}
+
+template <typename State>
+inline void bin_to_json(State& state, bool allow_extensions, const abi_type* type, bool start) {
     type->ser->bin_to_json(state, allow_extensions, type, start);
 }
 
-inline void bin_to_json(pseudo_optional*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+inline void bin_to_json(pseudo_optional*, State& state, bool allow_extensions,
                                        const abi_type* type, bool) {
+    if (state.bin.pos == state.bin.end)
+        return state.fail(sysio::stream_error::overrun);
     bool present;
     from_bin(present, state.bin);
     if (present)
@@ -974,12 +1463,14 @@ inline void bin_to_json(pseudo_optional*, bin_to_json_state& state, bool allow_e
     state.writer.write("null", 4);
 }
 
-inline void bin_to_json(pseudo_extension*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+inline void bin_to_json(pseudo_extension*, State& state, bool allow_extensions,
                                        const abi_type* type, bool) {
     bin_to_json(state, allow_extensions, type->extension_of(), true);
 }
 
-inline void bin_to_json(pseudo_object*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+inline void bin_to_json(pseudo_object*, State& state, bool allow_extensions,
                                        const abi_type* type, bool start) {
     if (start) {
         if (trace_bin_to_json)
@@ -999,9 +1490,8 @@ inline void bin_to_json(pseudo_object*, bin_to_json_state& state, bool allow_ext
             state.skipped_extension = true;
             return;
         }
-        if(stack_entry.position != 0) { state.writer.write(','); };
-        to_json(field.name, state.writer);
-        state.writer.write(':');
+        auto key = stack_entry.position != 0 ? std::string_view{ field.json_key } : field.first_json_key();
+        state.writer.write(key.data(), key.size());
         bin_to_json(state, allow_extensions && &field == &fields.back(), field.type, true);
     } else {
         if (trace_bin_to_json)
@@ -1011,11 +1501,14 @@ inline void bin_to_json(pseudo_object*, bin_to_json_state& state, bool allow_ext
     }
 }
 
-inline void bin_to_json(pseudo_array*, bin_to_json_state& state, bool, const abi_type* type,
+template <typename State>
+inline void bin_to_json(pseudo_array*, State& state, bool, const abi_type* type,
                                          bool start) {
     if (start) {
         state.stack.push_back({type, false});
-        varuint32_from_bin(state.stack.back().array_size, state.bin);
+        if (auto e = varuint_from_bin<uint32_t, 35>(state.stack.back().array_size, state.bin);
+            e != sysio::stream_error::no_error)
+            return state.fail(e);
         if (trace_bin_to_json)
             printf("%*s[ %d items\n", int(state.stack.size() * 4), "", int(state.stack.back().array_size));
         return state.writer.write('[');
@@ -1035,7 +1528,8 @@ inline void bin_to_json(pseudo_array*, bin_to_json_state& state, bool, const abi
     }
 }
 
-inline void bin_to_json(pseudo_fixed_array*, bin_to_json_state& state, bool, const abi_type* type,
+template <typename State>
+inline void bin_to_json(pseudo_fixed_array*, State& state, bool, const abi_type* type,
                         bool start) {
     const abi_type::fixed_array* fa = type->as_fixed_array();
     if (start) {
@@ -1060,7 +1554,8 @@ inline void bin_to_json(pseudo_fixed_array*, bin_to_json_state& state, bool, con
 }
 
 
-inline void bin_to_json(pseudo_variant*, bin_to_json_state& state, bool allow_extensions,
+template <typename State>
+inline void bin_to_json(pseudo_variant*, State& state, bool allow_extensions,
                                          const abi_type* type, bool start) {
     if (start) {
         state.stack.push_back({type, allow_extensions});
@@ -1071,11 +1566,18 @@ inline void bin_to_json(pseudo_variant*, bin_to_json_state& state, bool allow_ex
     auto& stack_entry = state.stack.back();
     if (++stack_entry.position == 0) {
         uint32_t index;
-        varuint32_from_bin(index, state.bin);
+        auto pos = state.bin.pos;
+        if (auto e = varuint_from_bin<uint32_t, 35>(index, state.bin); e != sysio::stream_error::no_error)
+            return state.fail(e);
         const std::vector<sysio::abi_field>& fields = *stack_entry.type->as_variant();
-        sysio::check(index < fields.size(), sysio::convert_stream_error(sysio::stream_error::bad_variant_index));
+        if (index >= fields.size()) {
+            state.bin.pos = pos;
+            return state.fail(sysio::stream_error::bad_variant_index);
+        }
+        stack_entry.variant_index = index;
         auto& f = fields[index];
-        to_json(f.name, state.writer);
+        auto name = f.quoted_json_name();
+        state.writer.write(name.data(), name.size());
         state.writer.write(',');
         // FIXME: allow_extensions should be stack_entry.allow_extensions, so why are we combining them?
         bin_to_json(state, allow_extensions && stack_entry.allow_extensions, f.type, true);
@@ -1087,12 +1589,749 @@ inline void bin_to_json(pseudo_variant*, bin_to_json_state& state, bool allow_ex
     }
 }
 
-template <typename T>
-auto bin_to_json(T* t, bin_to_json_state& state, bool, const abi_type*, bool start)
+// Strings are written straight from the input
+template <typename State>
+void bin_to_json(std::string*, State& state, bool, const abi_type*, bool) {
+    auto pos = state.bin.pos;
+    uint32_t size;
+    if (auto e = varuint_from_bin<uint32_t, 35>(size, state.bin); e != sysio::stream_error::no_error)
+        return state.fail(e);
+    if (size > state.bin.remaining()) {
+        state.bin.pos = pos;
+        return state.fail(sysio::stream_error::overrun);
+    }
+    std::string_view v{state.bin.pos, size};
+    state.bin.pos += size;
+    return to_json(v, state.writer);
+}
+
+// Errors are reported at the start of the value
+template <typename T, typename State>
+auto bin_to_json(T* t, State& state, bool, const abi_type*, bool start)
     -> std::void_t<decltype(from_bin(*t, state.bin)), decltype(to_json(*t, state.writer))> {
+    auto pos = state.bin.pos;
     T v;
-    from_bin(v, state.bin);
+    if (auto e = read_bin(v, state.bin); e != sysio::stream_error::no_error) {
+        state.bin.pos = pos;
+        return state.fail(e);
+    }
     return to_json(v, state.writer);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// programs
+///////////////////////////////////////////////////////////////////////////////
+
+// Converters for basic_abi_types, indexed by the arg of builtin ops
+template <typename State, typename... T>
+constexpr std::array<void (*)(State&), sizeof...(T)> make_json_to_bin_builtins(std::tuple<T...>*) {
+    return {[](State& state) { json_to_bin((T*)nullptr, state, false, nullptr, true); }...};
+}
+
+template <typename State, typename... T>
+constexpr std::array<void (*)(State&), sizeof...(T)> make_bin_to_json_builtins(std::tuple<T...>*) {
+    return {[](State& state) { bin_to_json((T*)nullptr, state, false, nullptr, true); }...};
+}
+
+template <typename State>
+inline constexpr auto json_to_bin_builtins = make_json_to_bin_builtins<State>((sysio::basic_abi_types*)nullptr);
+
+template <typename State>
+inline constexpr auto bin_to_json_builtins = make_bin_to_json_builtins<State>((sysio::basic_abi_types*)nullptr);
+
+// True if op converts an extension, which an object may leave out at the end of its input
+inline bool is_extension(const sysio::abi_op* op) {
+    return op->code == sysio::abi_opcode::call && op->type->program.front().code == sysio::abi_opcode::extension;
+}
+
+// Converts a value with op. Builtins, optionals and extensions are handled here; objects, arrays and variants push a
+// stack entry which json_to_bin_step continues.
+inline void json_to_bin_start(json_to_bin_state& state, const sysio::abi_op* op, bool allow_extensions) {
+    using sysio::abi_opcode;
+    const abi_type* type = nullptr;
+    for (;;) {
+        switch (op->code) {
+        case abi_opcode::builtin: return json_to_bin_builtins<json_to_bin_state>[op->arg](state);
+        case abi_opcode::call:
+            type = op->type;
+            op = type->program.data();
+            break;
+        case abi_opcode::optional:
+            if (state.get_null_pred())
+                return state.writer.write(char(0));
+            state.writer.write(char(1));
+            ++op;
+            break;
+        case abi_opcode::extension: ++op; break;
+        case abi_opcode::object:
+            state.get_start_object();
+            state.stack.push_back({type, allow_extensions});
+            state.stack.back().program = op;
+            return json_to_bin_step(state);
+        case abi_opcode::array:
+            state.get_start_array();
+            state.stack.push_back({type, false});
+            state.stack.back().program = op;
+            state.stack.back().size_position = state.writer.data.size();
+            state.writer.write(char(0));
+            return;
+        case abi_opcode::fixed_array:
+            state.get_start_array();
+            state.stack.push_back({type, false});
+            state.stack.back().program = op;
+            return;
+        case abi_opcode::variant:
+            state.get_start_array();
+            state.stack.push_back({type, allow_extensions});
+            state.stack.back().program = op;
+            return;
+        }
+    }
+}
+
+inline void json_to_bin_step(json_to_bin_state& state) {
+    using sysio::abi_opcode;
+    auto& stack_entry = state.stack.back();
+    const sysio::abi_op* op = stack_entry.program;
+    switch (op->code) {
+    case abi_opcode::object: {
+        const std::vector<sysio::abi_field>& fields = *op->fields;
+        int size = op->arg;
+        // Builtin fields are converted here; only fields which push an entry return to the driver
+        for (;;) {
+            if (state.get_end_object_pred()) {
+                if (stack_entry.position + 1 != size) {
+                    if (!stack_entry.allow_extensions || !is_extension(op + 2 + stack_entry.position)) {
+                        stack_entry.position = -1;
+                        sysio::check(false, sysio::convert_json_error(sysio::from_json_error::expected_field));
+                    }
+                    ++stack_entry.position;
+                    state.skipped_extension = true;
+                }
+                state.stack.pop_back();
+                return;
+            }
+            if (auto key = state.maybe_get_key()) {
+                sysio::check(!(++stack_entry.position >= size || state.skipped_extension),
+                             sysio::convert_json_error(sysio::from_json_error::unexpected_field));
+                if (*key != fields[stack_entry.position].name) {
+                    stack_entry.position = -1;
+                    sysio::check(false, sysio::convert_json_error(sysio::from_json_error::expected_field));
+                }
+                auto* field_op = op + 1 + stack_entry.position;
+                if (field_op->code != abi_opcode::builtin)
+                    return;
+                json_to_bin_builtins<json_to_bin_state>[field_op->arg](state);
+                continue;
+            }
+            return json_to_bin_start(state, op + 1 + stack_entry.position,
+                                     stack_entry.allow_extensions && stack_entry.position + 1 == size);
+        }
+    }
+    case abi_opcode::array:
+        for (;;) {
+            if (state.get_end_array_pred()) {
+                patch_array_size(state.writer.data, stack_entry.size_position, stack_entry.position + 1);
+                state.stack.pop_back();
+                return;
+            }
+            ++stack_entry.position;
+            grow_array_size(state.writer.data, stack_entry.size_position, stack_entry.position + 1);
+            if (op[1].code != abi_opcode::builtin)
+                return json_to_bin_start(state, op + 1, false);
+            json_to_bin_builtins<json_to_bin_state>[op[1].arg](state);
+        }
+    case abi_opcode::fixed_array:
+        if (state.get_end_array_pred()) {
+            sysio::check(stack_entry.position + 1 == (int)op->arg, "incorrect size for fixed array");
+            state.stack.pop_back();
+            return;
+        }
+        ++stack_entry.position;
+        return json_to_bin_start(state, op + 1, false);
+    case abi_opcode::variant: {
+        ++stack_entry.position;
+        if (state.get_end_array_pred()) {
+            sysio::check(stack_entry.position == 2,
+                         sysio::convert_json_error(sysio::from_json_error::expected_variant));
+            state.stack.pop_back();
+            return;
+        }
+        if (stack_entry.position == 0) {
+            auto index = op->type->find_alternative(state.get_string());
+            sysio::check(index >= 0, sysio::convert_json_error(sysio::from_json_error::invalid_type_for_variant));
+            stack_entry.variant_type_index = index;
+            sysio::varuint32_to_bin(stack_entry.variant_type_index, state.writer);
+        } else if (stack_entry.position == 1) {
+            return json_to_bin_start(state, op + 1 + stack_entry.variant_type_index, stack_entry.allow_extensions);
+        } else {
+            sysio::check(false, sysio::convert_json_error(sysio::from_json_error::expected_variant));
+        }
+        return;
+    }
+    default: return;
+    }
+}
+
+// Converts a value with op. Builtins, optionals and extensions are handled here; objects, arrays and variants push a
+// stack entry which bin_to_json_step continues.
+template <typename State>
+void bin_to_json_start(State& state, const sysio::abi_op* op, bool allow_extensions) {
+    using sysio::abi_opcode;
+    const abi_type* type = nullptr;
+    for (;;) {
+        switch (op->code) {
+        case abi_opcode::builtin: return bin_to_json_builtins<State>[op->arg](state);
+        case abi_opcode::call:
+            type = op->type;
+            op = type->program.data();
+            break;
+        case abi_opcode::optional: {
+            if (state.bin.pos == state.bin.end)
+                return state.fail(sysio::stream_error::overrun);
+            bool present;
+            from_bin(present, state.bin);
+            if (!present)
+                return state.writer.write("null", 4);
+            ++op;
+            break;
+        }
+        case abi_opcode::extension: ++op; break;
+        case abi_opcode::object:
+            state.stack.push_back({type, allow_extensions});
+            state.stack.back().program = op;
+            return state.writer.write('{');
+        case abi_opcode::array:
+            state.stack.push_back({type, false});
+            state.stack.back().program = op;
+            if (auto e = varuint_from_bin<uint32_t, 35>(state.stack.back().array_size, state.bin);
+                e != sysio::stream_error::no_error)
+                return state.fail(e);
+            return state.writer.write('[');
+        case abi_opcode::fixed_array:
+        case abi_opcode::variant:
+            state.stack.push_back({type, op->code == abi_opcode::variant && allow_extensions});
+            state.stack.back().program = op;
+            return state.writer.write('[');
+        }
+    }
+}
+
+template <typename State>
+void bin_to_json_step(State& state) {
+    using sysio::abi_opcode;
+    auto& stack_entry = state.stack.back();
+    const sysio::abi_op* op = stack_entry.program;
+    switch (op->code) {
+    case abi_opcode::object:
+        // Builtin fields are converted here; only fields which push an entry return to the driver
+        while (++stack_entry.position < (int)op->arg) {
+            auto& field = (*op->fields)[stack_entry.position];
+            auto* field_op = op + 1 + stack_entry.position;
+            if (state.bin.pos == state.bin.end && stack_entry.allow_extensions && is_extension(field_op)) {
+                state.skipped_extension = true;
+                continue;
+            }
+            auto key = stack_entry.position != 0 ? std::string_view{ field.json_key } : field.first_json_key();
+            state.writer.write(key.data(), key.size());
+            if (field_op->code != abi_opcode::builtin)
+                return bin_to_json_start(state, field_op,
+                                         stack_entry.allow_extensions && stack_entry.position + 1 == (int)op->arg);
+            bin_to_json_builtins<State>[field_op->arg](state);
+            if (state.error != conversion_error_kind::none)
+                return;
+        }
+        state.stack.pop_back();
+        return state.writer.write('}');
+    case abi_opcode::array:
+    case abi_opcode::fixed_array: {
+        int size = op->code == abi_opcode::array ? (int)stack_entry.array_size : (int)op->arg;
+        while (++stack_entry.position < size) {
+            if (stack_entry.position != 0)
+                state.writer.write(',');
+            if (op[1].code != abi_opcode::builtin)
+                return bin_to_json_start(state, op + 1, false);
+            bin_to_json_builtins<State>[op[1].arg](state);
+            if (state.error != conversion_error_kind::none)
+                return;
+        }
+        state.stack.pop_back();
+        return state.writer.write(']');
+    }
+    case abi_opcode::variant:
+        if (++stack_entry.position == 0) {
+            uint32_t index;
+            auto pos = state.bin.pos;
+            if (auto e = varuint_from_bin<uint32_t, 35>(index, state.bin); e != sysio::stream_error::no_error)
+                return state.fail(e);
+            if (index >= op->arg) {
+                state.bin.pos = pos;
+                return state.fail(sysio::stream_error::bad_variant_index);
+            }
+            stack_entry.variant_index = index;
+            auto name = (*op->fields)[index].quoted_json_name();
+            state.writer.write(name.data(), name.size());
+            state.writer.write(',');
+            return bin_to_json_start(state, op + 1 + index, stack_entry.allow_extensions);
+        }
+        state.stack.pop_back();
+        return state.writer.write(']');
+    default: return;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// json_to_bin (reorderable)
+///////////////////////////////////////////////////////////////////////////////
+
+// Thrown for the rare documents only the jvalue tree converts the way json_to_bin_reorderable always has: a repeated
+// key replaces the earlier value, and struct fields which share a name share the value.
+struct reorder_fallback {};
+
+inline void skip_json_value(sysio::json_token_stream& state) {
+    using sysio::json_token_type;
+    int depth = 0;
+    do {
+        switch (state.peek_token().get().type) {
+        case json_token_type::type_start_object:
+        case json_token_type::type_start_array: ++depth; break;
+        case json_token_type::type_end_object:
+        case json_token_type::type_end_array: --depth; break;
+        default: break;
+        }
+        state.eat_token();
+    } while (depth > 0);
+}
+
+template <typename F>
+void json_to_bin_reorderable(json_to_bin_reorder_state& state, const abi_type* type, bool allow_extensions, F& f);
+
+// Fields received in order are written straight to the output. A field received ahead of its turn is converted into a
+// buffer of its own, which is copied to the output once the fields before it are done.
+template <typename F>
+void json_to_bin_reorderable(json_to_bin_reorder_state& state, const abi_type* type,
+                             const std::vector<sysio::abi_field>& fields, bool allow_extensions, F& f) {
+    state.get_start_object();
+    state.stack.push_back({type, allow_extensions});
+    size_t depth = state.stack.size() - 1;
+    sysio::check(state.stack.size() <= max_stack_size,
+                 conversion_error_message(conversion_error_kind::recursion_limit));
+    int size = fields.size();
+    auto& buffers = state.scratch.field_buffers;
+    auto& free_buffers = state.scratch.free_field_buffers;
+    auto& slots = state.scratch.field_slots;
+    size_t base = slots.size();
+    slots.resize(base + size, 0);
+    auto* out = state.writer.data;
+    int next = 0;
+    auto append = [&](uint32_t slot) {
+        auto& buffer = buffers[slot - 1];
+        out->insert(out->end(), buffer.begin(), buffer.end());
+        free_buffers.push_back(slot - 1);
+        slots[base + next] = 0;
+    };
+
+    while (!state.get_end_object_pred()) {
+        auto key = state.get_key();
+        int i = next < size && key == fields[next].name ? next : type->find_field(key);
+        if (i < 0) {
+            // Unknown fields are ignored
+            skip_json_value(state);
+            continue;
+        }
+        if (i < next || slots[base + i])
+            throw reorder_fallback{};
+        state.stack[depth].position = i;
+        bool last = allow_extensions && i + 1 == size;
+        if (i == next) {
+            json_to_bin_reorderable(state, fields[i].type, last, f);
+            for (++next; next < size && slots[base + next]; ++next)
+                append(slots[base + next]);
+        } else {
+            if (free_buffers.empty()) {
+                free_buffers.push_back(buffers.size());
+                buffers.emplace_back();
+            }
+            auto buffer = free_buffers.back();
+            free_buffers.pop_back();
+            buffers[buffer].clear();
+            state.writer.data = &buffers[buffer];
+            json_to_bin_reorderable(state, fields[i].type, last, f);
+            state.writer.data = out;
+            slots[base + i] = buffer + 1;
+        }
+    }
+
+    // Only extensions may be missing, and only at the end
+    bool skipped_extension = false;
+    for (; next < size; ++next) {
+        if (auto slot = slots[base + next]) {
+            state.stack[depth].position = next;
+            sysio::check(!skipped_extension, sysio::convert_json_error(sysio::from_json_error::unexpected_field));
+            append(slot);
+            continue;
+        }
+        for (int i = 0; i < next; ++i)
+            if (fields[i].name == fields[next].name)
+                throw reorder_fallback{};
+        if (!fields[next].type->extension_of() || !allow_extensions) {
+            state.stack[depth].position = -1;
+            sysio::check(false, sysio::convert_json_error(sysio::from_json_error::expected_field));
+        }
+        skipped_extension = true;
+    }
+    slots.resize(base);
+    state.stack.pop_back();
+}
+
+template <typename F>
+void json_to_bin_reorderable(json_to_bin_reorder_state& state, const abi_type* type, bool allow_extensions, F& f) {
+    using sysio::abi_type;
+    f();
+    while (auto* a = std::get_if<abi_type::alias>(&type->_data))
+        type = a->type;
+    if (std::holds_alternative<abi_type::builtin>(type->_data)) {
+        return json_to_bin_builtins<json_to_bin_reorder_state>[type->program.front().arg](state);
+    } else if (auto* o = std::get_if<abi_type::optional>(&type->_data)) {
+        if (state.get_null_pred())
+            return state.writer.write(char(0));
+        state.writer.write(char(1));
+        return json_to_bin_reorderable(state, o->type, allow_extensions, f);
+    } else if (auto* e = std::get_if<abi_type::extension>(&type->_data)) {
+        return json_to_bin_reorderable(state, e->type, allow_extensions, f);
+    } else if (auto* s = std::get_if<abi_type::struct_>(&type->_data)) {
+        return json_to_bin_reorderable(state, type, s->fields, allow_extensions, f);
+    }
+
+    state.get_start_array();
+    state.stack.push_back({type, allow_extensions});
+    size_t depth = state.stack.size() - 1;
+    sysio::check(state.stack.size() <= max_stack_size,
+                 conversion_error_message(conversion_error_kind::recursion_limit));
+    if (auto* v = std::get_if<abi_type::variant>(&type->_data)) {
+        auto index = type->find_alternative(state.get_string());
+        sysio::check(index >= 0, sysio::convert_json_error(sysio::from_json_error::invalid_type_for_variant));
+        state.stack[depth].position = 1;
+        state.stack[depth].variant_type_index = index;
+        sysio::varuint32_to_bin(index, state.writer);
+        json_to_bin_reorderable(state, (*v)[index].type, allow_extensions, f);
+        sysio::check(state.get_end_array_pred(), sysio::convert_json_error(sysio::from_json_error::expected_variant));
+    } else {
+        auto* element = type->array_of();
+        auto* fixed = type->as_fixed_array();
+        if (fixed)
+            element = fixed->type;
+        auto& out = *state.writer.data;
+        size_t pos = out.size();
+        if (!fixed)
+            out.push_back(0);
+        uint32_t size = 0;
+        while (!state.get_end_array_pred()) {
+            state.stack[depth].position = size++;
+            if (!fixed)
+                grow_array_size(out, pos, size);
+            json_to_bin_reorderable(state, element, false, f);
+        }
+        if (fixed)
+            sysio::check(size == fixed->size, "incorrect size for fixed array");
+        else
+            patch_array_size(out, pos, size);
+    }
+    state.stack.pop_back();
+}
+
+// Converts json whose object keys may come in any order. Appends the binary to bin. Returns false and fills error if
+// json is malformed or doesn't match type; bin is unchanged in that case.
+template <typename F>
+inline bool json_to_bin_reorderable(std::vector<char>& bin, const abi_type* type, std::string_view json, F&& f,
+                                    conversion_scratch& scratch, conversion_error& error) {
+    auto& mutable_json = scratch.json;
+    mutable_json.assign(json.begin(), json.end());
+    mutable_json.insert(mutable_json.end(), 3, 0);
+    size_t size = bin.size();
+    json_to_bin_reorder_state state(mutable_json.data(), json.size(), bin, scratch);
+    try {
+        json_to_bin_reorderable(state, type, true, f);
+        sysio::check(state.complete(), sysio::convert_json_error(sysio::from_json_error::expected_end));
+        return true;
+    } catch (reorder_fallback&) {
+        bin.resize(size);
+    } catch (std::exception& e) {
+        bin.resize(size);
+        error.kind = state.stack.size() > max_stack_size ? conversion_error_kind::recursion_limit
+                                                          : conversion_error_kind::json;
+        error.offset = std::min(state.tell(), json.size());
+        error.path = conversion_path(type, state.stack, [](auto& entry, auto& fields) {
+            return entry.position >= 1 ? &fields[entry.variant_type_index] : nullptr;
+        });
+        error.message = e.what();
+        return false;
+    }
+    try {
+        jvalue value;
+        json_to_jvalue(value, json, f);
+        json_to_bin(bin, type, value, f);
+        return true;
+    } catch (std::exception& e) {
+        bin.resize(size);
+        error.kind = conversion_error_kind::json;
+        error.offset = 0;
+        error.path = type->name;
+        error.message = e.what();
+        return false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// skipping values
+///////////////////////////////////////////////////////////////////////////////
+
+// Skippers for basic_abi_types, indexed by the arg of builtin ops. bin is unchanged on error.
+template <typename... T>
+constexpr std::array<sysio::stream_error (*)(sysio::input_stream&), sizeof...(T)>
+make_skip_builtins(std::tuple<T...>*) {
+    return {[](sysio::input_stream& bin) {
+        auto in = bin;
+        auto e = skip_bin((T*)nullptr, in);
+        if (e == sysio::stream_error::no_error)
+            bin = in;
+        return e;
+    }...};
+}
+
+inline constexpr auto skip_builtins = make_skip_builtins((sysio::basic_abi_types*)nullptr);
+
+template <typename... T>
+constexpr std::array<uint32_t, sizeof...(T)> make_builtin_fixed_sizes(std::tuple<T...>*) {
+    return {fixed_bin_size<T>()...};
+}
+
+inline constexpr auto builtin_fixed_sizes = make_builtin_fixed_sizes((sysio::basic_abi_types*)nullptr);
+
+// Binary size of every value op converts, or sysio::abi_variable_size
+inline uint32_t fixed_bin_size(const sysio::abi_op* op) {
+    if (op->code == sysio::abi_opcode::builtin)
+        return builtin_fixed_sizes[op->arg];
+    return op->type->fixed_size;
+}
+
+// Skips a value of type the way bin_to_json would read it, without converting it. Fixed-size values and arrays of
+// fixed-size elements are skipped in constant time. On error, bin is where the malformed value starts.
+inline conversion_error_kind skip_bin(const abi_type* type, sysio::input_stream& bin, conversion_scratch& scratch,
+                                      bool allow_extensions = true) {
+    using sysio::abi_opcode;
+    using sysio::stream_error;
+    auto fail = [](stream_error e) { return to_conversion_error(e); };
+    if (type->program.empty()) {
+        // Types without a program are only skipped by converting them
+        auto& buffer = scratch.text;
+        buffer.clear();
+        sysio::vector_stream writer{buffer};
+        bin_to_json_state state{bin, writer, scratch};
+        type->ser->bin_to_json(state, allow_extensions, type, true);
+        while (state.error == conversion_error_kind::none && !state.stack.empty()) {
+            auto& entry = state.stack.back();
+            entry.type->ser->bin_to_json(state, entry.allow_extensions, entry.type, false);
+            if (state.stack.size() > max_stack_size)
+                state.error = conversion_error_kind::recursion_limit;
+        }
+        return state.error;
+    }
+
+    auto& stack = scratch.bin_to_json_stack;
+    stack.clear();
+    sysio::abi_op root{abi_opcode::call, 0, type};
+    const sysio::abi_op* op = &root;
+    for (;;) {
+        // Skip the value op describes, or push an entry for its elements
+        for (const abi_type* t = nullptr; op;) {
+            switch (op->code) {
+            case abi_opcode::builtin:
+                if (auto e = skip_builtins[op->arg](bin); e != stream_error::no_error)
+                    return fail(e);
+                op = nullptr;
+                break;
+            case abi_opcode::call:
+                t = op->type;
+                if (t->fixed_size != sysio::abi_variable_size) {
+                    if (auto e = skip_bin(bin, t->fixed_size); e != stream_error::no_error)
+                        return fail(e);
+                    op = nullptr;
+                    break;
+                }
+                op = t->program.data();
+                break;
+            case abi_opcode::optional: {
+                if (bin.pos == bin.end)
+                    return fail(stream_error::overrun);
+                bool present;
+                from_bin(present, bin);
+                op = present ? op + 1 : nullptr;
+                break;
+            }
+            case abi_opcode::extension: ++op; break;
+            case abi_opcode::array: {
+                uint32_t size;
+                if (auto e = varuint_from_bin<uint32_t, 35>(size, bin); e != stream_error::no_error)
+                    return fail(e);
+                if (op->arg != sysio::abi_variable_size) {
+                    if (auto e = skip_bin(bin, uint64_t(size) * op->arg); e != stream_error::no_error)
+                        return fail(e);
+                    op = nullptr;
+                    break;
+                }
+                stack.push_back({t, false});
+                stack.back().program = op;
+                stack.back().array_size = size;
+                op = nullptr;
+                break;
+            }
+            case abi_opcode::fixed_array:
+            case abi_opcode::object:
+                stack.push_back({t, op->code == abi_opcode::object && allow_extensions});
+                stack.back().program = op;
+                op = nullptr;
+                break;
+            case abi_opcode::variant: {
+                uint32_t index;
+                auto pos = bin.pos;
+                if (auto e = varuint_from_bin<uint32_t, 35>(index, bin); e != stream_error::no_error)
+                    return fail(e);
+                if (index >= op->arg) {
+                    bin.pos = pos;
+                    return fail(stream_error::bad_variant_index);
+                }
+                stack.push_back({t, allow_extensions, 0});
+                stack.back().program = op;
+                stack.back().variant_index = index;
+                op = op + 1 + index;
+                break;
+            }
+            }
+            if (stack.size() > max_stack_size)
+                return conversion_error_kind::recursion_limit;
+        }
+
+        // Continue with the next element of the innermost entry which has any left
+        for (;;) {
+            if (stack.empty())
+                return conversion_error_kind::none;
+            auto& entry = stack.back();
+            auto* program = entry.program;
+            if (program->code == abi_opcode::object) {
+                int size = program->arg;
+                // A run of fixed-size fields is skipped with one bounds check
+                int run_start = entry.position + 1;
+                uint64_t run = 0;
+                for (uint32_t n; entry.position + 1 < size &&
+                                 (n = fixed_bin_size(program + 2 + entry.position)) != sysio::abi_variable_size;) {
+                    run += n;
+                    ++entry.position;
+                }
+                if (run > bin.remaining()) {
+                    // Stop at the field which doesn't fit
+                    for (entry.position = run_start;; ++entry.position) {
+                        if (auto e = skip_bin(bin, fixed_bin_size(program + 1 + entry.position));
+                            e != stream_error::no_error)
+                            return fail(e);
+                    }
+                }
+                bin.pos += run;
+                if (++entry.position < size) {
+                    op = program + 1 + entry.position;
+                    if (bin.pos == bin.end && entry.allow_extensions && is_extension(op))
+                        continue;
+                    allow_extensions = entry.allow_extensions && entry.position + 1 == size;
+                    break;
+                }
+            } else if (program->code != abi_opcode::variant) {
+                int size = program->code == abi_opcode::array ? (int)entry.array_size : (int)program->arg;
+                if (++entry.position < size) {
+                    op = program + 1;
+                    allow_extensions = false;
+                    break;
+                }
+            }
+            stack.pop_back();
+        }
+    }
+}
+
+// Checks that bin holds a value of type, with the same rules as bin_to_json, without converting it. On success bin.pos
+// is just past the value. Returns false and fills error if bin is malformed.
+inline bool validate_bin(sysio::input_stream& bin, const abi_type* type, conversion_scratch& scratch,
+                         conversion_error& error) {
+    const char* begin = bin.pos;
+    auto kind = skip_bin(type, bin, scratch);
+    if (kind == conversion_error_kind::none)
+        return true;
+    error.kind = kind;
+    error.offset = bin.pos - begin;
+    error.path = conversion_path(type, scratch.bin_to_json_stack, [](auto& entry, auto& fields) {
+        return entry.variant_index < fields.size() ? &fields[entry.variant_index] : nullptr;
+    });
+    error.message = conversion_error_message(kind);
+    return false;
+}
+
+// Finds a field in a binary value of struct type without converting the value. path names the field, or a field of a
+// nested struct, e.g. "act.authorization". On success bin holds the field's bytes and type is the field's type. A field
+// which only follows fixed-size fields is found by its offset; otherwise the fields before it are skipped.
+inline bool locate_field(const abi_type*& type, sysio::input_stream& bin, std::string_view path,
+                         conversion_scratch& scratch, conversion_error& error) {
+    const char* begin = bin.pos;
+    bool allow_extensions = true;
+    auto fail = [&](conversion_error_kind kind, std::string_view message, std::string_view field_path) {
+        error.kind = kind;
+        error.offset = bin.pos - begin;
+        error.path = field_path;
+        error.message = message;
+        return false;
+    };
+    for (size_t pos = 0; pos <= path.size();) {
+        auto end = std::min(path.find('.', pos), path.size());
+        auto name = path.substr(pos, end - pos);
+        auto* s = type->as_struct();
+        if (!s)
+            return fail(conversion_error_kind::other, "type is not a struct", path.substr(0, pos ? pos - 1 : 0));
+        auto& fields = s->fields;
+        auto it = std::find_if(fields.begin(), fields.end(), [&](auto& field) { return field.name == name; });
+        if (it == fields.end())
+            return fail(conversion_error_kind::other, "unknown field", path.substr(0, end));
+
+        // Jump to the last field with a known offset, then skip the rest
+        auto known = it;
+        while (known->offset == sysio::abi_variable_size)
+            --known;
+        if (known->offset > bin.remaining())
+            return fail(conversion_error_kind::overrun, conversion_error_message(conversion_error_kind::overrun),
+                        path.substr(0, end));
+        bin.pos += known->offset;
+        for (; known != it; ++known) {
+            if (auto kind = skip_bin(known->type, bin, scratch, false); kind != conversion_error_kind::none)
+                return fail(kind, conversion_error_message(kind), path.substr(0, end));
+        }
+
+        allow_extensions = allow_extensions && &*it == &fields.back();
+        type = it->type;
+        auto field_begin = bin.pos;
+        if (type->fixed_size != sysio::abi_variable_size) {
+            if (type->fixed_size > bin.remaining())
+                return fail(conversion_error_kind::overrun, conversion_error_message(conversion_error_kind::overrun),
+                            path.substr(0, end));
+            bin.end = bin.pos + type->fixed_size;
+        } else {
+            auto field = bin;
+            if (auto kind = skip_bin(type, field, scratch, allow_extensions); kind != conversion_error_kind::none) {
+                bin.pos = field.pos;
+                return fail(kind, conversion_error_message(kind), path.substr(0, end));
+            }
+            bin.end = field.pos;
+        }
+        bin.pos = field_begin;
+        pos = end + 1;
+    }
+    return true;
+}
+
 } // namespace abieos
@@ -58,18 +58,24 @@ template <auto size>
 inline void decimal_to_binary(std::array<uint8_t, size>& result,
                                                               std::string_view s) {
     memset(result.begin(), 0, result.size());
-    for (auto& src_digit : s) {
-       sysio::check(!(src_digit < '0' || src_digit > '9'),
-            sysio::convert_json_error(sysio::from_json_error::expected_int));
-        uint8_t carry = src_digit - '0';
+    auto pos = s.data();
+    auto end = pos + s.size();
+    // result = result * 10^k + the next k <= 8 digits
+    for (size_t n = sysio::digit_run(pos, end), k; n; pos += k, n -= k) {
+        k = std::min<size_t>(n, 8);
+        uint64_t carry = sysio::parse_digits(pos, k);
+        uint64_t scale = 1;
+        for (size_t i = 0; i < k; ++i)
+            scale *= 10;
         for (auto& result_byte : result) {
-            int x = result_byte * 10 + carry;
+            uint64_t x = result_byte * scale + carry;
             result_byte = x;
             carry = x >> 8;
         }
         sysio::check(!carry,
               sysio::convert_json_error(sysio::from_json_error::number_out_of_range));
     }
+    sysio::check(pos == end, sysio::convert_json_error(sysio::from_json_error::expected_int));
 }
 
 template <auto size>
@@ -0,0 +1,741 @@
+// copyright defined in abieos/LICENSE.md
+
+// Micro benchmarks. Not part of ctest; run bench_abieos directly, passing a multiplier as the first argument for more
+// stable numbers.
+
+#include "abieos.h"
+#include "abieos.hpp"
+#include <sysio/flat_map.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+size_t scale = 1;
+
+// Bytes currently allocated through operator new, for memory benchmarks. Each block is prefixed with its size.
+std::atomic<size_t> live_bytes{0};
+constexpr size_t block_header = alignof(std::max_align_t);
+
+void* operator new(size_t size) {
+    auto* p = static_cast<char*>(malloc(size + block_header));
+    if (!p)
+        throw std::bad_alloc();
+    *reinterpret_cast<size_t*>(p) = size;
+    live_bytes.fetch_add(size, std::memory_order_relaxed);
+    return p + block_header;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p)
+        return;
+    auto* block = static_cast<char*>(p) - block_header;
+    live_bytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+    free(block);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+template <typename F>
+double ns_per_op(size_t ops, F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+void report(const char* name, double baseline, double ns) {
+    printf("%-40s %10.2f ns/op %10.2f ns/op  %5.2fx\n", name, baseline, ns, baseline / ns);
+}
+
+template <typename T>
+T check(abieos_context* context, T result) {
+    if (!result)
+        throw std::runtime_error(abieos_get_error(context));
+    return result;
+}
+
+// Account names are spread over the whole name space, like real ones
+std::vector<uint64_t> make_names(size_t n) {
+    std::vector<uint64_t> names;
+    uint64_t x = 0x9e3779b97f4a7c15;
+    for (size_t i = 0; i < n; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        names.push_back(x);
+    }
+    return names;
+}
+
+const char lookup_abi[] = R"({
+    "version": "sysio::abi/1.1",
+    "structs": [{"name": "transfer", "base": "", "fields": [{"name": "memo", "type": "string"}]}],
+    "actions": [{"name": "transfer", "type": "transfer", "ricardian_contract": ""}]
+})";
+
+// Memory each abi would need for its own copy of the builtin types, which are now shared. Runs before anything else
+// builds the shared table, so its size can be measured.
+void bench_builtin_types() {
+    auto before = live_bytes.load();
+    sysio::get_builtin_type("int8");
+    auto table = live_bytes.load() - before;
+
+    sysio::abi_def def;
+    std::string abi_json{lookup_abi};
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    const size_t count = 1000;
+    std::vector<std::unique_ptr<sysio::abi>> abis;
+    abis.reserve(count);
+    before = live_bytes.load();
+    for (size_t i = 0; i < count; ++i) {
+        abis.push_back(std::make_unique<sysio::abi>());
+        convert(def, *abis.back());
+    }
+    auto shared = (live_bytes.load() - before) / count;
+
+    printf("%-40s %16s %16s %7s\n", "", "copied builtins", "shared builtins", "saving");
+    printf("%-40s %10zu bytes %10zu bytes  %5.2fx\n", "memory per small abi", shared + table, shared,
+           double(shared + table) / shared);
+}
+
+void bench_contract_lookup() {
+    const size_t contracts = 10000;
+    const size_t lookups = 1000000 * scale;
+    auto names = make_names(contracts);
+
+    // The containers themselves, holding what a context holds
+    std::map<sysio::name, std::shared_ptr<int>> tree;
+    sysio::flat_map<sysio::name, std::shared_ptr<int>> flat;
+    for (auto n : names) {
+        tree[sysio::name{n}] = std::make_shared<int>(0);
+        flat[sysio::name{n}] = std::make_shared<int>(0);
+    }
+    size_t found = 0;
+    auto tree_ns = ns_per_op(lookups, [&] {
+        for (size_t i = 0; i < lookups; ++i)
+            found += tree.find(sysio::name{names[(i * 7919) % contracts]})->second != nullptr;
+    });
+    auto flat_ns = ns_per_op(lookups, [&] {
+        for (size_t i = 0; i < lookups; ++i)
+            found += flat.find(sysio::name{names[(i * 7919) % contracts]})->second != nullptr;
+    });
+    if (found != 2 * lookups)
+        throw std::runtime_error("contract lookup: missing contract");
+    printf("%-40s %16s %16s %7s\n", "10k contracts", "std::map", "flat_map", "speedup");
+    report("contract find", tree_ns, flat_ns);
+
+    std::map<std::string, int> type_tree;
+    sysio::flat_map<std::string, int> type_flat;
+    std::vector<std::string> types;
+    for (size_t i = 0; i < 200; ++i)
+        types.push_back("struct_type_" + std::to_string(names[i] % 100000));
+    for (auto& t : types) {
+        type_tree[t] = 0;
+        type_flat[t] = 0;
+    }
+    found = 0;
+    tree_ns = ns_per_op(lookups, [&] {
+        for (size_t i = 0; i < lookups; ++i)
+            found += type_tree.find(types[(i * 31) % types.size()]) != type_tree.end();
+    });
+    flat_ns = ns_per_op(lookups, [&] {
+        for (size_t i = 0; i < lookups; ++i)
+            found += type_flat.find(types[(i * 31) % types.size()]) != type_flat.end();
+    });
+    if (found != 2 * lookups)
+        throw std::runtime_error("type lookup: missing type");
+    report("type find (200 types)", tree_ns, flat_ns);
+
+    // End to end through the C API
+    auto context = check(nullptr, abieos_create());
+    for (auto n : names)
+        check(context, abieos_set_abi(context, n, lookup_abi));
+    auto transfer = check(context, abieos_string_to_name(context, "transfer"));
+    const size_t api_lookups = 200000 * scale;
+    auto api_ns = ns_per_op(api_lookups, [&] {
+        for (size_t i = 0; i < api_lookups; ++i)
+            check(context, abieos_get_type_for_action(context, names[(i * 7919) % contracts], transfer));
+    });
+    printf("%-40s %16s %10.2f ns/op\n", "abieos_get_type_for_action", "", api_ns);
+    abieos_destroy(context);
+}
+
+const char program_abi[] = R"({
+    "version": "sysio::abi/1.1",
+    "structs": [
+        {"name": "transfer", "base": "", "fields": [{"name": "from", "type": "name"}, {"name": "to", "type": "name"},
+            {"name": "quantity", "type": "asset"}, {"name": "memo", "type": "string"}]},
+        {"name": "batch", "base": "", "fields": [{"name": "id", "type": "uint64"},
+            {"name": "transfers", "type": "transfer[]"}, {"name": "fee", "type": "asset?"},
+            {"name": "payload", "type": "payload"}]},
+        {"name": "flags", "base": "", "fields": [{"name": "a", "type": "bool"}, {"name": "b", "type": "uint8"},
+            {"name": "c", "type": "uint8?"}, {"name": "d", "type": "uint16"}]}
+    ],
+    "variants": [{"name": "payload", "types": ["uint32", "transfer"]}]
+})";
+
+void bench_programs() {
+    sysio::abi_def def;
+    std::string abi_json{program_abi};
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi compiled, serializer;
+    convert(def, compiled);
+    convert(def, serializer);
+    for (auto& [_, type] : serializer.abi_types)
+        type.program.clear();
+
+    abieos::conversion_scratch scratch;
+    abieos::conversion_error error;
+    std::vector<char> bin;
+    std::string out;
+    auto to_bin = [&](const sysio::abi_type* type, const std::string& json) {
+        bin.clear();
+        if (!abieos::json_to_bin(bin, type, json, [] {}, scratch, error))
+            throw std::runtime_error("programs: " + error.message);
+    };
+    auto to_json = [&](const sysio::abi_type* type) {
+        sysio::input_stream in{bin.data(), bin.size()};
+        if (!abieos::bin_to_json(in, type, out, [] {}, scratch, error))
+            throw std::runtime_error("programs: " + error.message);
+    };
+    auto run = [&](const char* name, const char* type_name, const std::string& json, size_t ops) {
+        auto* serializer_type = serializer.get_type(type_name);
+        auto* compiled_type = compiled.get_type(type_name);
+        to_bin(serializer_type, json);
+        auto expected = bin;
+        to_json(serializer_type);
+        if (out != json)
+            throw std::runtime_error("programs: round trip mismatch");
+
+        auto serializer_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                to_json(serializer_type);
+        });
+        auto program_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                to_json(compiled_type);
+        });
+        if (out != json)
+            throw std::runtime_error("programs: bin_to_json mismatch");
+        report((std::string(name) + " bin_to_json").c_str(), serializer_ns, program_ns);
+
+        serializer_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                to_bin(serializer_type, json);
+        });
+        program_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                to_bin(compiled_type, json);
+        });
+        if (bin != expected)
+            throw std::runtime_error("programs: json_to_bin mismatch");
+        report((std::string(name) + " json_to_bin").c_str(), serializer_ns, program_ns);
+    };
+
+    // Mostly builtins which are costly to convert
+    const std::string transfer = R"({"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"memo"})";
+    std::string batch = R"({"id":"7","transfers":[)";
+    for (int i = 0; i < 8; ++i)
+        batch += (i ? "," : "") + transfer;
+    batch += R"(],"fee":"0.0100 SYS","payload":["transfer",)" + transfer + "]}";
+
+    // Mostly structure
+    std::string flags = "[";
+    for (int i = 0; i < 64; ++i)
+        flags += std::string(i ? "," : "") + R"({"a":true,"b":)" + std::to_string(i) + R"(,"c":)" +
+                 (i % 2 ? "null" : "3") + R"(,"d":)" + std::to_string(i * 100) + "}";
+    flags += "]";
+
+    printf("%-40s %16s %16s %7s\n", "", "serializers", "programs", "speedup");
+    run("batch of transfers", "batch", batch, 20000 * scale);
+    run("64 small structs", "flags[]", flags, 20000 * scale);
+}
+
+// Arrays of arrays, whose sizes are only known once each array ends
+void bench_nested_arrays() {
+    std::string abi_json = R"({
+        "version": "sysio::abi/1.1",
+        "structs": [
+            {"name": "row", "base": "", "fields": [{"name": "v", "type": "uint16[]"}]},
+            {"name": "table", "base": "", "fields": [{"name": "rows", "type": "row[]"}]}
+        ]
+    })";
+    sysio::abi_def def;
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi abi;
+    convert(def, abi);
+    auto* type = abi.get_type("table");
+
+    abieos::conversion_scratch scratch;
+    abieos::conversion_error error;
+    std::vector<char> bin;
+    auto run = [&](const char* name, int rows, int columns, size_t ops) {
+        std::string json = R"({"rows":[)";
+        for (int r = 0; r < rows; ++r) {
+            json += std::string(r ? "," : "") + R"({"v":[)";
+            for (int c = 0; c < columns; ++c)
+                json += (c ? "," : "") + std::to_string(c);
+            json += "]}";
+        }
+        json += "]}";
+        auto ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i) {
+                bin.clear();
+                if (!abieos::json_to_bin(bin, type, json, [] {}, scratch, error))
+                    throw std::runtime_error("nested_arrays: " + error.message);
+            }
+        });
+        printf("%-40s %10.2f ns/op %10.2f MB/s\n", name, ns, json.size() * 1e3 / ns);
+    };
+
+    printf("%-40s %16s %16s\n", "", "json_to_bin", "json in");
+    run("1000 rows of 4", 1000, 4, 200 * scale);
+    run("100 rows of 200", 100, 200, 100 * scale);
+    run("4 rows of 20000", 4, 20000, 50 * scale);
+    run("300 rows of 300", 300, 300, 50 * scale);
+}
+
+// Client json with keys in any order, converted through the jvalue tree and streamed
+void bench_reorderable() {
+    sysio::abi_def def;
+    std::string abi_json{program_abi};
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi abi;
+    convert(def, abi);
+
+    abieos::conversion_scratch scratch;
+    abieos::conversion_error error;
+    std::vector<char> bin, expected;
+    auto tree = [&](const sysio::abi_type* type, const std::string& json) {
+        bin.clear();
+        abieos::jvalue value;
+        abieos::json_to_jvalue(value, json, [] {});
+        abieos::json_to_bin(bin, type, value, [] {});
+    };
+    auto streamed = [&](const sysio::abi_type* type, const std::string& json) {
+        bin.clear();
+        if (!abieos::json_to_bin_reorderable(bin, type, json, [] {}, scratch, error))
+            throw std::runtime_error("reorderable: " + error.message);
+    };
+    auto run = [&](const char* name, const char* type_name, const std::string& json, size_t ops) {
+        auto* type = abi.get_type(type_name);
+        tree(type, json);
+        expected = bin;
+        auto tree_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                tree(type, json);
+        });
+        auto streamed_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                streamed(type, json);
+        });
+        if (bin != expected)
+            throw std::runtime_error("reorderable: mismatch");
+        report(name, tree_ns, streamed_ns);
+    };
+
+    const std::string in_order = R"({"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"memo"})";
+    const std::string shuffled = R"({"memo":"memo","quantity":"1.0000 SYS","to":"bob","from":"alice"})";
+    auto batch = [](const std::string& transfer) {
+        std::string json = R"({"payload":["transfer",)" + transfer + R"(],"fee":"0.0100 SYS","transfers":[)";
+        for (int i = 0; i < 8; ++i)
+            json += (i ? "," : "") + transfer;
+        return json + R"(],"id":"7"})";
+    };
+
+    printf("%-40s %16s %16s %7s\n", "", "jvalue tree", "streamed", "speedup");
+    run("transfer, keys in order", "transfer", in_order, 100000 * scale);
+    run("transfer, keys reversed", "transfer", shuffled, 100000 * scale);
+    run("batch of transfers, keys reversed", "batch", batch(shuffled), 20000 * scale);
+}
+
+// Alternatives named like state history's versioned types, so linear search compares long common prefixes
+void bench_variants() {
+    printf("%-40s %16s %16s %7s\n", "", "linear search", "hashed index", "speedup");
+    for (int n : {2, 4, 8, 16, 32, 64}) {
+        std::string abi_json = R"({"version": "sysio::abi/1.1", "structs": [)";
+        std::string alternatives, json = "[";
+        for (int i = 0; i < n; ++i) {
+            auto name = "action_trace_v" + std::to_string(i);
+            abi_json += std::string(i ? "," : "") + R"({"name": ")" + name +
+                        R"(", "base": "", "fields": [{"name": "a", "type": "uint8"}]})";
+            alternatives += std::string(i ? "," : "") + '"' + name + '"';
+        }
+        abi_json += R"(], "variants": [{"name": "v", "types": [)" + alternatives + "]}]}";
+        for (int i = 0; i < 64; ++i)
+            json += std::string(i ? "," : "") + R"(["action_trace_v)" + std::to_string(i % n) + R"(",{"a":1}])";
+        json += "]";
+
+        sysio::abi_def def;
+        sysio::json_token_stream stream(abi_json.data());
+        from_json(def, stream);
+        sysio::abi hashed, linear;
+        convert(def, hashed);
+        convert(def, linear);
+        linear.abi_types.find("v")->second.name_index.clear();
+
+        abieos::conversion_scratch scratch;
+        abieos::conversion_error error;
+        std::vector<char> bin, expected;
+        auto to_bin = [&](const sysio::abi_type* type) {
+            bin.clear();
+            if (!abieos::json_to_bin(bin, type, json, [] {}, scratch, error))
+                throw std::runtime_error("variants: " + error.message);
+        };
+        auto* hashed_type = hashed.get_type("v[]");
+        auto* linear_type = linear.get_type("v[]");
+        to_bin(linear_type);
+        expected = bin;
+
+        const size_t ops = 20000 * scale;
+        auto linear_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                to_bin(linear_type);
+        });
+        auto hashed_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                to_bin(hashed_type);
+        });
+        if (bin != expected)
+            throw std::runtime_error("variants: json_to_bin mismatch");
+        report(("64 values, " + std::to_string(n) + " alternatives").c_str(), linear_ns, hashed_ns);
+    }
+}
+
+// Pulls every token
+template <typename Stream>
+void pull_tokens(Stream& stream) {
+    do {
+        stream.peek_token();
+        stream.eat_token();
+    } while (!stream.complete());
+}
+
+// json is copied first since streams decode strings in place. rapidjson finds the end by the terminator; the
+// scanner is given the size, as json_to_bin gives it.
+void tokenize_rapidjson(std::vector<char>& buffer, const std::string& json) {
+    buffer.assign(json.c_str(), json.c_str() + json.size() + 1);
+    sysio::rapidjson_token_stream stream(buffer.data());
+    pull_tokens(stream);
+}
+
+void tokenize_scanner(std::vector<char>& buffer, const std::string& json) {
+    buffer.assign(json.c_str(), json.c_str() + json.size() + 1);
+    sysio::json_token_stream stream(buffer.data(), json.size());
+    pull_tokens(stream);
+}
+
+void bench_json_tokenizer() {
+    std::string transfers = "[", strings = "[", utf8 = "[";
+    for (int i = 0; i < 200; ++i)
+        transfers += std::string(i ? "," : "") + R"({"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"m",)" +
+                     R"("amount":)" + std::to_string(i * 7919) + "}";
+    for (int i = 0; i < 20; ++i) {
+        strings += std::string(i ? "," : "") + '"' + std::string(2000, 'a' + i % 26) + '"';
+        utf8 += std::string(i ? "," : "") + '"';
+        for (int j = 0; j < 200; ++j)
+            utf8 += "caf\xc3\xa9 \xe4\xb8\xad\xf0\x9f\x98\x80";
+        utf8 += '"';
+    }
+    transfers += "]", strings += "]", utf8 += "]";
+
+    using sysio::json_scan::isa;
+    std::vector<char> buffer;
+    // Best of several runs; a document takes tens of microseconds, so one long run mostly measures whatever else
+    // the machine was doing
+    auto time = [&](auto tokenize, const std::string& json) {
+        const size_t ops = 400 * scale;
+        double best = 0;
+        for (int run = 0; run < 5; ++run) {
+            double ns = ns_per_op(ops, [&] {
+                for (size_t i = 0; i < ops; ++i)
+                    tokenize(buffer, json);
+            });
+            best = run ? std::min(best, ns) : ns;
+        }
+        return best;
+    };
+    struct document {
+        const char*        name;
+        const std::string& json;
+    };
+    const document documents[] = {{"transfers", transfers}, {"long strings", strings}, {"utf-8 strings", utf8}};
+
+    printf("%-40s %16s %16s %7s\n", "", "rapidjson", "scanner", "speedup");
+    for (auto& doc : documents)
+        report(doc.name, time(tokenize_rapidjson, doc.json), time(tokenize_scanner, doc.json));
+
+    printf("%-40s %16s %16s %7s\n", "", "portable", "simd", "speedup");
+    for (auto& doc : documents) {
+        sysio::json_scan::select_isa(isa::portable);
+        auto portable_ns = time(tokenize_scanner, doc.json);
+        for (auto [level, level_name] : {std::pair{isa::sse2, "sse2"}, std::pair{isa::avx2, "avx2"}}) {
+            if (!sysio::json_scan::select_isa(level))
+                continue;
+            report((std::string(doc.name) + ", " + level_name).c_str(), portable_ns,
+                   time(tokenize_scanner, doc.json));
+        }
+    }
+    sysio::json_scan::select_isa(sysio::json_scan::best_isa());
+}
+
+// from_json_int before it converted several digits per step. Kept out of line like from_json_int, which
+// json_to_bin's builtins call rather than inline; otherwise the baseline alone is folded into the loop below.
+template <typename T>
+__attribute__((noinline)) void per_digit_int(T& result, std::string_view r) {
+    auto pos = r.data();
+    auto end = pos + r.size();
+    bool found = false;
+    result = 0;
+    T limit, sign;
+    if (std::is_signed_v<T> && pos != end && *pos == '-') {
+        ++pos;
+        sign = -1;
+        limit = std::numeric_limits<T>::min();
+    } else {
+        sign = 1;
+        limit = std::numeric_limits<T>::max();
+    }
+    while (pos != end && *pos >= '0' && *pos <= '9') {
+        T digit = (*pos++ - '0');
+        sysio::check(!(std::is_signed_v<T> && (-sign * limit + digit) / 10 > -sign * result),
+                     sysio::convert_json_error(sysio::from_json_error::number_out_of_range));
+        sysio::check(!(!std::is_signed_v<T> && (limit - digit) / 10 < result),
+                     sysio::convert_json_error(sysio::from_json_error::number_out_of_range));
+        result = result * 10 + sign * digit;
+        found = true;
+    }
+    sysio::check(pos == end && found, sysio::convert_json_error(sysio::from_json_error::expected_int));
+}
+
+struct string_token_stream {
+    std::string_view value;
+    std::string_view get_string() { return value; }
+};
+
+// Random values over the whole range of T, so most have its full number of digits
+template <typename T>
+void bench_decimal_int(const char* name, const std::vector<uint64_t>& random) {
+    std::vector<std::string> inputs;
+    for (size_t i = 0; i + 1 < random.size(); i += 2) {
+        unsigned __int128 bits = ((unsigned __int128)random[i] << 64) | random[i + 1];
+        T value;
+        memcpy(&value, &bits, sizeof(value));
+        bool negative = value < 0;
+        unsigned __int128 magnitude = negative ? -(unsigned __int128)value : (unsigned __int128)value;
+        std::string s;
+        do {
+            s.insert(s.begin(), '0' + int(magnitude % 10));
+            magnitude /= 10;
+        } while (magnitude);
+        inputs.push_back(negative ? "-" + s : s);
+    }
+
+    T sum = 0, value;
+    const size_t ops = 200 * scale * inputs.size();
+    auto per_digit_ns = ns_per_op(ops, [&] {
+        for (size_t i = 0; i < ops / inputs.size(); ++i)
+            for (auto& input : inputs) {
+                per_digit_int(value, input);
+                sum += value;
+            }
+    });
+    T expected = sum;
+    sum = 0;
+    auto swar_ns = ns_per_op(ops, [&] {
+        for (size_t i = 0; i < ops / inputs.size(); ++i)
+            for (auto& input : inputs) {
+                string_token_stream stream{input};
+                sysio::from_json_int(value, stream);
+                sum += value;
+            }
+    });
+    if (sum != expected)
+        throw std::runtime_error("decimal ints: mismatch");
+    report(name, per_digit_ns, swar_ns);
+}
+
+void bench_decimal_ints() {
+    auto random = make_names(2000);
+    printf("%-40s %16s %16s %7s\n", "", "per digit", "swar", "speedup");
+    bench_decimal_int<uint8_t>("uint8", random);
+    bench_decimal_int<uint16_t>("uint16", random);
+    bench_decimal_int<uint32_t>("uint32", random);
+    bench_decimal_int<int32_t>("int32", random);
+    bench_decimal_int<uint64_t>("uint64", random);
+    bench_decimal_int<int64_t>("int64", random);
+#ifndef ABIEOS_NO_INT128
+    bench_decimal_int<unsigned __int128>("uint128", random);
+    bench_decimal_int<__int128>("int128", random);
+#endif
+}
+
+void bench_validate() {
+    auto context = check(nullptr, abieos_create());
+    check(context, abieos_set_abi(context, 0, program_abi));
+    check(context, abieos_set_abi(context, 1, R"({
+        "version": "sysio::abi/1.1",
+        "structs": [{"name": "permission_level", "base": "", "fields": [{"name": "actor", "type": "name"},
+            {"name": "permission", "type": "name"}]}]
+    })"));
+    auto run = [&](const char* name, uint64_t contract, const char* type_name, const std::string& json, size_t ops) {
+        auto type = check(context, abieos_get_type_handle(context, contract, type_name));
+        check(context, abieos_handle_json_to_bin(context, type, json.c_str()));
+        std::vector<char> bin(abieos_get_bin_data(context),
+                              abieos_get_bin_data(context) + abieos_get_bin_size(context));
+        auto convert_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                check(context, abieos_handle_bin_to_json(context, type, bin.data(), bin.size()));
+        });
+        size_t consumed = 0;
+        auto validate_ns = ns_per_op(ops, [&] {
+            for (size_t i = 0; i < ops; ++i)
+                check(context, abieos_handle_validate_bin(context, type, bin.data(), bin.size(), &consumed));
+        });
+        if (consumed != bin.size())
+            throw std::runtime_error("validate: wrong size");
+        report(name, convert_ns, validate_ns);
+    };
+
+    const std::string transfer = R"({"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"memo"})";
+    std::string batch = R"({"id":"7","transfers":[)";
+    for (int i = 0; i < 8; ++i)
+        batch += (i ? "," : "") + transfer;
+    batch += R"(],"fee":"0.0100 SYS","payload":["transfer",)" + transfer + "]}";
+    std::string levels = "[";
+    for (int i = 0; i < 1000; ++i)
+        levels += std::string(i ? "," : "") + R"({"actor":"alice","permission":"active"})";
+    levels += "]";
+
+    printf("%-40s %16s %16s %7s\n", "", "bin_to_json", "validate_bin", "speedup");
+    run("batch of transfers", 0, "batch", batch, 20000 * scale);
+    run("1000 permission_levels", 1, "permission_level[]", levels, 2000 * scale);
+    abieos_destroy(context);
+}
+
+// A contract abi of 5 to 64 structs mixing builtin, alias, optional, array and struct fields. Each i gives a distinct
+// abi, so none are deduplicated.
+std::string make_contract_abi(size_t i) {
+    static const char* field_types[] = {"name",   "asset", "uint64",      "string", "uint32",  "bool",
+                                        "symbol", "bytes", "public_key",  "int64",  "uint8[]", "time_point_sec",
+                                        "checksum256", "account_name"};
+    const size_t num_types = sizeof(field_types) / sizeof(field_types[0]);
+    size_t structs = 5 + (i * 37) % 60;
+    std::string abi = R"({"version":"sysio::abi/1.1","types":[{"new_type_name":"account_name","type":"name"}],)";
+    abi += R"("structs":[)";
+    for (size_t s = 0; s < structs; ++s) {
+        abi += std::string(s ? "," : "") + R"({"name":"s)" + std::to_string(s) + (s ? "" : "_" + std::to_string(i)) +
+               R"(","base":"","fields":[)";
+        size_t fields = 3 + (i + s) % 6;
+        for (size_t f = 0; f < fields; ++f) {
+            std::string type = field_types[(i + s * 7 + f * 3) % num_types];
+            if (s > 2 && f == fields - 1)
+                type = "s" + std::to_string(s - 2) + ((s + f) % 2 ? "[]" : "?");
+            abi += std::string(f ? "," : "") + R"({"name":"f)" + std::to_string(f) + R"(","type":")" + type + R"("})";
+        }
+        abi += "]}";
+    }
+    abi += R"(],"actions":[)";
+    for (size_t s = 1; s < structs; s += 2)
+        abi += std::string(s > 1 ? "," : "") + R"({"name":"act)" + char('a' + s % 26) + char('a' + s / 26) +
+               R"(","type":"s)" + std::to_string(s) + R"(","ricardian_contract":""})";
+    abi += R"(],"variants":[{"name":"v","types":["s1","s2","uint64"]}]})";
+    return abi;
+}
+
+void bench_snapshot() {
+    // A restart reloads every contract's abi; compare loading a snapshot of the registry against publishing each
+    // binary abi again
+    const size_t count = 6000 * scale;
+    auto context = check(nullptr, abieos_create());
+    std::vector<std::vector<char>> abis;
+    for (size_t i = 0; i < count; ++i) {
+        check(context, abieos_abi_json_to_bin(context, make_contract_abi(i).c_str()));
+        abis.emplace_back(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    }
+    double set_ns = 1e30, load_ns = 1e30;
+    std::vector<char> snapshot;
+    for (int round = 0; round < 3; ++round) {
+        auto* registry = abieos_registry_create();
+        set_ns = std::min(set_ns, ns_per_op(count, [&] {
+            for (size_t i = 0; i < count; ++i)
+                check(context, abieos_registry_set_abi_bin(context, registry, i, abis[i].data(), abis[i].size()));
+        }));
+        check(context, abieos_registry_save(context, registry));
+        snapshot.assign(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+        abieos_registry_release(registry);
+        auto* loaded = abieos_registry_create();
+        load_ns = std::min(load_ns, ns_per_op(count, [&] {
+            check(context, abieos_registry_load(context, loaded, snapshot.data(), snapshot.size()));
+        }));
+        abieos_registry_release(loaded);
+    }
+
+    printf("%-40s %16s %16s %7s\n", "", "set_abi_bin", "snapshot", "speedup");
+    report("load one abi of many", set_ns, load_ns);
+    abieos_destroy(context);
+}
+
+void bench_bulk() {
+    const size_t count = 400 * scale;
+    auto context = check(nullptr, abieos_create());
+    std::vector<std::vector<char>> abis;
+    for (size_t i = 0; i < count; ++i) {
+        std::string abi = program_abi;
+        abi.replace(abi.find("\"batch\""), 7, "\"batch" + std::to_string(i) + "\"");
+        check(context, abieos_abi_json_to_bin(context, abi.c_str()));
+        abis.emplace_back(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    }
+    std::vector<abieos_abi_item> items;
+    for (size_t i = 0; i < count; ++i)
+        items.push_back({i, abis[i].data(), abis[i].size()});
+    std::vector<abieos_batch_result> results(count);
+    auto load = [&](size_t threads) {
+        auto* registry = abieos_registry_create();
+        auto ns = ns_per_op(count, [&] {
+            check(context, abieos_set_abis_bulk(context, registry, items.data(), count, threads, results.data()));
+        });
+        abieos_registry_release(registry);
+        return ns;
+    };
+    auto serial = load(1);
+    auto parallel = load(0);
+
+    printf("%-40s %16s %16s %7s\n", "", "1 thread", "all cores", "speedup");
+    report("set_abis_bulk, per abi", serial, parallel);
+    abieos_destroy(context);
+}
+
+int main(int argc, char** argv) {
+    try {
+        if (argc > 1)
+            scale = std::max(1, atoi(argv[1]));
+        bench_builtin_types();
+        bench_contract_lookup();
+        bench_programs();
+        bench_nested_arrays();
+        bench_reorderable();
+        bench_variants();
+        bench_json_tokenizer();
+        bench_decimal_ints();
+        bench_validate();
+        bench_snapshot();
+        bench_bulk();
+        return 0;
+    } catch (std::exception& e) {
+        printf("error: %s\n", e.what());
+        return 1;
+    }
+}
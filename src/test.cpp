@@ -6,15 +6,73 @@
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
 #include <stdexcept>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 extern const char* const state_history_plugin_abi;
 
 inline const bool generate_corpus = false;
 
+// Counts heap allocations, so tests can check that conversions reuse their scratch buffers. Every form of operator new
+// and delete is replaced so each one goes through the same pair of functions. Those stay out of line; otherwise gcc
+// sees free() on memory from operator new wherever a delete is inlined, and warns.
+std::atomic<size_t> heap_allocations{0};
+
+__attribute__((noinline)) void* counted_alloc(size_t size, size_t align) noexcept {
+    ++heap_allocations;
+    size = size ? size : 1;
+    if (align <= alignof(std::max_align_t))
+        return malloc(size);
+    return aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+__attribute__((noinline)) void counted_free(void* p) noexcept { free(p); }
+
+void* operator new(size_t size) {
+    if (auto p = counted_alloc(size, 0))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    if (auto p = counted_alloc(size, size_t(align)))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size, 0); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, size_t(align));
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, size_t(align));
+}
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+
 const char tokenHexAbi[] = "0E737973696F3A3A6162692F312E30010C6163636F756E745F6E616D65046E61"
                            "6D6505087472616E7366657200040466726F6D0C6163636F756E745F6E616D65"
                            "02746F0C6163636F756E745F6E616D65087175616E7469747905617373657404"
@@ -574,6 +632,18 @@ void run_check_type(abieos_context* context, uint64_t contract, const char* type
             throw std::runtime_error("mismatch between reorderable_hex, ordered_hex");
     }
     // printf("%s\n", reorderable_hex.c_str());
+
+    // Truncated binary is reported as malformed input, never through an exception
+    std::vector<char> bin(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    for (size_t size = 0; size < bin.size(); ++size) {
+        if (abieos_bin_to_json(context, contract, type, bin.data(), size))
+            continue;
+        abieos_error_report report;
+        check_context(context, abieos_get_error_report(context, &report));
+        if (report.kind == abieos_error_kind_other || report.offset > size)
+            throw std::runtime_error(std::string("truncated ") + type + ": " + abieos_get_error(context));
+    }
+
     std::string result = check_context(context, abieos_hex_to_json(context, contract, type, reorderable_hex.c_str()));
     // printf("%s\n", result.c_str());
     printf("%s %s %s %s\n", type, data, reorderable_hex.c_str(), result.c_str());
@@ -1324,10 +1394,1838 @@ void check_types() {
     abieos_destroy(context);
 }
 
-int main() {
+void check_registry() {
+    auto registry = check(abieos_registry_create());
+    auto writer = check(abieos_create());
+    auto token = check_context(writer, abieos_string_to_name(writer, "sysio.token"));
+    auto transfer = check_context(writer, abieos_string_to_name(writer, "transfer"));
+    check_context(writer, abieos_registry_set_abi_hex(writer, registry, token, tokenHexAbi));
+    check_context(writer, abieos_registry_set_abi(writer, registry, 1, packedTransactionAbi));
+    check_error(writer, "unsupported abi version",
+                [&] { return abieos_registry_set_abi(writer, registry, 8, R"({"version":"sysio::abi/9.0"})"); });
+
+    const char transfer_json[] = R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS","memo":""})";
+    const char levels_json[] = R"([{"actor":"useraaaaaaaa","permission":"active"}])";
+
+    std::vector<abieos_context*> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.push_back(check(abieos_create()));
+        check_context(readers.back(), abieos_attach_registry(readers.back(), registry));
+    }
+    // attached contexts keep the registry alive
+    abieos_registry_release(registry);
+
+    std::string type = check_context(readers[0], abieos_get_type_for_action(readers[0], token, transfer));
+    if (type != "transfer")
+        throw std::runtime_error("registry: wrong action type");
+
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(readers.size());
+    for (size_t i = 0; i < readers.size(); ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                auto* context = readers[i];
+                for (int j = 0; j < 200; ++j) {
+                    check_context(context, abieos_json_to_bin(context, token, "transfer", transfer_json));
+                    std::string hex = check_context(context, abieos_get_bin_hex(context));
+                    std::string json =
+                        check_context(context, abieos_hex_to_json(context, token, "transfer", hex.c_str()));
+                    if (json != transfer_json)
+                        throw std::runtime_error("registry: transfer mismatch");
+                    // not part of the abi; created on demand while other threads do the same
+                    check_context(context, abieos_json_to_bin(context, 1, "permission_level[]", levels_json));
+                    hex = check_context(context, abieos_get_bin_hex(context));
+                    json = check_context(context, abieos_hex_to_json(context, 1, "permission_level[]", hex.c_str()));
+                    if (json != levels_json)
+                        throw std::runtime_error("registry: permission_level[] mismatch");
+                }
+            } catch (std::exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    // replace the token abi while the readers are running
+    for (int j = 0; j < 20; ++j)
+        check_context(writer, abieos_registry_set_abi_hex(writer, registry, token, tokenHexAbi));
+    for (auto& t : threads)
+        t.join();
+    for (auto& e : errors)
+        if (!e.empty())
+            throw std::runtime_error(e);
+
+    // contracts set directly on a context take precedence over the registry
+    check_context(readers[1], abieos_set_abi(readers[1], token, packedTransactionAbi));
+    check_context(readers[1], abieos_json_to_bin(readers[1], token, "permission_level[]", levels_json));
+    check_error(readers[2], "unknown type", [&] {
+        return abieos_json_to_bin(readers[2], token, "permission_level[]", levels_json);
+    });
+
+    if (!abieos_registry_delete_contract(registry, token) ||
+        abieos_registry_delete_contract(registry, token))
+        throw std::runtime_error("registry: delete_contract");
+    check_error(readers[2], R"(contract "sysio.token" is not loaded)",
+                [&] { return abieos_json_to_bin(readers[2], token, "transfer", transfer_json); });
+
+    abieos_attach_registry(readers[3], nullptr);
+    check_error(readers[3], R"(contract "............1" is not loaded)",
+                [&] { return abieos_json_to_bin(readers[3], 1, "permission_level[]", levels_json); });
+
+    for (auto* context : readers)
+        abieos_destroy(context);
+    abieos_destroy(writer);
+}
+
+void check_batch() {
+    auto context = check(abieos_create());
+    auto token = check_context(context, abieos_string_to_name(context, "sysio.token"));
+    check_context(context, abieos_set_abi_hex(context, token, tokenHexAbi));
+    check_context(context, abieos_set_abi(context, 1, packedTransactionAbi));
+
+    const char transfer_json[] = R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS","memo":"x"})";
+    const char level_json[] = R"({"actor":"useraaaaaaaa","permission":"active"})";
+    check_context(context, abieos_json_to_bin(context, token, "transfer", transfer_json));
+    std::vector<char> transfer(abieos_get_bin_data(context),
+                               abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    check_context(context, abieos_json_to_bin(context, 1, "permission_level", level_json));
+    std::vector<char> level(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+
+    std::vector<abieos_bin_to_json_item> items{
+        {token, "transfer", transfer.data(), transfer.size()},
+        {token, "transfer", transfer.data(), transfer.size()},
+        {1, "permission_level", level.data(), level.size()},
+        {1, "no_such_type", level.data(), level.size()},
+        {99, "permission_level", level.data(), level.size()},
+        {token, "transfer", transfer.data(), transfer.size() - 1},
+        {1, "permission_level", level.data(), level.size()},
+    };
+    std::vector<abieos_batch_result> results(items.size());
+    const char* arena =
+        check_context(context, abieos_bin_to_json_batch(context, items.data(), items.size(), results.data()));
+    auto result = [&](size_t i) { return std::string(arena + results[i].offset, results[i].size); };
+
+    std::vector<abieos_error_code> expected_errors{abieos_error_none,          abieos_error_none,
+                                                   abieos_error_none,          abieos_error_unknown_type,
+                                                   abieos_error_contract_not_loaded, abieos_error_decode,
+                                                   abieos_error_none};
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (results[i].error != expected_errors[i])
+            throw std::runtime_error("batch: wrong error code for item " + std::to_string(i) + ": " + result(i));
+        if (arena[results[i].offset + results[i].size] != 0)
+            throw std::runtime_error("batch: result is not null-terminated");
+    }
+    if (result(0) != transfer_json || result(1) != transfer_json || result(2) != level_json || result(6) != level_json)
+        throw std::runtime_error("batch: json mismatch");
+    if (result(4) != R"(contract "...........a3" is not loaded)" || result(5) != "Stream overrun")
+        throw std::runtime_error("batch: wrong error message");
+
+    check_context(context, abieos_bin_to_json_batch(context, nullptr, 0, nullptr));
+    abieos_destroy(context);
+}
+
+void check_into() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, transactionAbi));
+    const char json[] = R"({"expiration":"2009-02-13T23:31:31.000","ref_block_num":1234,"ref_block_prefix":5678,)"
+                        R"("max_net_usage_words":0,"max_cpu_usage_ms":0,"delay_sec":0,"context_free_actions":[],)"
+                        R"("actions":[{"account":"sysio.token","name":"transfer","authorization":[{"actor":)"
+                        R"("useraaaaaaaa","permission":"active"}],"data":"0001"}],"transaction_extensions":[]})";
+
+    check_context(context, abieos_json_to_bin(context, 0, "transaction", json));
+    std::vector<char> bin(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    std::string hex = check_context(context, abieos_get_bin_hex(context));
+
+    // Buffers are surrounded by guard bytes which must never be touched
+    auto buffer = [](size_t size) { return std::vector<char>(size + 2, '#'); };
+    auto guarded = [](const std::vector<char>& v) { return v.front() == '#' && v.back() == '#'; };
+
+    auto bin_size = abieos_json_to_bin_into(context, 0, "transaction", json, nullptr, 0);
+    if (bin_size != (int64_t)bin.size())
+        throw std::runtime_error("json_to_bin_into: wrong size");
+    auto out = buffer(bin.size() - 3);
+    if (abieos_json_to_bin_into(context, 0, "transaction", json, out.data() + 1, bin.size() - 3) != bin_size ||
+        !guarded(out) || !std::equal(out.begin() + 1, out.end() - 1, bin.begin()))
+        throw std::runtime_error("json_to_bin_into: truncated output");
+    out = buffer(bin.size());
+    if (abieos_json_to_bin_into(context, 0, "transaction", json, out.data() + 1, bin.size()) != bin_size ||
+        !guarded(out) || !std::equal(out.begin() + 1, out.end() - 1, bin.begin()))
+        throw std::runtime_error("json_to_bin_into: output mismatch");
+    check_error(context, "Expected field",
+                [&] { return abieos_json_to_bin_into(context, 0, "transaction", "{}", nullptr, 0) >= 0; });
+
+    auto json_size = check_context(context, abieos_bin_to_json_size(context, 0, "transaction", bin.data(), bin.size()));
+    if (json_size != (int64_t)strlen(json))
+        throw std::runtime_error("bin_to_json_size: wrong size");
+    out = buffer(json_size + 1);
+    if (abieos_bin_to_json_into(context, 0, "transaction", bin.data(), bin.size(), out.data() + 1, json_size + 1) !=
+            json_size ||
+        !guarded(out) || std::string(out.data() + 1) != json)
+        throw std::runtime_error("bin_to_json_into: output mismatch");
+    out = buffer(json_size);
+    if (abieos_bin_to_json_into(context, 0, "transaction", bin.data(), bin.size(), out.data() + 1, json_size) !=
+            json_size ||
+        !guarded(out) || std::string(out.data() + 1) != std::string(json, json_size - 1))
+        throw std::runtime_error("bin_to_json_into: truncated output");
+    check_error(context, "Stream overrun", [&] {
+        return abieos_bin_to_json_into(context, 0, "transaction", bin.data(), 3, out.data() + 1, json_size) >= 0;
+    });
+
+    check_context(context, abieos_json_to_bin(context, 0, "transaction", json));
+    out = buffer(hex.size() + 1);
+    if (abieos_get_bin_hex_into(context, out.data() + 1, hex.size() + 1) != (int64_t)hex.size() || !guarded(out) ||
+        std::string(out.data() + 1) != hex)
+        throw std::runtime_error("get_bin_hex_into: output mismatch");
+    out = buffer(0);
+    if (abieos_get_bin_hex_into(context, out.data() + 1, 0) != (int64_t)hex.size() || !guarded(out))
+        throw std::runtime_error("get_bin_hex_into: empty buffer");
+
+    abieos_destroy(context);
+}
+
+void check_handles() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, transactionAbi));
+    const char json[] = R"({"actor":"useraaaaaaaa","permission":"active"})";
+    const char reordered[] = R"({"permission":"active","actor":"useraaaaaaaa"})";
+
+    auto handle = check_context(context, abieos_get_type_handle(context, 0, "permission_level"));
+    if (abieos_get_type_handle(context, 0, "permission_level") != handle)
+        throw std::runtime_error("type handle is not stable");
+    check_error(context, "unknown type", [&] { return abieos_get_type_handle(context, 0, "not_a_type"); });
+    check_error(context, "is not loaded", [&] { return abieos_get_type_handle(context, 1, "permission_level"); });
+    check_error(context, "type handle is null", [&] { return abieos_handle_json_to_bin(context, nullptr, json); });
+
+    for (int i = 0; i < 3; ++i) {
+        check_context(context, abieos_handle_json_to_bin(context, handle, json));
+        std::vector<char> bin(abieos_get_bin_data(context),
+                              abieos_get_bin_data(context) + abieos_get_bin_size(context));
+        check_context(context, abieos_json_to_bin(context, 0, "permission_level", json));
+        if (bin != std::vector<char>(abieos_get_bin_data(context),
+                                     abieos_get_bin_data(context) + abieos_get_bin_size(context)))
+            throw std::runtime_error("handle_json_to_bin: output mismatch");
+        check_context(context, abieos_handle_json_to_bin_reorderable(context, handle, reordered));
+        if (bin != std::vector<char>(abieos_get_bin_data(context),
+                                     abieos_get_bin_data(context) + abieos_get_bin_size(context)))
+            throw std::runtime_error("handle_json_to_bin_reorderable: output mismatch");
+        if (std::string(check_context(context, abieos_handle_bin_to_json(context, handle, bin.data(), bin.size()))) !=
+            json)
+            throw std::runtime_error("handle_bin_to_json: output mismatch");
+        char out[sizeof(json)];
+        if (abieos_handle_bin_to_json_into(context, handle, bin.data(), bin.size(), out, sizeof(out)) !=
+                (int64_t)strlen(json) ||
+            std::string(out) != json)
+            throw std::runtime_error("handle_bin_to_json_into: output mismatch");
+        check_error(context, "Stream overrun",
+                    [&] { return abieos_handle_bin_to_json(context, handle, bin.data(), bin.size() - 1); });
+    }
+
+    abieos_destroy(context);
+}
+
+void check_typed_decode() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, R"({
+        "version": "sysio::abi/1.1",
+        "types": [{"new_type_name": "amount", "type": "uint32"}],
+        "structs": [{"name": "pay", "base": "", "fields": [{"name": "to", "type": "name"},
+                        {"name": "n", "type": "amount"}]}],
+        "actions": [{"name": "pay", "type": "pay", "ricardian_contract": ""},
+                    {"name": "broken", "type": "missing", "ricardian_contract": ""}],
+        "tables": [{"name": "amounts", "index_type": "i64", "key_names": [], "key_types": [], "type": "amount[]"}],
+        "action_results": [{"name": "pay", "result_type": "amount"}]
+    })"));
+    auto name = [&](const char* s) { return check_context(context, abieos_string_to_name(context, s)); };
+
+    const char pay_json[] = R"({"to":"useraaaaaaaa","n":7})";
+    check_context(context, abieos_json_to_bin(context, 0, "pay", pay_json));
+    std::vector<char> pay(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    if (std::string(check_context(
+            context, abieos_action_bin_to_json(context, 0, name("pay"), pay.data(), pay.size()))) != pay_json)
+        throw std::runtime_error("action_bin_to_json: output mismatch");
+
+    const char amounts[] = {2, 1, 0, 0, 0, 2, 0, 0, 0};
+    if (std::string(check_context(
+            context, abieos_table_bin_to_json(context, 0, name("amounts"), amounts, sizeof(amounts)))) != "[1,2]")
+        throw std::runtime_error("table_bin_to_json: output mismatch");
+    if (std::string(check_context(
+            context, abieos_action_result_bin_to_json(context, 0, name("pay"), amounts + 1, 4))) != "1")
+        throw std::runtime_error("action_result_bin_to_json: output mismatch");
+
+    check_error(context, R"(contract "" does not have action "nope")",
+                [&] { return abieos_action_bin_to_json(context, 0, name("nope"), pay.data(), pay.size()); }, true);
+    check_error(context, R"(contract "" does not have table "pay")",
+                [&] { return abieos_table_bin_to_json(context, 0, name("pay"), pay.data(), pay.size()); }, true);
+    check_error(context, R"(contract "" does not have action_result "amounts")",
+                [&] { return abieos_action_result_bin_to_json(context, 0, name("amounts"), amounts, 4); }, true);
+    check_error(context, "Unknown type",
+                [&] { return abieos_action_bin_to_json(context, 0, name("broken"), pay.data(), pay.size()); }, true);
+    check_error(context, "Stream overrun",
+                [&] { return abieos_action_result_bin_to_json(context, 0, name("pay"), amounts, 3); });
+    check_error(context, R"(contract "............1" is not loaded)",
+                [&] { return abieos_action_bin_to_json(context, 1, name("pay"), pay.data(), pay.size()); }, true);
+
+    abieos_destroy(context);
+}
+
+void check_error_report() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, R"({
+        "version": "sysio::abi/1.1",
+        "structs": [
+            {"name": "transfer", "base": "", "fields": [{"name": "from", "type": "name"},
+                {"name": "quantity", "type": "asset"}, {"name": "memo", "type": "string"}]},
+            {"name": "batch", "base": "", "fields": [{"name": "transfers", "type": "transfer[]"},
+                {"name": "pick", "type": "choice"}]}
+        ],
+        "variants": [{"name": "choice", "types": ["uint8", "transfer"]}]
+    })"));
+    auto check_report = [&](abieos_error_kind kind, size_t offset, const std::string& path) {
+        abieos_error_report report;
+        check_context(context, abieos_get_error_report(context, &report));
+        if (report.kind != kind || report.offset != offset || report.path != path)
+            throw std::runtime_error("error report: got " + std::to_string(report.kind) + " at " +
+                                     std::to_string(report.offset) + " " + report.path + ", expected " + path);
+    };
+
+    const std::string transfer = R"({"from":"alice","quantity":"1.0000 SYS","memo":"hi"})";
+    const std::string batch =
+        R"({"transfers":[)" + transfer + "," + transfer + R"(],"pick":["transfer",)" + transfer + "]}";
+    check_context(context, abieos_json_to_bin(context, 0, "batch", batch.c_str()));
+    std::vector<char> bin(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    if (bin.size() != 83)
+        throw std::runtime_error("error report: unexpected binary size");
+
+    check_error(context, "Stream overrun",
+                [&] { return abieos_bin_to_json(context, 0, "transfer", bin.data() + 1, 20); }, true);
+    check_report(abieos_error_kind_overrun, 8, "transfer.quantity");
+    check_error(context, "Stream overrun", [&] { return abieos_bin_to_json(context, 0, "batch", bin.data(), 38); },
+                true);
+    check_report(abieos_error_kind_overrun, 36, "batch.transfers[1].quantity");
+    check_error(context, "Stream overrun", [&] { return abieos_bin_to_json(context, 0, "batch", bin.data(), 78); },
+                true);
+    check_report(abieos_error_kind_overrun, 64, "batch.pick.transfer.quantity");
+
+    auto bad_index = bin;
+    bad_index[55] = 5;
+    check_error(context, "Bad variant index",
+                [&] { return abieos_bin_to_json(context, 0, "batch", bad_index.data(), bad_index.size()); }, true);
+    check_report(abieos_error_kind_bad_variant_index, 55, "batch.pick");
+
+    const char bad_varuint[] = "\xff\xff\xff\xff\xff\xff";
+    check_error(context, "Invalid varuint encoding",
+                [&] { return abieos_bin_to_json(context, 0, "batch", bad_varuint, sizeof(bad_varuint) - 1); }, true);
+    check_report(abieos_error_kind_invalid_varuint, 0, "batch.transfers");
+
+    const std::string bad_json = R"({"transfers":[)" + transfer + R"(,{"from":"alice","quantity":true}]})";
+    check_error(context, "Expected string", [&] { return abieos_json_to_bin(context, 0, "batch", bad_json.c_str()); },
+                true);
+    check_report(abieos_error_kind_json, bad_json.find("true") + 4, "batch.transfers[1].quantity");
+
+    check_error(context, "Unknown type", [&] { return abieos_bin_to_json(context, 0, "nope", bin.data(), bin.size()); },
+                true);
+    check_report(abieos_error_kind_other, 0, "");
+
+    // A webauthn signature is accepted exactly when from_bin accepts it, however its auth_data size is encoded
+    for (std::string auth_size : {std::string(1, '\0'), std::string("\x80\x80\x80\x80\x80\x00", 6),
+                                  std::string("\x80\x80\x80\x80\x10", 5)}) {
+        std::string sig = '\x02' + std::string(65, '\0') + auth_size + '\0';
+        bool expected = true;
+        try {
+            sysio::input_stream in{sig.data(), sig.size()};
+            sysio::signature s;
+            from_bin(s, in);
+        } catch (std::exception&) {
+            expected = false;
+        }
+        if (!!abieos_bin_to_json(context, 0, "signature", sig.data(), sig.size()) != expected)
+            throw std::runtime_error("error report: webauthn signature checked differently from from_bin");
+    }
+
+    // A bitset whose number of blocks doesn't fit in 32 bits
+    const char huge_bitset[] = "\xff\xff\xff\xff\x0f";
+    check_error(context, "conversion error",
+                [&] { return abieos_bin_to_json(context, 0, "bitset", huge_bitset, sizeof(huge_bitset) - 1); }, true);
+    check_report(abieos_error_kind_other, 0, "bitset");
+
+    abieos_destroy(context);
+}
+
+void check_scratch() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, R"({
+        "version": "sysio::abi/1.1",
+        "structs": [
+            {"name": "transfer", "base": "", "fields": [{"name": "from", "type": "name"},
+                {"name": "to", "type": "name"},
+                {"name": "quantity", "type": "asset"}, {"name": "memo", "type": "string"}]},
+            {"name": "transfers", "base": "", "fields": [{"name": "items", "type": "transfer[]"},
+                {"name": "note", "type": "string?"}]}
+        ]
+    })"));
+    const std::string transfer =
+        R"({"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"a memo which doesn't fit in a small string"})";
+    const std::string json = R"({"items":[)" + transfer + "," + transfer + "," + transfer + R"(],"note":null})";
+    auto type = check_context(context, abieos_get_type_handle(context, 0, "transfers"));
+    std::vector<char> bin;
+    auto convert = [&] {
+        check_context(context, abieos_handle_json_to_bin(context, type, json.c_str()));
+        bin.assign(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+        if (check_context(context, abieos_handle_bin_to_json(context, type, bin.data(), bin.size())) != json)
+            throw std::runtime_error("scratch: output mismatch");
+        check_context(context, abieos_json_to_bin(context, 0, "transfers", json.c_str()));
+        if (check_context(context, abieos_bin_to_json(context, 0, "transfers", bin.data(), bin.size())) != json)
+            throw std::runtime_error("scratch: output mismatch");
+    };
+
+    convert();
+    auto before = heap_allocations.load();
+    for (int i = 0; i < 100; ++i)
+        convert();
+    if (auto n = heap_allocations - before)
+        throw std::runtime_error("scratch: steady-state conversions made " + std::to_string(n) + " heap allocations");
+
+    abieos_reset_scratch(context);
+    convert();
+    abieos_destroy(context);
+}
+
+// Converting through compiled programs gives the same output and errors as converting through the serializers
+void check_programs() {
+    sysio::abi_def def;
+    std::string abi_json{testAbi};
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi compiled_abi, serializer_abi;
+    convert(def, compiled_abi);
+    convert(def, serializer_abi);
+    for (auto& [_, type] : serializer_abi.abi_types)
+        type.program.clear();
+    // Derived types such as "v1?" are compiled by the thread-safe lookup only
+    const sysio::abi& compiled = compiled_abi;
+
+    abieos::conversion_scratch scratch;
+    auto check_same = [&](const char* type_name, const std::string& json) {
+        auto* a = compiled.get_type(type_name);
+        auto* b = serializer_abi.get_type(type_name);
+        if (a->program.empty() || !b->program.empty())
+            throw std::runtime_error(std::string("programs: unexpected program for ") + type_name);
+        auto same_error = [](const abieos::conversion_error& x, const abieos::conversion_error& y) {
+            return x.kind == y.kind && x.offset == y.offset && x.path == y.path && x.message == y.message;
+        };
+        std::vector<char> bin_a, bin_b;
+        abieos::conversion_error error_a, error_b;
+        bool ok_a = abieos::json_to_bin(bin_a, a, json, [] {}, scratch, error_a);
+        bool ok_b = abieos::json_to_bin(bin_b, b, json, [] {}, scratch, error_b);
+        if (ok_a != ok_b || bin_a != bin_b || !same_error(error_a, error_b))
+            throw std::runtime_error("programs: json_to_bin mismatch for " + json);
+        for (size_t size = 0; ok_a && size <= bin_a.size(); ++size) {
+            sysio::input_stream in_a{bin_a.data(), size}, in_b{bin_b.data(), size};
+            std::string json_a, json_b;
+            abieos::conversion_error error_a, error_b;
+            bool ok_a = abieos::bin_to_json(in_a, a, json_a, [] {}, scratch, error_a);
+            bool ok_b = abieos::bin_to_json(in_b, b, json_b, [] {}, scratch, error_b);
+            if (ok_a != ok_b || json_a != json_b || in_a.pos - bin_a.data() != in_b.pos - bin_b.data() ||
+                !same_error(error_a, error_b))
+                throw std::runtime_error("programs: bin_to_json mismatch for " + json);
+
+            // Skipping accepts exactly what converting accepts, with or without programs
+            for (auto* t : {a, b}) {
+                sysio::input_stream in{bin_a.data(), size};
+                bool skipped = abieos::skip_bin(t, in, scratch) == abieos::conversion_error_kind::none;
+                if (skipped != ok_a || (ok_a && in.pos != in_a.pos))
+                    throw std::runtime_error("programs: skip_bin mismatch for " + json);
+            }
+        }
+    };
+
+    check_same("s1", R"({"x1":5})");
+    check_same("s2", R"({})");
+    check_same("s2", R"({"y1":1,"y2":2})");
+    check_same("s3", R"({"z1":1,"z2":["s2",{"y1":3}],"z3":{"y1":4}})");
+    check_same("s3", R"({"z1":1})");
+    check_same("s4", R"({"a1":null})");
+    check_same("s4", R"({"a1":5,"b1":[1,2]})");
+    check_same("s5", R"({"x1":9,"x2":10,"x3":{"c1":4,"c2":[{"x1":1,"x2":2,"x3":{"c1":3,"c2":[],"c3":5}}],"c3":6}})");
+    check_same("s5", R"({"x1":9,"x2":null})");
+    check_same("s5", R"({"x1":9,"x3":{}})");
+    check_same("s5", R"({"x1":9,"x2":10,"x3":{"c1":4,"c2":[],"c3":6},"x4":1})");
+    check_same("s8", R"({"a1":[1,27]})");
+    check_same("s8", R"({"a1":[1]})");
+    check_same("s9", R"({"a1":[{"x1":6},{"x1":16}]})");
+    check_same("v1", R"(["int8",7])");
+    check_same("v1", R"(["s1",{"x1":1}])");
+    check_same("v1", R"(["x",1])");
+    check_same("v1", R"(["int8",7,5])");
+    check_same("s5[]", R"([])");
+    check_same("v1?", R"(null)");
+    check_same("v1?", R"(["s2",{"y1":1}])");
+    check_same("s1[2]", R"([{"x1":1},{"x1":2}])");
+
+    // Deep enough to hit the recursion limit
+    std::string deep = R"({"x1":1,"x2":2,"x3":{"c1":3,"c2":[],"c3":4}})";
+    for (int i = 0; i < 50; ++i)
+        deep = R"({"x1":1,"x2":2,"x3":{"c1":3,"c2":[)" + deep + R"(],"c3":4}})";
+    check_same("s5", deep);
+}
+
+void check_json_keys() {
+    // Field and alternative names which need escaping; their keys are precomputed when the abi is converted
+    std::string abi_json = R"({
+        "version": "eosio::abi/1.1",
+        "types": [{"new_type_name": "al\"t", "type": "uint8"}],
+        "structs": [{"name": "k", "base": "", "fields": [
+            {"name": "q\"uote", "type": "uint8"},
+            {"name": "back\\slash", "type": "v"},
+            {"name": "ctl\u0001", "type": "uint8[]"},
+            {"name": "ütf", "type": "uint8"}]}],
+        "variants": [{"name": "v", "types": ["uint8", "al\"t"]}]
+    })";
+    sysio::abi_def def;
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi compiled_abi, serializer_abi;
+    convert(def, compiled_abi);
+    convert(def, serializer_abi);
+    for (auto& [_, type] : serializer_abi.abi_types)
+        type.program.clear();
+
+    auto expected = "{\"q\\\"uote\":1,\"back\\\\slash\":[\"al\\\"t\",2],\"ctl\\u0001\":[3,4],\"\xc3\xbctf\":5}";
+    abieos::conversion_scratch scratch;
+    for (auto* abi : {&compiled_abi, &serializer_abi}) {
+        auto* type = abi->get_type("k");
+        std::vector<char> bin;
+        abieos::conversion_error error;
+        if (!abieos::json_to_bin(bin, type, expected, [] {}, scratch, error))
+            throw std::runtime_error("json_keys: json_to_bin failed: " + error.message);
+        sysio::input_stream in{bin.data(), bin.size()};
+        std::string json;
+        if (!abieos::bin_to_json(in, type, json, [] {}, scratch, error) || json != expected)
+            throw std::runtime_error("json_keys: bin_to_json mismatch: " + json);
+    }
+}
+
+void check_variant_lookup() {
+    // Enough alternatives for the hashed index to have collisions
+    std::string abi_json = R"({"version": "eosio::abi/1.1", "types": [)";
+    std::string alternatives;
+    for (int i = 0; i < 64; ++i) {
+        abi_json +=
+            std::string(i ? "," : "") + R"({"new_type_name": "alt)" + std::to_string(i) + R"(", "type": "uint8"})";
+        alternatives += std::string(i ? "," : "") + R"("alt)" + std::to_string(i) + R"(")";
+    }
+    abi_json += R"(], "variants": [{"name": "v", "types": [)" + alternatives + "]}]}";
+    sysio::abi_def def;
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi compiled_abi, serializer_abi;
+    convert(def, compiled_abi);
+    convert(def, serializer_abi);
+    for (auto& [_, type] : serializer_abi.abi_types) {
+        type.program.clear();
+        type.name_index.clear();
+    }
+
+    abieos::conversion_scratch scratch;
+    for (auto* abi : {&compiled_abi, &serializer_abi}) {
+        auto* type = abi->get_type("v");
+        for (int i = 0; i < 64; ++i) {
+            auto name = "alt" + std::to_string(i);
+            if (type->find_alternative(name) != i)
+                throw std::runtime_error("variant_lookup: wrong index for " + name);
+            std::vector<char> bin;
+            abieos::conversion_error error;
+            auto json = "[\"" + name + "\"," + std::to_string(i) + "]";
+            if (!abieos::json_to_bin(bin, type, json, [] {}, scratch, error) ||
+                bin != std::vector<char>{char(i), char(i)})
+                throw std::runtime_error("variant_lookup: json_to_bin mismatch for " + name);
+            auto reordered = type->json_to_bin_reorderable("[\"" + name + "\",1]");
+            if (reordered != std::vector<char>{char(i), 1})
+                throw std::runtime_error("variant_lookup: json_to_bin_reorderable mismatch for " + name);
+        }
+        for (const char* name : {"", "alt", "alt64", "alt1 ", "Alt1"}) {
+            if (type->find_alternative(name) != -1)
+                throw std::runtime_error(std::string("variant_lookup: found ") + name);
+            std::vector<char> bin;
+            abieos::conversion_error error;
+            if (abieos::json_to_bin(bin, type, "[\"" + std::string(name) + "\",1]", [] {}, scratch, error))
+                throw std::runtime_error(std::string("variant_lookup: accepted ") + name);
+        }
+    }
+}
+
+void check_reorderable() {
+    sysio::abi_def def;
+    std::string abi_json{testAbi};
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi compiled_abi, serializer_abi;
+    convert(def, compiled_abi);
+    convert(def, serializer_abi);
+    for (auto& [_, type] : serializer_abi.abi_types) {
+        type.program.clear();
+        type.name_index.clear();
+    }
+
+    std::string many, nested;
+    for (int i = 0; i < 200; ++i)
+        many += (i ? "," : "") + std::to_string(i % 100);
+    for (int i = 0; i < 130; ++i)
+        nested += std::string(i ? "," : "") + R"({"x3":{"c3":5,"c2":[],"c1":3},"x2":)" + std::to_string(i % 100) +
+                  R"(,"x1":1})";
+
+    // Streaming conversion gives the same binary as converting the jvalue tree, and fails where that fails
+    abieos::conversion_scratch scratch;
+    auto check_same = [&](const char* type_name, const std::string& json) {
+        for (auto* abi : {&compiled_abi, &serializer_abi}) {
+            auto* type = abi->get_type(type_name);
+            std::vector<char> expected, bin{'x'};
+            bool expected_ok = true;
+            try {
+                abieos::jvalue value;
+                abieos::json_to_jvalue(value, json, [] {});
+                abieos::json_to_bin(expected, type, value, [] {});
+            } catch (std::exception&) {
+                expected_ok = false;
+            }
+            abieos::conversion_error error;
+            bool ok = abieos::json_to_bin_reorderable(bin, type, json, [] {}, scratch, error);
+            if (ok != expected_ok || bin.front() != 'x' ||
+                (ok && std::vector<char>(bin.begin() + 1, bin.end()) != expected) || (!ok && bin.size() != 1))
+                throw std::runtime_error("reorderable: mismatch for " + json.substr(0, 100));
+        }
+    };
+
+    check_same("s5", R"({"x3":{"c3":6,"c2":[{"x2":2,"x3":{"c2":[],"c1":3,"c3":5},"x1":1}],"c1":4},"x2":10,"x1":9})");
+    check_same("s5", R"({"x1":9,"x3":{"c1":4,"c2":[)" + nested + R"(],"c3":6},"x2":10})");
+    check_same("s5", R"({"junk":[1,{"a":[]}],"x1":9,"x2":10,"x3":{"c1":4,"c2":[],"c3":6},"more":null})");
+    check_same("s5", R"({"x1":1,"x2":2,"x1":9,"x3":{"c1":4,"c2":[],"c3":6}})");
+    check_same("s5", R"({"x2":2,"x2":3,"x1":1,"x3":{"c1":4,"c2":[],"c3":6}})");
+    check_same("s5", R"({"x2":2,"x3":{"c1":4,"c2":[],"c3":6}})");
+    check_same("s5", R"({"x2":2,"x1":null,"x3":{"c1":4,"c2":[],"c3":6}})");
+    check_same("s5", R"({"x2":2,"x1":1,"x3":{"c1":4,"c2":[{}],"c3":6}})");
+    check_same("s5", R"({"x2":2,"x1":1,"x3":{"c1":4,"c2":[],"c3":6}} 7)");
+    check_same("s3", R"({"z1":1})");
+    check_same("s3", R"({"z2":["s2",{"y2":2,"y1":1}],"z1":1})");
+    check_same("s3", R"({"z3":{"y1":1},"z1":2})");
+    check_same("s3", R"({"z3":{"y2":1},"z2":["int8",3],"z1":2})");
+    check_same("s4", R"({"b1":[)" + many + R"(],"a1":5})");
+    check_same("s4", R"({"b1":[)" + many + R"(],"a1":null})");
+    check_same("s4", R"({"a1":5})");
+    check_same("v1", R"(["s2",{"y2":2,"y1":1}])");
+    check_same("v1", R"(["s3",{}])");
+    check_same("v1", R"(["s1",{"x1":1},2])");
+    check_same("s8", R"({"a1":[1,2]})");
+    check_same("s8", R"({"a1":[1]})");
+    check_same("s9", R"({"a1":[{"x1":6},{"x1":16}]})");
+}
+
+void check_insitu() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, transactionAbi));
+    std::string json = R"({"expiration":"2009-02-13T23:31:31.000","ref_block_num":1234,"ref_block_prefix":5678,)"
+                       R"("max_net_usage_words":0,"max_cpu_usage_ms":0,"delay_sec":0,"context_free_actions":[],)"
+                       R"("actions":[{"account":"sysio.token","name":"transfer","authorization":[{"actor":)"
+                       R"("useraaaaaaaa","permission":"active"}],"data":"0001"}],"transaction_extensions":[]})";
+    check_context(context, abieos_json_to_bin(context, 0, "transaction", json.c_str()));
+    std::string hex = check_context(context, abieos_get_bin_hex(context));
+
+    auto padded = [](const std::string& json) {
+        std::vector<char> buffer(json.begin(), json.end());
+        buffer.insert(buffer.end(), 3, 0);
+        return buffer;
+    };
+    auto buffer = padded(json);
+    check_context(context, abieos_json_to_bin_insitu(context, 0, "transaction", buffer.data(), json.size()));
+    if (check_context(context, abieos_get_bin_hex(context)) != hex)
+        throw std::runtime_error("insitu: mismatch");
+
+    auto* handle = check_context(context, abieos_get_type_handle(context, 0, "transaction"));
+    buffer = padded(json);
+    check_context(context, abieos_handle_json_to_bin_insitu(context, handle, buffer.data(), json.size()));
+    if (check_context(context, abieos_get_bin_hex(context)) != hex)
+        throw std::runtime_error("insitu: handle mismatch");
+
+    buffer = padded(json);
+    buffer[json.size() + 2] = ' ';
+    check_error(context, "json must be followed by 3 NUL bytes",
+                [&] { return abieos_json_to_bin_insitu(context, 0, "transaction", buffer.data(), json.size()); });
+    check_error(context, "json must be followed by 3 NUL bytes",
+                [&] { return abieos_json_to_bin_insitu(context, 0, "transaction", nullptr, 0); });
+
+    std::string bad = R"({"expiration":"2009-02-13T23:31:31.000","ref_block_num":true})";
+    buffer = padded(bad);
+    check_error(context, "",
+                [&] { return abieos_json_to_bin_insitu(context, 0, "transaction", buffer.data(), bad.size()); });
+    abieos_error_report report;
+    check_context(context, abieos_get_error_report(context, &report));
+    if (report.kind != abieos_error_kind_json || std::string(report.path) != "transaction.ref_block_num" ||
+        report.offset > bad.size())
+        throw std::runtime_error("insitu: wrong error report");
+    abieos_destroy(context);
+}
+
+void check_array_sizes() {
+    std::string abi_json = R"({
+        "version": "eosio::abi/1.1",
+        "structs": [
+            {"name": "row", "base": "", "fields": [{"name": "v", "type": "uint16[]"}]},
+            {"name": "table", "base": "", "fields": [{"name": "rows", "type": "row[]"}, {"name": "n", "type": "uint8"}]}
+        ]
+    })";
+    sysio::abi_def def;
+    sysio::json_token_stream stream(abi_json.data());
+    from_json(def, stream);
+    sysio::abi compiled_abi, serializer_abi;
+    convert(def, compiled_abi);
+    convert(def, serializer_abi);
+    for (auto& [_, type] : serializer_abi.abi_types)
+        type.program.clear();
+
+    // Sizes around each varuint length, nested so inner sizes are patched before outer ones
+    std::string json = R"({"rows":[)";
+    int rows = 0;
+    for (int size : {0, 1, 127, 128, 300, 16383, 16384, 5}) {
+        json += std::string(rows++ ? "," : "") + R"({"v":[)";
+        for (int i = 0; i < size; ++i)
+            json += (i ? "," : "") + std::to_string(i);
+        json += "]}";
+    }
+    for (; rows < 200; ++rows)
+        json += R"(,{"v":[1,2]})";
+    json += R"(],"n":7})";
+
+    abieos::conversion_scratch scratch;
+    for (auto* abi : {&compiled_abi, &serializer_abi}) {
+        auto* type = abi->get_type("table");
+        abieos::jvalue value;
+        abieos::json_to_jvalue(value, json, [] {});
+        std::vector<char> expected, bin{'x'};
+        abieos::json_to_bin(expected, type, value, [] {});
+        abieos::conversion_error error;
+        if (!abieos::json_to_bin(bin, type, json, [] {}, scratch, error) || bin.front() != 'x' ||
+            std::vector<char>(bin.begin() + 1, bin.end()) != expected)
+            throw std::runtime_error("array_sizes: json_to_bin mismatch");
+
+        std::vector<char> out(expected.size());
+        sysio::truncating_buf_stream into{out.data(), out.size()};
+        if (!abieos::json_to_bin(into, type, json, [] {}, scratch, error) || into.size != expected.size() ||
+            out != expected)
+            throw std::runtime_error("array_sizes: truncating_buf_stream mismatch");
+
+        bin = {'x'};
+        if (!abieos::json_to_bin_reorderable(bin, type, json, [] {}, scratch, error) ||
+            std::vector<char>(bin.begin() + 1, bin.end()) != expected)
+            throw std::runtime_error("array_sizes: json_to_bin_reorderable mismatch");
+
+        // Failures leave the output as it was
+        bin = {'x'};
+        if (abieos::json_to_bin(bin, type, json.substr(0, json.size() - 2) + R"("x"})", [] {}, scratch, error) ||
+            bin != std::vector<char>{'x'})
+            throw std::runtime_error("array_sizes: failed conversion wrote output");
+    }
+}
+
+template <typename Stream>
+std::string json_tokens(std::string json) {
+    Stream stream(json.data());
+    std::string result;
+    do {
+        auto& t = stream.peek_token().get();
+        switch (t.type) {
+        case sysio::json_token_type::type_null: result += "n "; break;
+        case sysio::json_token_type::type_bool: result += t.value_bool ? "t " : "f "; break;
+        case sysio::json_token_type::type_string: result += "s" + std::string(t.value_string) + " "; break;
+        case sysio::json_token_type::type_key: result += "k" + std::string(t.key) + " "; break;
+        default: result += std::to_string(int(t.type)) + " ";
+        }
+        stream.eat_token();
+    } while (!stream.complete());
+    stream.get_end();
+    return result;
+}
+
+void check_json_tokenizer() {
+    using sysio::json_scan::isa;
+    // Documents with the tokens expected of them, written out so they don't depend on the rapidjson a build uses:
+    // 4/6 and 7/8 start and end objects and arrays, and numbers are strings of their text
+    std::vector<std::pair<std::string, std::string>> valid = {
+        {"{}", "4 6 "},
+        {"[]", "7 8 "},
+        {R"("")", "s "},
+        {"0", "s0 "},
+        {"-0", "s-0 "},
+        {"-1.5e+10", "s-1.5e+10 "},
+        {"2E-3", "s2E-3 "},
+        {"true", "t "},
+        {"false", "f "},
+        {"null", "n "},
+        {" \t\r\n[ 1 , 2 ] \n", "7 s1 s2 8 "},
+        {R"({"a":{"b":[{},[],{"c":null}]},"d":"e"})", "4 ka 4 kb 7 4 6 7 8 4 kc n 6 8 6 kd se 6 "},
+        {R"(["\"\\\/\b\f\n\r\t", "Aé中😀", "\u0000x"])", std::string("7 s\"\\/\b\f\n\r\t sAé中😀 s") + '\0' + "x 8 "},
+        {"[\"\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\xef\xbf\xbf\xf4\x8f\xbf\xbf\"]",
+         "7 s\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\xef\xbf\xbf\xf4\x8f\xbf\xbf 8 "},
+    };
+    for (size_t shift = 0; shift < 140; ++shift)
+        valid.push_back({"{\"k\":[" + std::string(shift, ' ') +
+                             R"("x\\\\\"y\\", 123456789, "é漢😀", true, {"n":null}, -0.5e-3, "é😀\n"],)" +
+                             std::string(shift % 7, '\n') + R"("l":")" + std::string(shift, '\\') +
+                             std::string(shift, '\\') + R"("})",
+                         "4 kk 7 sx\\\\\"y\\ s123456789 sé漢😀 t 4 kn n 6 s-0.5e-3 sé😀\n 8 kl s" +
+                             std::string(shift, '\\') + " 6 "});
+
+    std::vector<std::string> invalid = {
+        "", "  ", "{", "[", "[1,]", R"({"a"})", R"({"a":})", "{,}", "[1 2]", "01", "1.", "1e", "-", "+1", "tru",
+        "nul", "truex", "[nan]", R"("abc)", R"("\x")", R"("\u12g4")", R"("\ud800")", R"("\udc00")",
+        R"("\ud800A")", "\"\x01\"", "\"\xff\"", "\"\xc3\"", "\"\xe0\x80\x80\"", "\"\xed\xa0\x80\"",
+        "\"\xf4\x90\x80\x80\"", "\"\xc0\xaf\"", "[\xc3\xa9]", "{} {}", "[}", "{]", "]", R"({"a":1])", R"({"a" 1})",
+        R"({1:2})", R"(["a" "b"])",
+    };
+    for (size_t shift = 0; shift < 70; ++shift) {
+        invalid.push_back(std::string(shift, ' ') + "[\"\xe4\xb8\" ]");
+        invalid.push_back(std::string(shift, ' ') + "[\"\xe4\xb8\xad\xad\"]");
+        invalid.push_back(std::string(shift, ' ') + "[\"abc\x1f\"]");
+        invalid.push_back(std::string(shift, ' ') + R"(["abc\"])");
+    }
+
+    for (auto level : { isa::portable, isa::sse2, isa::avx2 }) {
+        if (!sysio::json_scan::select_isa(level))
+            continue;
+        for (auto& [json, expected] : valid) {
+            auto tokens = json_tokens<sysio::json_token_stream>(json);
+            if (tokens != expected || json_tokens<sysio::rapidjson_token_stream>(json) != expected)
+                throw std::runtime_error("json tokenizer: " + json + " gave " + tokens + ", expected " + expected);
+        }
+        for (auto& json : invalid) {
+            bool failed = false;
+            try {
+                json_tokens<sysio::json_token_stream>(json);
+            } catch (std::exception&) {
+                failed = true;
+            }
+            if (!failed)
+                throw std::runtime_error("json tokenizer: accepted " + json);
+        }
+    }
+    sysio::json_scan::select_isa(sysio::json_scan::best_isa());
+
+    check_except("The document is empty", [] { json_tokens<sysio::json_token_stream>(" "); }, true);
+    check_except("Missing a colon after a name of object member",
+                 [] { json_tokens<sysio::json_token_stream>(R"({"a" 1})"); }, true);
+    check_except("Invalid encoding in string", [] { json_tokens<sysio::json_token_stream>("\"\xc3(\""); }, true);
+    check_except("The surrogate pair in string is invalid",
+                 [] { json_tokens<sysio::json_token_stream>(R"("\ud800x")"); }, true);
+
+    // Nesting outgrows both the caller's buffer and the stream's own storage
+    std::string deep = std::string(5000, '[') + std::string(5000, ']');
+    char buffer[16];
+    sysio::json_token_stream stream(deep.data(), deep.size(), buffer, sizeof(buffer));
+    for (size_t i = 0; i < deep.size(); ++i) {
+        if (i < 5000)
+            stream.get_start_array();
+        else
+            stream.get_end_array();
+    }
+    stream.get_end();
+    deep = std::string(5000, '[') + std::string(5000, ']');
+    std::string deep_tokens;
+    for (int i = 0; i < 5000; ++i)
+        deep_tokens += "7 ";
+    for (int i = 0; i < 5000; ++i)
+        deep_tokens += "8 ";
+    if (json_tokens<sysio::json_token_stream>(deep) != deep_tokens ||
+        json_tokens<sysio::rapidjson_token_stream>(deep) != deep_tokens)
+        throw std::runtime_error("json tokenizer: deep nesting");
+}
+
+// from_json_int before it converted several digits per step
+template <typename T>
+std::string per_digit_int(T& result, std::string_view r) {
+    auto pos = r.data();
+    auto end = pos + r.size();
+    bool found = false;
+    result = 0;
+    T limit, sign;
+    if (std::is_signed_v<T> && pos != end && *pos == '-') {
+        ++pos;
+        sign = -1;
+        limit = std::numeric_limits<T>::min();
+    } else {
+        sign = 1;
+        limit = std::numeric_limits<T>::max();
+    }
+    while (pos != end && *pos >= '0' && *pos <= '9') {
+        T digit = (*pos++ - '0');
+        if ((std::is_signed_v<T> && (-sign * limit + digit) / 10 > -sign * result) ||
+            (!std::is_signed_v<T> && (limit - digit) / 10 < result))
+            return "number is out of range";
+        result = result * 10 + sign * digit;
+        found = true;
+    }
+    return pos == end && found ? "" : "Expected integer";
+}
+
+struct string_token_stream {
+    std::string_view value;
+    std::string_view get_string() { return value; }
+};
+
+template <typename T>
+void check_decimal_int(const std::vector<std::string>& inputs) {
+    for (auto& input : inputs) {
+        T expected, result;
+        auto expected_error = per_digit_int(expected, input);
+        std::string error;
+        try {
+            string_token_stream stream{input};
+            sysio::from_json_int(result, stream);
+        } catch (std::exception& e) {
+            error = e.what();
+        }
+        if (error != expected_error || (error.empty() && result != expected))
+            throw std::runtime_error("decimal int: " + input + " gave " +
+                                     (error.empty() ? "a different value" : error) + ", expected " +
+                                     (expected_error.empty() ? "a value" : expected_error));
+    }
+}
+
+std::string unsigned_decimal(unsigned __int128 x) {
+    std::string result;
+    do {
+        result.insert(result.begin(), '0' + int(x % 10));
+        x /= 10;
+    } while (x);
+    return result;
+}
+
+// Adds 1 to a string of digits
+std::string decimal_successor(std::string s) {
+    size_t i = s.size();
+    while (i && s[i - 1] == '9')
+        s[--i] = '0';
+    return i ? (++s[i - 1], s) : "1" + s;
+}
+
+void check_decimal_ints() {
+    std::vector<std::string> inputs = {"", "-", "+1", "-0", "0", "00000000000000000000000000000000000000000000000042",
+                                       "1x", "x1", " 1", "1 ", "12345678a", "1234567890123456x", "--1", "0-"};
+    uint64_t x = 0x9e3779b97f4a7c15;
+    auto random = [&] {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    };
+    for (auto limit : {unsigned_decimal(uint64_t(-1)), unsigned_decimal(~(unsigned __int128)0)}) {
+        for (auto& s : {limit, decimal_successor(limit), limit + "0", limit.substr(1)}) {
+            inputs.push_back(s);
+            inputs.push_back(s + "x");
+            inputs.push_back("0000" + s);
+        }
+    }
+    for (int bits : {8, 16, 32, 64, 127}) {
+        auto max = unsigned_decimal(((unsigned __int128)1 << bits) - 1);
+        auto min = unsigned_decimal((unsigned __int128)1 << bits);
+        for (auto& s : {max, decimal_successor(max), min, decimal_successor(min)}) {
+            inputs.push_back(s);
+            inputs.push_back("-" + s);
+            inputs.push_back("-" + s + "x");
+        }
+    }
+    for (int i = 0; i < 5000; ++i) {
+        std::string s = random() % 4 ? "" : "-";
+        size_t n = random() % 45;
+        for (size_t j = 0; j < n; ++j)
+            s += char('0' + random() % 10);
+        if (n && random() % 5 == 0)
+            s[random() % s.size()] = "x/:- "[random() % 5];
+        inputs.push_back(s);
+    }
+
+    check_decimal_int<uint8_t>(inputs);
+    check_decimal_int<int8_t>(inputs);
+    check_decimal_int<uint16_t>(inputs);
+    check_decimal_int<int16_t>(inputs);
+    check_decimal_int<uint32_t>(inputs);
+    check_decimal_int<int32_t>(inputs);
+    check_decimal_int<uint64_t>(inputs);
+    check_decimal_int<int64_t>(inputs);
+#ifndef ABIEOS_NO_INT128
+    check_decimal_int<unsigned __int128>(inputs);
+    check_decimal_int<__int128>(inputs);
+#endif
+
+    // The byte-array version used without native 128-bit integers
+    for (auto& input : inputs) {
+        if (!input.empty() && input[0] == '-')
+            continue;
+        unsigned __int128 expected;
+        auto expected_error = per_digit_int(expected, input);
+        if (input.empty())
+            expected_error = "", expected = 0;
+        std::array<uint8_t, 16> result;
+        std::string error;
+        try {
+            abieos::decimal_to_binary(result, input);
+        } catch (std::exception& e) {
+            error = e.what();
+        }
+        if (error != expected_error || (error.empty() && memcmp(result.data(), &expected, 16)))
+            throw std::runtime_error("decimal_to_binary: " + input);
+    }
+}
+
+void check_fixed_size() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, R"({
+        "version": "sysio::abi/1.1",
+        "structs": [
+            {"name": "permission_level", "base": "", "fields": [{"name": "actor", "type": "name"},
+                {"name": "permission", "type": "name"}]},
+            {"name": "transfer", "base": "", "fields": [{"name": "from", "type": "name"},
+                {"name": "to", "type": "name"},
+                {"name": "quantity", "type": "asset"}, {"name": "memo", "type": "string"}]},
+            {"name": "action", "base": "", "fields": [{"name": "auth", "type": "permission_level[]"},
+                {"name": "data", "type": "transfer"}, {"name": "fee", "type": "extended_asset"},
+                {"name": "levels", "type": "permission_level[2]"}]},
+            {"name": "empty", "base": "", "fields": []},
+            {"name": "extended", "base": "permission_level", "fields": [{"name": "note", "type": "string$"}]}
+        ]
+    })"));
+    auto type = [&](const char* name) { return check_context(context, abieos_get_type_handle(context, 0, name)); };
+    auto fixed_size = [&](const char* name) {
+        return reinterpret_cast<const sysio::abi_type*>(type(name))->fixed_size;
+    };
+    if (fixed_size("permission_level") != 16 || fixed_size("extended_asset") != 24 || fixed_size("empty") != 0 ||
+        fixed_size("permission_level[2]") != 32 || fixed_size("uint16") != 2)
+        throw std::runtime_error("fixed size: wrong size");
+    for (auto name : {"transfer", "action", "extended", "permission_level[]", "permission_level?", "string"})
+        if (fixed_size(name) != sysio::abi_variable_size)
+            throw std::runtime_error(std::string("fixed size: ") + name + " should be variable");
+    auto* transfer = reinterpret_cast<const sysio::abi_type*>(type("transfer"))->as_struct();
+    if (transfer->fields[2].offset != 16 || transfer->fields[3].offset != 32)
+        throw std::runtime_error("fixed size: wrong offset");
+
+    const std::string json = R"({"auth":[{"actor":"alice","permission":"active"},)"
+                             R"({"actor":"bob","permission":"owner"}],)"
+                             R"("data":{"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"hi"},)"
+                             R"("fee":{"quantity":"0.0100 SYS","contract":"sysio.token"},)"
+                             R"("levels":[{"actor":"carol","permission":"active"},)"
+                             R"({"actor":"dave","permission":"active"}]})";
+    check_context(context, abieos_json_to_bin(context, 0, "action", json.c_str()));
+    std::vector<char> bin(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+
+    auto locate = [&](const char* path, size_t expected_offset, size_t expected_size, const char* expected_json) {
+        size_t offset, size;
+        abieos_type_handle field_type;
+        check_context(context, abieos_handle_locate_field(context, type("action"), bin.data(), bin.size(), path,
+                                                          &offset, &size, &field_type));
+        if (offset != expected_offset || size != expected_size)
+            throw std::runtime_error(std::string("locate field: ") + path + " at " + std::to_string(offset) + "+" +
+                                     std::to_string(size));
+        if (std::string(check_context(context, abieos_handle_bin_to_json(context, field_type, bin.data() + offset,
+                                                                         size))) != expected_json)
+            throw std::runtime_error(std::string("locate field: ") + path + " json");
+    };
+    locate("auth", 0, 33, R"([{"actor":"alice","permission":"active"},{"actor":"bob","permission":"owner"}])");
+    locate("data", 33, 35, R"({"from":"alice","to":"bob","quantity":"1.0000 SYS","memo":"hi"})");
+    locate("data.quantity", 49, 16, R"("1.0000 SYS")");
+    locate("data.memo", 65, 3, R"("hi")");
+    locate("fee.contract", 84, 8, R"("sysio.token")");
+    locate("levels", 92, 32, R"([{"actor":"carol","permission":"active"},{"actor":"dave","permission":"active"}])");
+
+    size_t offset, size;
+    auto locate_error = [&](const char* path, size_t bin_size) {
+        return abieos_handle_locate_field(context, type("action"), bin.data(), bin_size, path, &offset, &size, nullptr);
+    };
+    check_error(context, "unknown field", [&] { return locate_error("data.nope", bin.size()); }, true);
+    check_error(context, "type is not a struct", [&] { return locate_error("data.memo.x", bin.size()); }, true);
+    check_error(context, "Stream overrun", [&] { return locate_error("levels", 110); }, true);
+    abieos_error_report report;
+    check_context(context, abieos_get_error_report(context, &report));
+    if (report.kind != abieos_error_kind_overrun || report.path != std::string("levels"))
+        throw std::runtime_error("locate field: wrong error report");
+    abieos_destroy(context);
+}
+
+void check_validate() {
+    auto context = check(abieos_create());
+    check_context(context, abieos_set_abi(context, 0, R"({
+        "version": "sysio::abi/1.1",
+        "structs": [
+            {"name": "transfer", "base": "", "fields": [{"name": "from", "type": "name"},
+                {"name": "quantity", "type": "asset"}, {"name": "memo", "type": "string"}]},
+            {"name": "batch", "base": "", "fields": [{"name": "transfers", "type": "transfer[]"},
+                {"name": "pick", "type": "choice"}]},
+            {"name": "ext", "base": "", "fields": [{"name": "a", "type": "uint8"}, {"name": "b", "type": "uint8$"}]}
+        ],
+        "variants": [{"name": "choice", "types": ["uint8", "transfer"]}]
+    })"));
+    const std::string transfer = R"({"from":"alice","quantity":"1.0000 SYS","memo":"hi"})";
+    const std::string batch =
+        R"({"transfers":[)" + transfer + "," + transfer + R"(],"pick":["transfer",)" + transfer + "]}";
+    check_context(context, abieos_json_to_bin(context, 0, "batch", batch.c_str()));
+    std::vector<char> bin(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+
+    size_t consumed = 0;
+    check_context(context, abieos_validate_bin(context, 0, "batch", bin.data(), bin.size(), &consumed));
+    if (consumed != bin.size())
+        throw std::runtime_error("validate: wrong size");
+    auto longer = bin;
+    longer.push_back(0);
+    check_context(context, abieos_validate_bin(context, 0, "batch", longer.data(), longer.size(), &consumed));
+    if (consumed != bin.size())
+        throw std::runtime_error("validate: wrong size with trailing data");
+    check_context(context, abieos_validate_bin(context, 0, "ext", "\x01", 1, &consumed));
+    if (consumed != 1)
+        throw std::runtime_error("validate: wrong size without extension");
+
+    // Malformed input is reported like abieos_bin_to_json reports it
+    auto same_report = [&](const std::vector<char>& data, size_t size) {
+        bool converted = abieos_bin_to_json(context, 0, "batch", data.data(), size);
+        abieos_error_report expected;
+        check_context(context, abieos_get_error_report(context, &expected));
+        std::string expected_path = expected.path;
+        bool validated = abieos_validate_bin(context, 0, "batch", data.data(), size, nullptr);
+        abieos_error_report report;
+        check_context(context, abieos_get_error_report(context, &report));
+        if (converted != validated || report.kind != expected.kind || report.offset != expected.offset ||
+            report.path != expected_path)
+            throw std::runtime_error("validate: got " + std::string(report.path) + " at " +
+                                     std::to_string(report.offset) + ", expected " + expected_path + " at " +
+                                     std::to_string(expected.offset));
+    };
+    for (size_t size = 0; size < bin.size(); ++size)
+        same_report(bin, size);
+    auto bad_index = bin;
+    bad_index[55] = 5;
+    same_report(bad_index, bad_index.size());
+    check_error(context, "Bad variant index",
+                [&] { return abieos_validate_bin(context, 0, "batch", bad_index.data(), bad_index.size(), nullptr); },
+                true);
+    abieos_destroy(context);
+}
+
+void check_abi_dedup() {
+    auto context = check(abieos_create());
+    auto stats = [&] {
+        abieos_abi_stats result;
+        check_context(context, abieos_get_abi_stats(context, &result));
+        return result;
+    };
+    const char level_json[] = R"({"actor":"useraaaaaaaa","permission":"active"})";
+    auto token_size = strlen(tokenHexAbi) / 2;
+
+    for (uint64_t contract = 1; contract <= 3; ++contract)
+        check_context(context, abieos_set_abi_hex(context, contract, tokenHexAbi));
+    check_context(context, abieos_set_abi(context, 4, transactionAbi));
+    check_context(context, abieos_set_abi(context, 5, transactionAbi));
+    auto s = stats();
+    if (s.abis_compiled != 2 || s.abis_deduplicated != 3 || s.bytes_saved != 2 * token_size + strlen(transactionAbi))
+        throw std::runtime_error("abi_stats: wrong counts after load");
+
+    // Deleting one contract leaves the shared abi usable by the others
+    check_context(context, abieos_delete_contract(context, 4));
+    check_context(context, abieos_json_to_bin(context, 5, "permission_level", level_json));
+    auto transfer = check_context(context, abieos_string_to_name(context, "transfer"));
+    check_context(context, abieos_get_type_for_action(context, 3, transfer));
+
+    // Once every user of an abi is gone it is compiled again
+    for (uint64_t contract = 1; contract <= 3; ++contract)
+        check_context(context, abieos_delete_contract(context, contract));
+    check_context(context, abieos_set_abi_hex(context, 1, tokenHexAbi));
+    s = stats();
+    if (s.abis_compiled != 3 || s.abis_deduplicated != 3)
+        throw std::runtime_error("abi_stats: expired abi was reused");
+
+    // Failed loads are not cached
+    check_error(context, "", [&] { return abieos_set_abi(context, 6, "{"); });
+    check_error(context, "", [&] { return abieos_set_abi(context, 6, "{"); });
+    s = stats();
+    if (s.abis_compiled != 3 || s.abis_deduplicated != 3)
+        throw std::runtime_error("abi_stats: failed load was counted");
+
+    auto* registry = abieos_registry_create();
+    check_context(context, abieos_registry_set_abi(context, registry, 1, transactionAbi));
+    check_context(context, abieos_registry_set_abi(context, registry, 1, transactionAbi));
+    check_context(context, abieos_registry_set_abi(context, registry, 2, transactionAbi));
+    abieos_abi_stats rs;
+    if (!abieos_registry_get_abi_stats(registry, &rs) || rs.abis_compiled != 1 || rs.abis_deduplicated != 2 ||
+        rs.bytes_saved != 2 * strlen(transactionAbi))
+        throw std::runtime_error("registry_abi_stats: wrong counts");
+    abieos_registry_release(registry);
+
+    abieos_destroy(context);
+}
+
+void check_flat_map() {
+    std::map<uint64_t, uint64_t> expected;
+    sysio::flat_map<sysio::name, uint64_t> m;
+    uint64_t x = 1;
+    for (int i = 0; i < 20000; ++i) {
+        x = x * 6364136223846793005 + 1442695040888963407;
+        auto key = (x >> 40) % 3000;
+        if (x & (1 << 20)) {
+            if (m.erase(sysio::name{key}) != expected.erase(key))
+                throw std::runtime_error("flat_map: erase mismatch");
+        } else {
+            expected[key] = x;
+            m[sysio::name{key}] = x;
+        }
+    }
+    if (m.size() != expected.size())
+        throw std::runtime_error("flat_map: size mismatch");
+    for (uint64_t key = 0; key < 3000; ++key) {
+        auto it = m.find(sysio::name{key});
+        auto e = expected.find(key);
+        if ((it == m.end()) != (e == expected.end()) || (it != m.end() && it->second != e->second))
+            throw std::runtime_error("flat_map: lookup mismatch");
+    }
+
+    sysio::flat_map<std::string, int> types;
+    types.try_emplace("uint8", 1);
+    if (!types.try_emplace("uint16", 2).second || types.try_emplace("uint8", 3).second ||
+        types.find(std::string_view{"uint8"})->second != 1 || types.find("uint32") != types.end())
+        throw std::runtime_error("flat_map: string keys");
+}
+
+void check_abi_versions() {
+    const char v1[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "rec", "base": "", "fields": [{"name": "a", "type": "uint8"}]}]})";
+    const char v2[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "rec", "base": "", "fields": [{"name": "a", "type": "uint16"}]}]})";
+    const char data[] = {1, 2};
+    auto* registry = check(abieos_registry_create());
+    auto writer = check(abieos_create());
+    auto reader = check(abieos_create());
+    check_context(reader, abieos_attach_registry(reader, registry));
+    auto decode = [&](uint32_t block) {
+        return std::string(check_context(reader, abieos_bin_to_json_at_block(reader, 1, block, "rec", data, 2)));
+    };
+    auto compiled = [&] {
+        abieos_abi_stats stats;
+        abieos_registry_get_abi_stats(registry, &stats);
+        return stats.abis_compiled;
+    };
+
+    check_context(writer, abieos_registry_set_abi_at_block(writer, registry, 1, 200, v2));
+    check_context(writer, abieos_registry_set_abi_at_block(writer, registry, 1, 100, v1));
+    check_error(reader, R"(contract "............1" is not loaded at block 99)",
+                [&] { return decode(99).c_str(); }, true);
+    if (decode(100) != R"({"a":1})" || decode(199) != R"({"a":1})" || decode(200) != R"({"a":513})" ||
+        decode(~0u) != R"({"a":513})")
+        throw std::runtime_error("abi versions: wrong version used");
+    if (std::string(check_context(reader, abieos_bin_to_json(reader, 1, "rec", data, 2))) != R"({"a":513})")
+        throw std::runtime_error("abi versions: latest version not used");
+    auto handle = check_context(reader, abieos_get_type_handle_at_block(reader, 1, 150, "rec"));
+    if (std::string(check_context(reader, abieos_handle_bin_to_json(reader, handle, data, 2))) != R"({"a":1})")
+        throw std::runtime_error("abi versions: wrong handle");
+
+    // Replacing a version at the same block
+    check_context(writer, abieos_registry_set_abi_at_block(writer, registry, 1, 200, v1));
+    if (decode(250) != R"({"a":1})")
+        throw std::runtime_error("abi versions: version not replaced");
+
+    // Pruning drops superseded versions; they are freed once no context holds them
+    check_context(writer, abieos_registry_set_abi_at_block(writer, registry, 1, 300, v2));
+    auto before = compiled();
+    check(abieos_registry_prune(registry, 300));
+    check_error(reader, R"(contract "............1" is not loaded at block 299)",
+                [&] { return decode(299).c_str(); }, true);
+    if (decode(300) != R"({"a":513})")
+        throw std::runtime_error("abi versions: pruned too much");
+    check_context(writer, abieos_registry_set_abi_at_block(writer, registry, 1, 400, v1));
+    if (compiled() != before + 1)
+        throw std::runtime_error("abi versions: pruned version was not freed");
+
+    // Setting without a block replaces every version
+    check_context(writer, abieos_registry_set_abi(writer, registry, 1, v2));
+    if (decode(0) != R"({"a":513})" || decode(400) != R"({"a":513})")
+        throw std::runtime_error("abi versions: versions not replaced");
+
+    // Readers decode while versions are added and pruned
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++i) {
+        threads.emplace_back([&, i] {
+            auto context = check(abieos_create());
+            check_context(context, abieos_attach_registry(context, registry));
+            while (!done) {
+                auto json = abieos_bin_to_json_at_block(context, 1, 1000 + i, "rec", data, 2);
+                if (!json || (strcmp(json, R"({"a":1})") && strcmp(json, R"({"a":513})")))
+                    throw std::runtime_error("abi versions: bad concurrent decode");
+            }
+            abieos_destroy(context);
+        });
+    }
+    for (uint32_t block = 1; block < 300; ++block) {
+        check_context(writer, abieos_registry_set_abi_at_block(writer, registry, 1, block, block % 2 ? v1 : v2));
+        if (block % 16 == 0)
+            check(abieos_registry_prune(registry, block));
+    }
+    done = true;
+    for (auto& t : threads)
+        t.join();
+
+    abieos_destroy(reader);
+    abieos_destroy(writer);
+    abieos_registry_release(registry);
+}
+
+void check_lazy() {
+    auto parse = [] {
+        sysio::abi_def def;
+        std::string abi_json{testAbi};
+        sysio::json_token_stream stream(abi_json.data());
+        from_json(def, stream);
+        return def;
+    };
+    sysio::abi eager_abi, lazy_abi;
+    convert(parse(), eager_abi);
+    convert_lazy(parse(), lazy_abi);
+    const sysio::abi& eager = eager_abi;
+    const sysio::abi& lazy = lazy_abi;
+    auto is_resolved = [&](const char* name) {
+        return !std::holds_alternative<const sysio::struct_def*>(lazy.abi_types.find(name)->second._data);
+    };
+    if (is_resolved("s5") || is_resolved("s2"))
+        throw std::runtime_error("lazy: resolved before use");
+
+    const std::pair<const char*, const char*> values[] = {
+        {"s3", R"({"z1":1,"z2":["s2",{"y1":3,"y2":4}],"z3":{"y1":5,"y2":6}})"},
+        {"s4", R"({"a1":5,"b1":[1,2]})"},
+        {"s5", R"({"x1":9,"x2":10,"x3":{"c1":4,"c2":[{"x1":1,"x2":2,"x3":{"c1":3,"c2":[],"c3":5}}],"c3":6}})"},
+        {"s9", R"({"a1":[{"x1":6},{"x1":16}]})"},
+        {"v1?", R"(["s1",{"x1":1}])"},
+        {"s1[2]", R"([{"x1":1},{"x1":2}])"},
+    };
+    auto check_same = [&](const char* type_name, const char* json) {
+        abieos::conversion_scratch scratch;
+        std::vector<char> bin_a, bin_b;
+        abieos::conversion_error error;
+        if (!abieos::json_to_bin(bin_a, eager.get_type(type_name), json, [] {}, scratch, error) ||
+            !abieos::json_to_bin(bin_b, lazy.get_type(type_name), json, [] {}, scratch, error) || bin_a != bin_b)
+            throw std::runtime_error(std::string("lazy: json_to_bin mismatch for ") + json);
+        sysio::input_stream in{bin_b.data(), bin_b.size()};
+        std::string result;
+        if (!abieos::bin_to_json(in, lazy.get_type(type_name), result, [] {}, scratch, error) || result != json)
+            throw std::runtime_error(std::string("lazy: bin_to_json mismatch for ") + json);
+    };
+    check_same("s2", R"({"y1":1,"y2":2})");
+    if (!is_resolved("s2") || is_resolved("s5") || lazy.get_type("s2")->program.empty())
+        throw std::runtime_error("lazy: wrong types resolved");
+
+    // Threads resolve the rest concurrently
+    sysio::abi shared_abi;
+    convert_lazy(parse(), shared_abi);
+    const sysio::abi& shared = shared_abi;
+    auto check_values = [&](int i) {
+        for (size_t j = 0; j < std::size(values); ++j) {
+            auto& [type_name, json] = values[(i + j) % std::size(values)];
+            auto* a = eager.get_type(type_name);
+            auto* b = shared.get_type(type_name);
+            abieos::conversion_scratch scratch;
+            std::vector<char> bin_a, bin_b;
+            abieos::conversion_error error;
+            if (!abieos::json_to_bin(bin_a, a, json, [] {}, scratch, error) ||
+                !abieos::json_to_bin(bin_b, b, json, [] {}, scratch, error) || bin_a != bin_b ||
+                a->fixed_size != b->fixed_size)
+                throw std::runtime_error("lazy: bad concurrent conversion of " + std::string(type_name) + ": " +
+                                         error.message);
+        }
+    };
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(4);
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                check_values(i);
+            } catch (std::exception& e) {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    for (auto& e : errors)
+        if (!e.empty())
+            throw std::runtime_error(e);
+    for (auto& [type_name, json] : values)
+        check_same(type_name, json);
+
+    // A lazy abi converts back to the same abi_def
+    sysio::abi_def eager_def, lazy_def;
+    convert(eager, eager_def);
+    convert(lazy, lazy_def);
+    if (sysio::convert_to_bin(eager_def) != sysio::convert_to_bin(lazy_def))
+        throw std::runtime_error("lazy: abi_def mismatch");
+
+    // Through the C API, errors in a type only show once it is used
+    const char broken[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "good", "base": "", "fields": [{"name": "a", "type": "uint8"}]},
+                    {"name": "bad", "base": "", "fields": [{"name": "a", "type": "nosuch"}]}]})";
+    auto context = check(abieos_create());
+    check_error(context, "", [&] { return abieos_set_abi(context, 1, broken); });
+    abieos_set_lazy_abis(context, true);
+    check_context(context, abieos_set_abi(context, 1, broken));
+    check_context(context, abieos_json_to_bin(context, 1, "good", R"({"a":7})"));
+    check_error(context, "", [&] { return abieos_json_to_bin(context, 1, "bad", R"({"a":7})"); });
+
+    const char transfer_hex[] = "608C31C6187315D6708C31C6187315D60100000000000000045359530000000000";
+    std::vector<char> transfer_bin;
+    std::string error;
+    if (!abieos::unhex(error, transfer_hex, transfer_hex + strlen(transfer_hex), std::back_inserter(transfer_bin)))
+        throw std::runtime_error(error);
+    auto eager_context = check(abieos_create());
+    auto transfer = check_context(context, abieos_string_to_name(context, "transfer"));
+    check_context(context, abieos_set_abi_hex(context, 2, tokenHexAbi));
+    check_context(eager_context, abieos_set_abi_hex(eager_context, 2, tokenHexAbi));
+    std::string lazy_json = check_context(
+        context, abieos_action_bin_to_json(context, 2, transfer, transfer_bin.data(), transfer_bin.size()));
+    std::string eager_json = check_context(eager_context, abieos_action_bin_to_json(
+                                                              eager_context, 2, transfer, transfer_bin.data(),
+                                                              transfer_bin.size()));
+    if (lazy_json != eager_json)
+        throw std::runtime_error("lazy: action mismatch");
+    abieos_destroy(eager_context);
+    abieos_destroy(context);
+}
+
+void check_builtin_types() {
+    auto compile = [](const char* json) {
+        sysio::abi_def def;
+        std::string abi_json{json};
+        sysio::json_token_stream stream(abi_json.data());
+        from_json(def, stream);
+        auto result = std::make_unique<sysio::abi>();
+        convert(def, *result);
+        return result;
+    };
+    auto a = compile(testAbi);
+    auto b = compile(transactionAbi);
+    if (a->get_type("int8") != b->get_type("int8") || a->get_type("extended_asset") != b->get_type("extended_asset") ||
+        a->abi_types.find("int8") != a->abi_types.end())
+        throw std::runtime_error("builtin_types: not shared");
+    if (a->get_type("int8[]") == b->get_type("int8[]"))
+        throw std::runtime_error("builtin_types: derived type shared");
+    check_except("Redefined type", [&] {
+        compile(R"({"version": "sysio::abi/1.1", "structs": [{"name": "int8", "base": "", "fields": []}]})");
+    }, true);
+    check_except("Redefined type", [&] {
+        compile(R"({"version": "sysio::abi/1.1", "types": [{"new_type_name": "extended_asset", "type": "asset"}]})");
+    }, true);
+}
+
+void check_snapshot() {
+    auto* registry = check(abieos_registry_create());
+    auto context = check(abieos_create());
+    const char v1[] = R"({"version": "sysio::abi/1.1",
+        "types": [{"new_type_name": "amount", "type": "uint16"}],
+        "structs": [{"name": "rec", "base": "", "fields": [{"name": "a", "type": "amount"}]}]})";
+    check_context(context, abieos_registry_set_abi(context, registry, 1, testAbi));
+    check_context(context, abieos_registry_set_abi_hex(context, registry, 2, tokenHexAbi));
+    check_context(context, abieos_registry_set_abi(context, registry, 3, transactionAbi));
+    check_context(context, abieos_registry_set_abi_at_block(context, registry, 4, 100, v1));
+    check_context(context, abieos_registry_set_abi_at_block(context, registry, 4, 200, transactionAbi));
+    // Updated abis reuse the types of the version they replace, including derived types
+    const char update_v1[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "b", "base": "", "fields": [{"name": "x", "type": "uint8"}]},
+                    {"name": "a", "base": "", "fields": [{"name": "bs", "type": "b[]"},
+                        {"name": "o", "type": "b?"}]}]})";
+    const char update_v2[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "b", "base": "", "fields": [{"name": "x", "type": "uint8"}]},
+                    {"name": "a", "base": "", "fields": [{"name": "bs", "type": "b[]"}, {"name": "o", "type": "b?"}]},
+                    {"name": "d", "base": "", "fields": [{"name": "bs", "type": "b[]"},
+                        {"name": "o", "type": "b?"}]}]})";
+    check_context(context, abieos_registry_update_abi(context, registry, 6, update_v1));
+    check_context(context, abieos_registry_update_abi(context, registry, 6, update_v2));
+    check_context(context, abieos_registry_update_abi_at_block(context, registry, 7, 100, update_v1));
+    check_context(context, abieos_registry_update_abi_at_block(context, registry, 7, 200, update_v2));
+    abieos_set_lazy_abis(context, true);
+    check_context(context, abieos_registry_set_abi(context, registry, 5, testAbi));
+    check_context(context, abieos_registry_save(context, registry));
+    std::vector<char> snapshot(abieos_get_bin_data(context),
+                               abieos_get_bin_data(context) + abieos_get_bin_size(context));
+
+    auto* loaded = check(abieos_registry_create());
+    check_context(context, abieos_registry_load(context, loaded, snapshot.data(), snapshot.size()));
+    auto a = check(abieos_create()), b = check(abieos_create());
+    check_context(a, abieos_attach_registry(a, registry));
+    check_context(b, abieos_attach_registry(b, loaded));
+    auto same = [&](uint64_t contract, std::optional<uint32_t> block, const char* type, const std::string& json) {
+        auto to_bin = [&](abieos_context* c) {
+            auto handle = block ? check_context(c, abieos_get_type_handle_at_block(c, contract, *block, type))
+                                : check_context(c, abieos_get_type_handle(c, contract, type));
+            check_context(c, abieos_handle_json_to_bin(c, handle, json.c_str()));
+            std::vector<char> bin(abieos_get_bin_data(c), abieos_get_bin_data(c) + abieos_get_bin_size(c));
+            return std::pair{bin, std::string(check_context(c, abieos_handle_bin_to_json(c, handle, bin.data(),
+                                                                                         bin.size())))};
+        };
+        if (to_bin(a) != to_bin(b))
+            throw std::runtime_error("snapshot: mismatch for " + json);
+    };
+    same(1, {}, "s5", R"({"x1":9,"x2":10,"x3":{"c1":4,"c2":[{"x1":1,"x2":2,"x3":{"c1":3,"c2":[],"c3":5}}],"c3":6}})");
+    same(1, {}, "s3", R"({"z1":1,"z2":["s2",{"y1":3,"y2":4}],"z3":{"y1":5,"y2":6}})");
+    same(1, {}, "s1[2]", R"([{"x1":1},{"x1":2}])");
+    same(2, {}, "transfer", R"({"from":"useraaaaaaaa","to":"useraaaaaaab","quantity":"0.0001 SYS","memo":"x"})");
+    same(3, {}, "permission_level", R"({"actor":"useraaaaaaaa","permission":"active"})");
+    same(4, 150, "rec", R"({"a":513})");
+    same(4, 150, "amount", R"(7)");
+    same(4, 250, "permission_level", R"({"actor":"useraaaaaaaa","permission":"active"})");
+    same(5, {}, "s4", R"({"a1":5,"b1":[1,2]})");
+    same(6, {}, "a", R"({"bs":[{"x":1},{"x":2}],"o":{"x":3}})");
+    same(6, {}, "d", R"({"bs":[{"x":1}],"o":null})");
+    same(7, 150, "a", R"({"bs":[],"o":{"x":3}})");
+    same(7, 250, "a", R"({"bs":[{"x":1},{"x":2}],"o":{"x":3}})");
+    same(7, 250, "d", R"({"bs":[{"x":1}],"o":null})");
+    check_error(b, R"(contract "............4" is not loaded at block 99)", [&] {
+        return abieos_get_type_handle_at_block(b, 4, 99, "rec");
+    }, true);
+    auto transfer = check_context(a, abieos_string_to_name(a, "transfer"));
+    if (std::string(check_context(b, abieos_get_type_for_action(b, 2, transfer))) != "transfer")
+        throw std::runtime_error("snapshot: action type lost");
+
+    // A snapshot of a loaded registry is identical, and damaged snapshots are rejected
+    check_context(context, abieos_registry_save(context, loaded));
+    if (std::vector<char>(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context)) !=
+        snapshot)
+        throw std::runtime_error("snapshot: not stable");
+    auto* scratch = check(abieos_registry_create());
+    for (size_t size = 0; size < snapshot.size(); size += 7)
+        check_error(context, "", [&] { return abieos_registry_load(context, scratch, snapshot.data(), size); });
+    for (size_t i = 0; i < snapshot.size(); i += 5) {
+        auto damaged = snapshot;
+        damaged[i] ^= 0x5a;
+        abieos_registry_load(context, scratch, damaged.data(), damaged.size());
+    }
+    abieos_registry_release(scratch);
+
+    abieos_destroy(a);
+    abieos_destroy(b);
+    abieos_destroy(context);
+    abieos_registry_release(loaded);
+    abieos_registry_release(registry);
+}
+
+void check_update() {
+    const char v1[] = R"({"version": "sysio::abi/1.1",
+        "types": [{"new_type_name": "amount", "type": "uint64"}],
+        "structs": [{"name": "transfer", "base": "", "fields": [{"name": "to", "type": "name"},
+                        {"name": "qty", "type": "amount"}]},
+                    {"name": "memo", "base": "", "fields": [{"name": "text", "type": "string"}]},
+                    {"name": "wrap", "base": "", "fields": [{"name": "t", "type": "transfer"},
+                        {"name": "m", "type": "memo[]"}]},
+                    {"name": "other", "base": "", "fields": [{"name": "x", "type": "uint8"}]}],
+        "variants": [{"name": "choice", "types": ["transfer", "other"]}],
+        "actions": [{"name": "transfer", "type": "transfer", "ricardian_contract": ""}]})";
+    const char v2[] = R"({"version": "sysio::abi/1.1",
+        "types": [{"new_type_name": "amount", "type": "uint64"}],
+        "structs": [{"name": "transfer", "base": "", "fields": [{"name": "to", "type": "name"},
+                        {"name": "qty", "type": "amount"}]},
+                    {"name": "memo", "base": "", "fields": [{"name": "text", "type": "string"},
+                        {"name": "n", "type": "uint8"}]},
+                    {"name": "wrap", "base": "", "fields": [{"name": "t", "type": "transfer"},
+                        {"name": "m", "type": "memo[]"}]},
+                    {"name": "added", "base": "transfer", "fields": []}],
+        "variants": [{"name": "choice", "types": ["transfer", "uint8"]}],
+        "actions": [{"name": "transfer", "type": "transfer", "ricardian_contract": ""}]})";
+    const char v3[] = R"({"version": "sysio::abi/1.1",
+        "types": [{"new_type_name": "amount", "type": "uint32"}],
+        "structs": [{"name": "transfer", "base": "", "fields": [{"name": "to", "type": "name"},
+                        {"name": "qty", "type": "amount"}]},
+                    {"name": "memo", "base": "", "fields": [{"name": "text", "type": "string"},
+                        {"name": "n", "type": "uint8"}]},
+                    {"name": "wrap", "base": "", "fields": [{"name": "t", "type": "transfer"},
+                        {"name": "m", "type": "memo[]"}]},
+                    {"name": "added", "base": "transfer", "fields": []}],
+        "variants": [{"name": "choice", "types": ["transfer", "uint8"]}],
+        "actions": [{"name": "transfer", "type": "transfer", "ricardian_contract": ""}]})";
+    auto context = check(abieos_create());
+    auto update = [&](const char* abi) {
+        return std::string(check_context(context, abieos_update_abi(context, 1, abi)));
+    };
+    auto handle = [&](const char* type) { return check_context(context, abieos_get_type_handle(context, 1, type)); };
+    auto round_trip = [&](const char* type, const char* json) {
+        check_context(context, abieos_json_to_bin(context, 1, type, json));
+        std::vector<char> bin(abieos_get_bin_data(context),
+                              abieos_get_bin_data(context) + abieos_get_bin_size(context));
+        if (std::string(check_context(context, abieos_bin_to_json(context, 1, type, bin.data(), bin.size()))) != json)
+            throw std::runtime_error(std::string("update: round trip failed for ") + json);
+    };
+
+    if (update(v1) != R"(["amount","choice","memo","other","transfer","wrap"])")
+        throw std::runtime_error("update: wrong changes for a new contract");
+    auto transfer = handle("transfer");
+    auto wrap     = handle("wrap");
+    if (update(v1) != "[]" || handle("transfer") != transfer || handle("wrap") != wrap)
+        throw std::runtime_error("update: unchanged abi was recompiled");
+
+    auto memo    = handle("memo");
+    auto changes = update(v2);
+    if (changes != R"(["added","choice","memo","other","wrap"])")
+        throw std::runtime_error("update: wrong changes " + changes);
+    if (handle("transfer") != transfer || handle("wrap") == wrap || handle("memo") == memo)
+        throw std::runtime_error("update: wrong types reused");
+    memo = handle("memo");
+    round_trip("transfer", R"({"to":"alice","qty":"7"})");
+    round_trip("added", R"({"to":"alice","qty":"7"})");
+    round_trip("wrap", R"({"t":{"to":"bob","qty":"1"},"m":[{"text":"hi","n":2}]})");
+    round_trip("choice", R"(["uint8",3])");
+    auto action = check_context(context, abieos_string_to_name(context, "transfer"));
+    if (std::string(check_context(context, abieos_get_type_for_action(context, 1, action))) != "transfer")
+        throw std::runtime_error("update: action lost");
+
+    // A changed alias changes everything which depends on it
+    changes = update(v3);
+    if (changes != R"(["added","amount","choice","transfer","wrap"])")
+        throw std::runtime_error("update: wrong changes " + changes);
+    if (handle("transfer") == transfer || handle("memo") != memo)
+        throw std::runtime_error("update: wrong types reused after alias change");
+    round_trip("wrap", R"({"t":{"to":"bob","qty":7},"m":[{"text":"hi","n":2}]})");
+
+    // Registries, and snapshots of updated abis
+    auto* registry = check(abieos_registry_create());
+    check_context(context, abieos_registry_update_abi(context, registry, 2, v1));
+    changes = check_context(context, abieos_registry_update_abi(context, registry, 2, v2));
+    if (changes != R"(["added","choice","memo","other","wrap"])")
+        throw std::runtime_error("update: wrong registry changes " + changes);
+    check_context(context, abieos_registry_save(context, registry));
+    std::vector<char> snapshot(abieos_get_bin_data(context),
+                               abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    auto* loaded = check(abieos_registry_create());
+    check_context(context, abieos_registry_load(context, loaded, snapshot.data(), snapshot.size()));
+    auto reader = check(abieos_create());
+    check_context(reader, abieos_attach_registry(reader, loaded));
+    const char json[] = R"({"t":{"to":"bob","qty":"1"},"m":[{"text":"hi","n":2}]})";
+    check_context(reader, abieos_json_to_bin(reader, 2, "wrap", json));
+    std::vector<char> bin(abieos_get_bin_data(reader), abieos_get_bin_data(reader) + abieos_get_bin_size(reader));
+    if (std::string(check_context(reader, abieos_bin_to_json(reader, 2, "wrap", bin.data(), bin.size()))) != json)
+        throw std::runtime_error("update: snapshot of updated abi failed");
+
+    // A new type which uses the same derived types as a reused one
+    const char derived_v1[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "b", "base": "", "fields": [{"name": "x", "type": "uint8"}]},
+                    {"name": "a", "base": "", "fields": [{"name": "bs", "type": "b[]"},
+                        {"name": "o", "type": "b?"}]}]})";
+    const char derived_v2[] = R"({"version": "sysio::abi/1.1",
+        "structs": [{"name": "b", "base": "", "fields": [{"name": "x", "type": "uint8"}]},
+                    {"name": "a", "base": "", "fields": [{"name": "bs", "type": "b[]"}, {"name": "o", "type": "b?"}]},
+                    {"name": "d", "base": "", "fields": [{"name": "bs", "type": "b[]"},
+                        {"name": "o", "type": "b?"}]}]})";
+    check_context(context, abieos_registry_update_abi(context, registry, 5, derived_v1));
+    if ((changes = check_context(context, abieos_registry_update_abi(context, registry, 5, derived_v2))) != R"(["d"])")
+        throw std::runtime_error("update: wrong changes " + changes);
+    check_context(context, abieos_registry_save(context, registry));
+    snapshot.assign(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    check_context(context, abieos_registry_load(context, loaded, snapshot.data(), snapshot.size()));
+    const char derived_json[] = R"({"bs":[{"x":1},{"x":2}],"o":{"x":3}})";
+    for (auto* type : {"a", "d"}) {
+        check_context(reader, abieos_json_to_bin(reader, 5, type, derived_json));
+        bin.assign(abieos_get_bin_data(reader), abieos_get_bin_data(reader) + abieos_get_bin_size(reader));
+        if (std::string(check_context(reader, abieos_bin_to_json(reader, 5, type, bin.data(), bin.size()))) !=
+            derived_json)
+            throw std::runtime_error("update: snapshot of derived types failed");
+    }
+
+    // A context updates a registry contract it doesn't have itself from the registry's latest version
+    auto registry_memo = check_context(reader, abieos_get_type_handle(reader, 2, "memo"));
+    changes            = check_context(reader, abieos_update_abi(reader, 2, v3));
+    if (changes != R"(["added","amount","choice","transfer","wrap"])")
+        throw std::runtime_error("update: wrong changes from registry " + changes);
+    if (check_context(reader, abieos_get_type_handle(reader, 2, "memo")) != registry_memo)
+        throw std::runtime_error("update: registry types not reused");
+
+    // Versions added at a block reuse the types of the version they succeed and keep the others
+    auto at_block = [&](uint32_t block, const char* abi) {
+        return std::string(
+            check_context(context, abieos_registry_update_abi_at_block(context, registry, 3, block, abi)));
+    };
+    auto handle_at = [&](uint32_t block, const char* type) {
+        return check_context(reader, abieos_get_type_handle_at_block(reader, 3, block, type));
+    };
+    check_context(reader, abieos_attach_registry(reader, registry));
+    at_block(100, v1);
+    if ((changes = at_block(200, v2)) != R"(["added","choice","memo","other","wrap"])")
+        throw std::runtime_error("update: wrong changes at block " + changes);
+    if ((changes = at_block(150, v1)) != "[]")
+        throw std::runtime_error("update: wrong changes between blocks " + changes);
+    if (handle_at(150, "transfer") != handle_at(250, "transfer") || handle_at(150, "memo") == handle_at(250, "memo"))
+        throw std::runtime_error("update: wrong types reused at block");
+    handle_at(120, "other");
+    check_error(reader, "", [&] { return abieos_get_type_handle_at_block(reader, 3, 250, "other"); });
+    check_error(reader, "", [&] { return abieos_get_type_handle_at_block(reader, 3, 50, "transfer"); });
+
+    // An abi which is already loaded is shared rather than compiled again
+    abieos_abi_stats before, after;
+    abieos_registry_get_abi_stats(registry, &before);
+    check_context(context, abieos_registry_update_abi(context, registry, 4, v2));
+    abieos_registry_get_abi_stats(registry, &after);
+    if (after.abis_compiled != before.abis_compiled || after.abis_deduplicated != before.abis_deduplicated + 1)
+        throw std::runtime_error("update: identical abi compiled again");
+
+    // Lazy contexts update lazily, reusing the types which were already resolved
+    auto lazy = check(abieos_create());
+    abieos_set_lazy_abis(lazy, true);
+    check_context(lazy, abieos_update_abi(lazy, 1, v1));
+    transfer = check_context(lazy, abieos_get_type_handle(lazy, 1, "transfer"));
+    if ((changes = check_context(lazy, abieos_update_abi(lazy, 1, v2))) !=
+        R"(["added","choice","memo","other","wrap"])")
+        throw std::runtime_error("update: wrong lazy changes " + changes);
+    if (check_context(lazy, abieos_get_type_handle(lazy, 1, "transfer")) != transfer)
+        throw std::runtime_error("update: resolved lazy type not reused");
+    if ((changes = check_context(lazy, abieos_update_abi(lazy, 1, v3))) !=
+        R"(["added","amount","choice","transfer","wrap"])")
+        throw std::runtime_error("update: wrong lazy changes " + changes);
+    check_context(lazy, abieos_json_to_bin(lazy, 1, "wrap", R"({"t":{"to":"bob","qty":7},"m":[{"text":"hi","n":2}]})"));
+
+    // Concurrent updates of one contract each diff against the version they replace, so every version is replaced
+    // exactly once
+    auto numbered = [](const std::string& n) {
+        return R"({"version": "sysio::abi/1.1", "structs": [{"name": "t)" + n + R"(", "base": "", "fields": []}]})";
+    };
+    auto* shared = check(abieos_registry_create());
+    check_context(context, abieos_registry_update_abi(context, shared, 1, numbered("start").c_str()));
+    std::vector<std::thread> threads;
+    std::vector<std::string> replaced, errors(4);
+    std::mutex               replaced_mutex;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i] {
+            auto c = abieos_create();
+            try {
+                for (int j = 0; j < 25; ++j) {
+                    auto n      = std::to_string(i * 100 + j);
+                    auto result = std::string(check_context(
+                        c, abieos_registry_update_abi(c, shared, 1, numbered(n).c_str())));
+                    // The changes are the added type and the one it replaces
+                    std::vector<std::string> names;
+                    for (size_t pos = result.find('"'); pos != std::string::npos;
+                         pos = result.find('"', result.find('"', pos + 1) + 1))
+                        names.push_back(result.substr(pos + 1, result.find('"', pos + 1) - pos - 1));
+                    auto own = std::find(names.begin(), names.end(), "t" + n);
+                    if (names.size() != 2 || own == names.end())
+                        throw std::runtime_error("update: wrong concurrent changes " + result);
+                    std::lock_guard<std::mutex> lock{replaced_mutex};
+                    replaced.push_back(names[own == names.begin()]);
+                }
+            } catch (std::exception& e) {
+                errors[i] = e.what();
+            }
+            abieos_destroy(c);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    for (auto& e : errors)
+        if (!e.empty())
+            throw std::runtime_error(e);
+    std::sort(replaced.begin(), replaced.end());
+    if (replaced.size() != 100 || std::adjacent_find(replaced.begin(), replaced.end()) != replaced.end())
+        throw std::runtime_error("update: a version was replaced twice");
+    abieos_registry_release(shared);
+
+    abieos_destroy(lazy);
+    abieos_destroy(reader);
+    abieos_registry_release(loaded);
+    abieos_registry_release(registry);
+    abieos_destroy(context);
+}
+
+void check_bulk() {
+    auto context = check(abieos_create());
+    std::vector<char> token, transaction;
+    std::string error;
+    if (!abieos::unhex(error, tokenHexAbi, tokenHexAbi + strlen(tokenHexAbi), std::back_inserter(token)))
+        throw std::runtime_error(error);
+    check_context(context, abieos_abi_json_to_bin(context, transactionAbi));
+    transaction.assign(abieos_get_bin_data(context), abieos_get_bin_data(context) + abieos_get_bin_size(context));
+    const char garbage[] = "\\x0e not an abi";
+
+    std::vector<abieos_abi_item> items;
+    for (uint64_t contract = 1; contract <= 40; ++contract) {
+        auto& abi = contract % 2 ? token : transaction;
+        items.push_back({contract, abi.data(), abi.size()});
+    }
+    items[10] = {11, garbage, sizeof(garbage)};
+    items[20] = {21, nullptr, 0};
+    auto level = R"({"actor":"useraaaaaaaa","permission":"active"})";
+
+    for (size_t threads : {0, 1, 4}) {
+        auto* registry = check(abieos_registry_create());
+        auto reader = check(abieos_create());
+        check_context(reader, abieos_attach_registry(reader, registry));
+        std::vector<abieos_batch_result> results(items.size());
+        auto arena = check_context(
+            context, abieos_set_abis_bulk(context, registry, items.data(), items.size(), threads, results.data()));
+        for (size_t i = 0; i < items.size(); ++i) {
+            bool bad = i == 10 || i == 20;
+            if ((results[i].error != abieos_error_none) != bad || (results[i].size != 0) != bad)
+                throw std::runtime_error("bulk: wrong result for item " + std::to_string(i));
+            if (bad)
+                continue;
+            if (items[i].contract % 2)
+                check_context(reader, abieos_get_type_handle(reader, items[i].contract, "transfer"));
+            else
+                check_context(reader, abieos_json_to_bin(reader, items[i].contract, "permission_level", level));
+        }
+        if (std::string(arena + results[20].offset) != "no data")
+            throw std::runtime_error("bulk: wrong error message");
+        check_error(reader, "", [&] { return abieos_get_type_handle(reader, 11, "transfer"); });
+        abieos_abi_stats stats;
+        abieos_registry_get_abi_stats(registry, &stats);
+        if (stats.abis_compiled != 2 || stats.abis_deduplicated != 36)
+            throw std::runtime_error("bulk: abis not shared");
+        abieos_destroy(reader);
+        abieos_registry_release(registry);
+    }
+
+    // Into the context itself
+    std::vector<abieos_batch_result> results(items.size());
+    check_context(context, abieos_set_abis_bulk(context, nullptr, items.data(), items.size(), 3, results.data()));
+    check_context(context, abieos_json_to_bin(context, 40, "permission_level", level));
+    check_context(context, abieos_get_type_handle(context, 1, "transfer"));
+    check_error(context, "", [&] { return abieos_get_type_handle(context, 21, "transfer"); });
+    abieos_destroy(context);
+}
+
+// Runs the check named on the command line, as each ctest entry does, or every check if none is named
+int main(int argc, char** argv) {
+    const std::pair<const char*, void (*)()> checks[] = {
+        {"check_flat_map", check_flat_map},
+        {"check_types", check_types},
+        {"check_registry", check_registry},
+        {"check_batch", check_batch},
+        {"check_into", check_into},
+        {"check_handles", check_handles},
+        {"check_typed_decode", check_typed_decode},
+        {"check_error_report", check_error_report},
+        {"check_scratch", check_scratch},
+        {"check_programs", check_programs},
+        {"check_fixed_size", check_fixed_size},
+        {"check_validate", check_validate},
+        {"check_abi_dedup", check_abi_dedup},
+        {"check_abi_versions", check_abi_versions},
+        {"check_lazy", check_lazy},
+        {"check_builtin_types", check_builtin_types},
+        {"check_snapshot", check_snapshot},
+        {"check_update", check_update},
+        {"check_bulk", check_bulk},
+        {"check_json_keys", check_json_keys},
+        {"check_variant_lookup", check_variant_lookup},
+        {"check_reorderable", check_reorderable},
+        {"check_insitu", check_insitu},
+        {"check_array_sizes", check_array_sizes},
+        {"check_json_tokenizer", check_json_tokenizer},
+        {"check_decimal_ints", check_decimal_ints},
+    };
     try {
-        check_types();
-        printf("\ncheck_types ok\n\n");
+        bool found = false;
+        for (auto& [name, check] : checks) {
+            if (argc > 1 && strcmp(argv[1], name))
+                continue;
+            found = true;
+            check();
+            printf("%s ok\n\n", name);
+        }
+        if (!found)
+            throw std::runtime_error("unknown check " + std::string(argv[1]));
         return 0;
     } catch (std::exception& e) {
         printf("error: %s\n", e.what());